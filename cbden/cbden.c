@@ -6,6 +6,24 @@
 /*                                                                   */
 /* ChangeLog:                                                        */
 /*                                                                   */
+/* 0.24: 17.10.26 AG: Cluster errors saved with the weights.         */
+/* 0.23: 17.10.26 AG: Checks the weight file against OverWrite.      */
+/* 0.22: 17.10.26 AG: Best-so-far files are replaced by renaming.    */
+/* 0.21: 17.10.26 AG: Checks the output files of binary sets.        */
+/* 0.20: 17.10.26 AG: Saves the centroid weights with the codebook.  */
+/* 0.19: 17.10.26 AG: Added TimeLimit and BestInterval parameters.   */
+/* 0.18: 17.10.26 AG: Added Checkpoint and Resume parameters.        */
+/* 0.17: 17.10.26 AG: Added Seeding parameter.                       */
+/* 0.16: 17.10.26 AG: Added the cluster-count search parameters.     */
+/* 0.15: 17.10.26 AG: Added Repeats parameter.                       */
+/* 0.14: 17.10.26 AG: Runs the clustering through a DenRS context.   */
+/* 0.13: 17.10.26 AG: Added SaveTrajectory parameter.                */
+/* 0.12: 17.10.26 AG: Reads binary (memory-mapped) training sets.    */
+/* 0.11: 17.10.26 AG: Added SaveMetrics parameter.                   */
+/* 0.10: 17.10.26 AG: Added GridIndex parameter.                     */
+/* 0.09: 17.10.26 AG: Added Bounds parameter.                        */
+/* 0.08: 17.10.26 AG: Added ParallelSwaps parameter.                 */
+/* 0.07: 17.10.26 AG: Added Threads parameter.                       */
 /* 0.06: 16.3.18  RS: Cleaned up unused parts of the code.           */
 /* 0.05:  3.7.17  RS: Removed radius parameter.                      */
 /* 0.04: 10.4.17  RS: Renamed to CBDEN.                              */
@@ -15,12 +33,16 @@
 /*-------------------------------------------------------------------*/
 
 #define ProgName        "CBDEN"
-#define VersionNumber   "Version 0.06"  /* JP */
-#define LastUpdated     "15.3.2018"
+#define VersionNumber   "Version 0.24"
+#define LastUpdated     "17.10.2026"
 #define FACTFILE        "cbden.fac"
 
 /* ------------------------------------------------------------------- */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include "parametr.c"
 #include "cb.h"
 #include "file.h"
@@ -28,7 +50,28 @@
 #include "memctrl.h"
 #include "random.h"
 #include "reporting.h"
+#include "denkern.h"
+#include "denwork.h"
+#include "dentrial.h"
+#include "denstats.h"
+#include "denmap.h"
+#include "dentraj.h"
 #include "denrs.h"
+#include "denrange.h"
+#include "denassign.h"
+
+
+/* Output files of a run. */
+typedef struct
+  {
+  char         *CBName;
+  char         *PAName;         /* empty = no partitioning            */
+  char         *WeightName;
+  char         *CkptName;       /* empty = no checkpoints             */
+  TRAININGSET  *TS;
+  double       *Weights;        /* final centroid weights             */
+  int           Written;        /* best-so-far solution written       */
+  } RUNFILES;
 
 
 /* ======================== PRINT ROUTINES =========================== */
@@ -95,6 +138,298 @@ static char* PrintInitialData(char *TSName, char *InName,
 }
 
 
+/* ------------------------------------------------------------------ */
+/* Metrics, trajectory and checkpoint files: codebook name with the   */
+/* extension ext (at most 5 characters).                              */
+/* ------------------------------------------------------------------ */
+
+
+static void PickOutputName(char *OutCBName, char *Name, char *ext)
+{
+  char *dot;
+
+  strncpy(Name, OutCBName, MAXFILENAME - 6);
+  Name[MAXFILENAME - 6] = '\0';
+  dot = strrchr(Name, '.');
+  if (dot != NULL && strchr(dot, '/') == NULL)  *dot = '\0';
+  strcat(Name, ext);
+}
+
+
+/* ------------------------------------------------------------------ */
+/* Stops if an output file exists and may not be overwritten.         */
+/* ------------------------------------------------------------------ */
+
+
+static void CheckOutputFile(char *name)
+{
+  FILE *f;
+
+  if (Value(OverWrite) || *name == '\0')  return;
+  f = fopen(name, "r");
+  if (f)
+    {
+    fclose(f);
+    ErrorMessage("ERROR: File %s already exists!\n", name);
+    ExitProcessing(FATAL_ERROR);
+    }
+}
+
+
+/* ------------------------------------------------------------------ */
+/* Binary training sets (see CBDENBIN) are mapped instead of read.    */
+/* Their output files are checked here, as CheckParameters() does     */
+/* for text sets, before any time is spent on the clustering.         */
+/* ------------------------------------------------------------------ */
+
+
+static int ReadTrainingData(char *TSName, char *OutCBName, char *OutPAName,
+char *InName, TRAININGSET *TS, MAPPEDSET *M)
+{
+  if (!IsMappedDataset(TSName))
+    {
+    *TS = CheckParameters(TSName, OutCBName, OutPAName, InName,
+          Value(Clusters), Value(OverWrite));
+    return 0;
+    }
+
+  CheckOutputFile(OutCBName);
+  CheckOutputFile(OutPAName);
+  ReadMappedDataset(TSName, TS, M);
+  if (Value(Clusters) > BookSize(TS))
+    {
+    ErrorMessage("ERROR: More clusters than vectors in %s!\n", TSName);
+    FreeMappedDataset(TS, M);
+    ExitProcessing(FATAL_ERROR);
+    }
+  return 1;
+}
+
+
+/* ------------------------------------------------------------------ */
+
+
+static void FreeTrainingData(TRAININGSET *TS, MAPPEDSET *M, int mapped)
+{
+  if (mapped)  FreeMappedDataset(TS, M);
+  else         FreeCodebook(TS);
+}
+
+
+/* ------------------------------------------------------------------ */
+
+
+static void PrintRunMessage(void *user, char *message)
+{
+  PrintMessage("%s", message);
+}
+
+
+/* ------------------------------------------------------------------ */
+
+
+static void PrintRepeats(REPEATSTATS *stats, double *errors)
+{
+  int r;
+
+  if (Value(QuietLevel) >= 2)
+    {
+    for (r = 0; r < stats->Repeats; r++)
+      {
+      PrintMessage("Repeat %-5i seed %-12lld MSE %f\n", r,
+                   stats->Seed - stats->Best + r, errors[r]);
+      }
+    }
+  PrintMessage("Repeats: %i (%i completed)  Best: %i (seed %lld)\n",
+               stats->Repeats, stats->Succeeded, stats->Best, stats->Seed);
+  PrintMessage("MSE min %f  max %f  mean %f  std %f\n", stats->MinError,
+               stats->MaxError, stats->MeanError, stats->StdError);
+}
+
+
+/* ------------------------------------------------------------------ */
+
+
+static void PrintRange(KRANGE *range)
+{
+  KRESULT *res;
+  int      k;
+
+  PrintMessage("%8s %16s %16s %6s\n", "clusters", "MSE", "WB-index",
+               "start");
+  for (k = range->Min; k <= range->Max; k++)
+    {
+    res = &range->Result[k - range->Min];
+    if (res->Failed)
+      {
+      PrintMessage("%8i %16s\n", k, "failed");
+      continue;
+      }
+    PrintMessage("%8i %16f %16f %6s\n", k, res->MSE, res->Index,
+                 res->Warm ? "warm" : "cold");
+    }
+  PrintMessage("Chosen number of clusters = %i\n", range->Best);
+}
+
+
+/* ------------------------------------------------------------------ */
+/* An output file written to temp (see TempName) replaces name. A     */
+/* failure keeps the previous file and is reported but not fatal.     */
+/* ------------------------------------------------------------------ */
+
+
+static void TempName(char *name, char *temp)
+{
+  strcpy(temp, name);
+  strcat(temp, ".tmp");
+}
+
+
+static void ReplaceOutputFile(char *temp, char *name)
+{
+  if (rename(temp, name) != 0)
+    {
+    ErrorMessage("WARNING: Replacing the file %s failed!\n", name);
+    remove(temp);
+    }
+}
+
+
+/* ------------------------------------------------------------------ */
+/* Best solution so far of a run with BestInterval. Each file is      */
+/* written to a temporary file first and then renamed over the output */
+/* file, so a run that is killed still leaves the last complete one.  */
+/* The output files were checked before the run (see OverWrite).      */
+/* With the partition, the cluster errors go to the weight file.      */
+/* ------------------------------------------------------------------ */
+
+
+static void WriteBestSoFar(void *user, CODEBOOK *CB, PARTITIONING *P,
+double *weight, llong error, int iter)
+{
+  RUNFILES *files = (RUNFILES*) user;
+  char      temp[MAXFILENAME + 4];
+  llong    *sse = NULL;
+
+  if (*files->PAName)
+    {
+    sse = (llong*) malloc(BookSize(CB) * sizeof(llong));
+    if (sse)  PartitionErrors(files->TS, CB, P, sse);
+    }
+  TempName(files->CBName, temp);
+  WriteCodebook(temp, CB, YES);
+  ReplaceOutputFile(temp, files->CBName);
+  TempName(files->WeightName, temp);
+  WriteWeights(temp, weight, sse, BookSize(CB), YES);
+  ReplaceOutputFile(temp, files->WeightName);
+  if (*files->PAName)
+    {
+    TempName(files->PAName, temp);
+    WritePartitioning(temp, P, files->TS, YES);
+    ReplaceOutputFile(temp, files->PAName);
+    }
+  free(sse);
+  files->Written = YES;
+}
+
+
+/* ------------------------------------------------------------------ */
+/* Runs the clustering with the options of the parameter file. The    */
+/* run draws its random numbers from a stream seeded by RandomSeed.   */
+/* With Repeats > 1, keeps the best of that many independent runs     */
+/* (seeds RandomSeed, RandomSeed+1, ...). With MaxClusters above      */
+/* Clusters, searches the number of clusters in that range instead    */
+/* (without the initial solution) and returns the chosen one. In      */
+/* both cases metrics, trajectory, checkpoints and best-so-far        */
+/* solutions are not written. A single run saves a checkpoint to      */
+/* files->CkptName every Checkpoint iterations and with Resume        */
+/* continues from it. The whole job stops after TimeLimit seconds     */
+/* (0 = no limit) with the best solution found: repeats and cluster   */
+/* counts share that deadline, and those not started by then are      */
+/* skipped.                                                           */
+/* ------------------------------------------------------------------ */
+
+
+static int RunClustering(TRAININGSET *TS, CODEBOOK *CB, PARTITIONING *P,
+int useInitial, RUNSTATS *metrics, TRAJECTORY *trajectory, RUNFILES *files)
+{
+  DENRSOPTIONS  options;
+  DENRSCONTEXT *ctx;
+  REPEATSTATS   stats;
+  KRANGE        range;
+  double       *errors;
+  int           result;
+
+  DefaultDenRSOptions(&options);
+  options.Iterations       = Value(Iterations);
+  options.KMeansIterations = Value(KMeansIterations);
+  options.Deterministic    = Value(Deterministic);
+  options.QuietLevel       = Value(QuietLevel);
+  options.Monitoring       = Value(MonitorProgress);
+  options.Threads          = Value(Threads);
+  options.Trials           = Value(ParallelSwaps);
+  options.Bounded          = Value(Bounds);
+  options.Indexed          = Value(GridIndex);
+  options.Seeding          = Value(Seeding);
+  options.Seed             = Value(RandomSeed);
+  options.TimeLimit        = Value(TimeLimit);
+
+  ctx             = CreateDenRSContext(&options);
+  ctx->Output     = PrintRunMessage;
+  ctx->Weights    = files->Weights;
+  if (Value(MaxClusters) > Value(Clusters))
+    {
+    FreeCodebook(CB);
+    FreePartitioning(P);
+    result = RunDenRSRange(ctx, TS, CB, P, Value(Clusters),
+                           Value(MaxClusters), Value(RangeChain),
+                           Value(WarmIterations), &range);
+    if (!result && Value(QuietLevel))  PrintRange(&range);
+    if (result)
+      {
+      /* the caller frees the solution */
+      CreateNewCodebook(CB, Value(Clusters), TS);
+      CreateNewPartitioning(P, TS, Value(Clusters));
+      }
+    FreeKRange(&range);
+    }
+  else if (Value(Repeats) > 1)
+    {
+    errors = (double*) malloc(Value(Repeats) * sizeof(double));
+    if (!errors)
+      {
+      ErrorMessage("ERROR: Allocating memory failed!\n");
+      ExitProcessing(FATAL_ERROR);
+      }
+    result = RunDenRSRepeats(ctx, TS, CB, P, useInitial, Value(Repeats),
+                             errors, &stats);
+    if (!result && Value(QuietLevel))  PrintRepeats(&stats, errors);
+    free(errors);
+    }
+  else
+    {
+    ctx->Metrics    = metrics;
+    ctx->Trajectory = trajectory;
+    if (*files->CkptName)
+      {
+      ctx->Checkpoint = files->CkptName;
+      ctx->Interval   = Value(Checkpoint);
+      ctx->Resume     = Value(Resume);
+      }
+    if (Value(BestInterval) > 0)
+      {
+      ctx->User     = files;
+      ctx->Solution = WriteBestSoFar;
+      ctx->Period   = Value(BestInterval);
+      }
+    result          = RunDenRS(ctx, TS, CB, P, useInitial);
+    }
+  FreeDenRSContext(ctx);
+
+  return result;
+}
+
+
 /* ===========================  MAIN  ================================ */
 
 
@@ -107,8 +442,20 @@ int main(int argc, char* argv[])
   char          InName[MAXFILENAME] = {'\0'};
   char          OutCBName[MAXFILENAME] = {'\0'};
   char          OutPAName[MAXFILENAME] = {'\0'};
+  char          MetricsName[MAXFILENAME] = {'\0'};
+  char          TrajName[MAXFILENAME] = {'\0'};
+  char          CkptName[MAXFILENAME] = {'\0'};
+  char          WeightName[MAXFILENAME] = {'\0'};
+  RUNSTATS      metrics;
+  RUNFILES      files;
+  TRAJECTORY    trajectory;
+  MAPPEDSET     mapping;
+  int           mapped;
+  int           single, saveMetrics, saveTrajectory;
   int           useInitial = 0; 
+  int           kmax;
   char*         genMethod;
+  llong*        sse;
   ParameterInfo paraminfo[3] = { { TSName,  FormatNameTS, 0, INFILE },
                                  { InName,  FormatNameCB, 1, INFILE },
                                  { OutCBName,  FormatNameCB, 0, OUTFILE } };
@@ -122,37 +469,86 @@ int main(int argc, char* argv[])
     CheckFileName(OutPAName, FormatNamePA);
     }
   
-  TS = CheckParameters(TSName, OutCBName, OutPAName, InName, 
-       Value(Clusters), Value(OverWrite));
+  mapped = ReadTrainingData(TSName, OutCBName, OutPAName, InName,
+           &TS, &mapping);
   
   useInitial = ReadInitialCBorPA(InName, Value(Clusters), &TS, &CB, &P);
   
   genMethod = PrintInitialData(TSName, InName, OutCBName, 
               OutPAName, useInitial);
+
+  /* metrics and trajectory follow a single run */
+  single         = (Value(Repeats) <= 1 &&
+                    Value(MaxClusters) <= Value(Clusters));
+  saveMetrics    = single ? Value(SaveMetrics) : STATS_NONE;
+  saveTrajectory = single ? Value(SaveTrajectory) : 0;
+  if (saveMetrics)
+    {
+    PickOutputName(OutCBName, MetricsName,
+                   (saveMetrics == STATS_JSON) ? ".json" : ".csv");
+    }
+  OpenRunStats(&metrics, MetricsName, saveMetrics);
+  if (saveTrajectory)  PickOutputName(OutCBName, TrajName, ".trj");
+  OpenTrajectory(&trajectory, saveTrajectory ? TrajName : NULL, &TS, &CB);
+  if (single && (Value(Checkpoint) > 0 || Value(Resume)))
+    {
+    PickOutputName(OutCBName, CkptName, ".ckp");
+    }
+  /* the weights of the clusters go next to the codebook */
+  PickOutputName(OutCBName, WeightName, ".wgt");
+  CheckOutputFile(WeightName);
+  files.CBName     = OutCBName;
+  files.PAName     = OutPAName;
+  files.WeightName = WeightName;
+  files.CkptName   = CkptName;
+  files.TS         = &TS;
+  kmax             = (Value(MaxClusters) > Value(Clusters)) ?
+                     Value(MaxClusters) : Value(Clusters);
+  files.Weights    = (double*) malloc(kmax * sizeof(double));
+  files.Written    = NO;
+  if (!files.Weights)
+    {
+    ErrorMessage("ERROR: Allocating memory failed!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
     
-  if (PerformDenRS(&TS, &CB, &P, Value(Iterations), 
-      Value(KMeansIterations), Value(Deterministic), 
-      Value(QuietLevel), useInitial, Value(MonitorProgress)))
+  if (RunClustering(&TS, &CB, &P, useInitial, &metrics, &trajectory, &files))
     {
     ErrorMessage("ERROR: Clustering failed!\n");
-    FreeCodebook(&TS);
+    CloseRunStats(&metrics);
+    CloseTrajectory(&trajectory);
+    FreeTrainingData(&TS, &mapping, mapped);
     FreeCodebook(&CB);
     FreePartitioning(&P);
+    free(files.Weights);
     free(genMethod);
     ExitProcessing(FATAL_ERROR);
     }
 
+  CloseRunStats(&metrics);
+  CloseTrajectory(&trajectory);
   AddGenerationMethod(&CB, genMethod); 
-  WriteCodebook(OutCBName, &CB, Value(OverWrite));
+  /* best-so-far solutions of this run are overwritten */
+  WriteCodebook(OutCBName, &CB, Value(OverWrite) || files.Written);
+  sse = NULL;
+  if (Value(SavePartition))
+    {
+    sse = (llong*) malloc(BookSize(&CB) * sizeof(llong));
+    if (sse)  PartitionErrors(&TS, &CB, &P, sse);
+    }
+  WriteWeights(WeightName, files.Weights, sse, BookSize(&CB),
+               Value(OverWrite) || files.Written);
   
   if (Value(SavePartition))
     {
-    WritePartitioning(OutPAName, &P, &TS, Value(OverWrite));
+    WritePartitioning(OutPAName, &P, &TS, Value(OverWrite) || files.Written);
     }
   
-  FreeCodebook(&TS);
+  FreeTrainingData(&TS, &mapping, mapped);
   FreeCodebook(&CB);
   FreePartitioning(&P);
+  free(files.Weights);
+  free(sse);
   free(genMethod);
  
   return EVERYTHING_OK;
@@ -0,0 +1,383 @@
+/*-------------------------------------------------------------------*/
+/* CBDENASSIGN.C   agent.                                            */
+/*                                                                   */
+/* Labels new vectors with a codebook and the centroid weights that  */
+/* CBDEN saved with it (see DENASSIGN.C). The vectors are read from  */
+/* a binary dataset (see CBDENBIN) or as whitespace separated        */
+/* numbers from a file or the standard input, and are labelled in    */
+/* batches as they arrive. The labels (one per line, starting from   */
+/* 1, as written by CBDENTRAJ) go to a file or the standard output.  */
+/*                                                                   */
+/* ChangeLog:                                                        */
+/*                                                                   */
+/* 0.02: 17.10.26 AG: Numbers out of the element range are rejected. */
+/* 0.01: 17.10.26 AG: Initial version.                               */
+/*-------------------------------------------------------------------*/
+
+#define ProgName        "CBDENASSIGN"
+#define VersionNumber   "Version 0.02"
+#define LastUpdated     "17.10.2026"
+
+/* Vectors labelled at a time unless given. */
+#define ASSIGN_BATCH    65536
+/* Size of the text input buffer. */
+#define ASSIGN_BUFFER   (1 << 20)
+/* Longest label line. */
+#define ASSIGN_LABEL    12
+
+/* ------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "cb.h"
+#include "file.h"
+#include "interfc.h"
+#include "denutil.h"
+#include "denkern.h"
+#include "denstore.h"
+#include "denmap.h"
+#include "denassign.h"
+
+
+/* Buffered text input. The buffer is filled with what read() returns,
+   so the vectors of a stream are labelled as soon as they arrive. */
+typedef struct
+  {
+  int            File;
+  int            Stream;        /* pipe or terminal, not a file       */
+  unsigned char *Data;
+  size_t         Size;
+  size_t         Pos;
+  llong          Numbers;       /* numbers read so far                */
+  } TEXTINPUT;
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+/* ------------------------------------------------------------------ */
+/* Next character, EOF at the end of the input.                       */
+/* ------------------------------------------------------------------ */
+
+
+static int NextChar(TEXTINPUT *in)
+{
+  ssize_t got;
+
+  if (in->Pos == in->Size)
+    {
+    do  got = read(in->File, in->Data, ASSIGN_BUFFER);
+    while (got < 0 && errno == EINTR);
+    if (got < 0)
+      {
+      ErrorMessage("ERROR: Reading the input failed!\n");
+      ExitProcessing(FATAL_ERROR);
+      }
+    in->Size = (size_t) got;
+    in->Pos  = 0;
+    if (in->Size == 0)  return EOF;
+    }
+  return in->Data[in->Pos++];
+}
+
+
+/* ------------------------------------------------------------------ */
+/* Skips the white space in the buffer; returns 0 if nothing else is  */
+/* buffered.                                                          */
+/* ------------------------------------------------------------------ */
+
+
+static int Buffered(TEXTINPUT *in)
+{
+  int c;
+
+  for (; in->Pos < in->Size; in->Pos++)
+    {
+    c = in->Data[in->Pos];
+    if (c != ' ' && c != '\t' && c != '\n' && c != '\r')  return 1;
+    }
+  return 0;
+}
+
+
+/* ------------------------------------------------------------------ */
+/* Reads the next integer; returns 0 at the end of the input. Text    */
+/* and numbers that VECTORELEMENT cannot hold are fatal errors.       */
+/* ------------------------------------------------------------------ */
+
+
+static int ReadNumber(TEXTINPUT *in, VECTORELEMENT *x)
+{
+  llong value = 0;
+  int   c, sign = 1, digits = 0;
+
+  do  c = NextChar(in);
+  while (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+  if (c == EOF)  return 0;
+
+  if (c == '-' || c == '+')
+    {
+    if (c == '-')  sign = -1;
+    c = NextChar(in);
+    }
+  for (; c >= '0' && c <= '9'; c = NextChar(in), digits++)
+    {
+    value = 10 * value + (c - '0');
+    }
+
+  if (digits == 0 || digits > 18 ||
+      (c != ' ' && c != '\t' && c != '\n' && c != '\r' && c != EOF))
+    {
+    ErrorMessage("ERROR: Number %lld of the input is not an integer!\n",
+                 in->Numbers + 1);
+    ExitProcessing(FATAL_ERROR);
+    }
+  value *= sign;
+  if ((llong) (VECTORELEMENT) value != value)
+    {
+    ErrorMessage("ERROR: Number %lld of the input is out of range!\n",
+                 in->Numbers + 1);
+    ExitProcessing(FATAL_ERROR);
+    }
+  in->Numbers++;
+  *x = (VECTORELEMENT) value;
+  return 1;
+}
+
+
+/* ------------------------------------------------------------------ */
+/* Reads at most batch vectors into S; returns the number read. A     */
+/* stream returns early rather than wait for more input.              */
+/* ------------------------------------------------------------------ */
+
+
+static int ReadBatch(TEXTINPUT *in, DENSESTORE *S, int batch)
+{
+  VECTORELEMENT *v;
+  int            n, d;
+
+  for (n = 0; n < batch; n++)
+    {
+    if (in->Stream && n > 0 && !Buffered(in))  return n;
+    v = DenseVector(S, n);
+    for (d = 0; d < S->Dim; d++)
+      {
+      if (ReadNumber(in, &v[d]))  continue;
+      if (d == 0)  return n;
+      ErrorMessage("ERROR: The input ends in the middle of a vector!\n");
+      ExitProcessing(FATAL_ERROR);
+      }
+    }
+  return n;
+}
+
+
+/* ------------------------------------------------------------------ */
+
+
+static void WriteLabels(FILE *f, int *label, int count, char *buffer)
+{
+  char *p = buffer, digit[ASSIGN_LABEL];
+  int   n, x, k;
+
+  for (n = 0; n < count; n++)
+    {
+    x = label[n] + 1;
+    k = 0;
+    do
+      {
+      digit[k++] = (char) ('0' + x % 10);
+      x         /= 10;
+      }
+    while (x > 0);
+    while (k > 0)  *p++ = digit[--k];
+    *p++ = '\n';
+    }
+  fwrite(buffer, 1, p - buffer, f);
+  fflush(f);
+}
+
+
+/* ------------------------------------------------------------------ */
+/* Labels a binary dataset in place, batch vectors at a time.         */
+/* ------------------------------------------------------------------ */
+
+
+static llong AssignMapped(char *name, CODEBOOK *CB, PACKEDBOOK *PB,
+FILE *out, int *label, char *buffer, int batch, int threads)
+{
+  TRAININGSET TS;
+  MAPPEDSET   M;
+  llong       total;
+  int         first, count;
+
+  ReadMappedDataset(name, &TS, &M);
+  if (VectorSize(&TS) != VectorSize(CB))
+    {
+    ErrorMessage("ERROR: Dimensions of %s and the codebook differ!\n",
+                 name);
+    ExitProcessing(FATAL_ERROR);
+    }
+
+  for (first = 0; first < BookSize(&TS); first += count)
+    {
+    count = BookSize(&TS) - first;
+    if (count > batch)  count = batch;
+    AssignVectors(&TS, first, count, PB, label, threads);
+    WriteLabels(out, label, count, buffer);
+    }
+  total = BookSize(&TS);
+  FreeMappedDataset(&TS, &M);
+  return total;
+}
+
+
+/* ------------------------------------------------------------------ */
+/* Labels the text input, batch vectors at a time.                    */
+/* ------------------------------------------------------------------ */
+
+
+static llong AssignText(FILE *f, CODEBOOK *CB, PACKEDBOOK *PB, FILE *out,
+int *label, char *buffer, int batch, int threads)
+{
+  TRAININGSET B;
+  DENSESTORE  S;
+  TEXTINPUT   in;
+  struct stat st;
+  llong       total = 0;
+  int         count;
+
+  memset(&in, 0, sizeof(TEXTINPUT));
+  in.File   = fileno(f);
+  in.Stream = (fstat(in.File, &st) != 0 || !S_ISREG(st.st_mode));
+  in.Data   = (unsigned char*) DenAlloc(ASSIGN_BUFFER);
+
+  CreateNewCodebook(&B, batch, CB);
+  AttachDenseStore(&S, &B, 0);
+  while ((count = ReadBatch(&in, &S, batch)) > 0)
+    {
+    AssignVectors(&B, 0, count, PB, label, threads);
+    WriteLabels(out, label, count, buffer);
+    total += count;
+    }
+  DetachDenseStore(&S, &B);
+  FreeCodebook(&B);
+  free(in.Data);
+  return total;
+}
+
+
+/* ===========================  MAIN  ================================ */
+
+
+int main(int argc, char* argv[])
+{
+  CODEBOOK   CB;
+  PACKEDBOOK PB;
+  FILE      *in, *out;
+  double    *weight;
+  char      *buffer;
+  int       *order, *label;
+  int        threads = 0, batch = ASSIGN_BATCH;
+  llong      total;
+
+  if (argc < 5 || argc > 7)
+    {
+    PrintMessage("%s\t%s\t%s\n\n"
+        "Labels vectors with the nearest centroid of a CBDEN codebook\n"
+        "by the weighted rule w_j*||x - c_j||.\n"
+        "Use: %s <codebook> <weights> <vectors> <labels> [threads] "
+        "[batch]\n"
+        "Vectors and labels may be - for the standard input and output;\n"
+        "threads 0 uses all processors.\n\n",
+        ProgName, VersionNumber, LastUpdated, ProgName);
+    return EVERYTHING_OK;
+    }
+
+  if (argc > 5)  threads = atoi(argv[5]);
+  if (argc > 6)  batch   = atoi(argv[6]);
+  if (threads <= 0)
+    {
+#ifdef _OPENMP
+    threads = omp_get_num_procs();
+#else
+    threads = 1;
+#endif
+    }
+  if (batch < 1)
+    {
+    ErrorMessage("ERROR: Batch size must be positive!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
+
+  ReadCodebook(argv[1], &CB);
+  weight = (double*) DenAlloc(BookSize(&CB) * sizeof(double));
+  ReadWeights(argv[2], weight, NULL, BookSize(&CB));
+
+  /* the centroids stand in for the data when ordering the dimensions */
+  order = (int*) DenAlloc(VectorSize(&CB) * sizeof(int));
+  DimensionOrder(&CB, order);
+  InitPackedCodebook(&PB);
+  PB.Order = order;
+  PackCodebook(&CB, weight, &PB);
+
+  out = stdout;
+  if (strcmp(argv[4], "-") != 0)  out = fopen(argv[4], "w");
+  if (!out)
+    {
+    ErrorMessage("ERROR: Cannot create %s!\n", argv[4]);
+    ExitProcessing(FATAL_ERROR);
+    }
+  label  = (int*) DenAlloc(batch * sizeof(int));
+  buffer = (char*) DenAlloc((size_t) batch * ASSIGN_LABEL);
+
+  if (strcmp(argv[3], "-") != 0 && IsMappedDataset(argv[3]))
+    {
+    total = AssignMapped(argv[3], &CB, &PB, out, label, buffer, batch,
+                         threads);
+    }
+  else
+    {
+    in = stdin;
+    if (strcmp(argv[3], "-") != 0)  in = fopen(argv[3], "r");
+    if (!in)
+      {
+      ErrorMessage("ERROR: Cannot open %s!\n", argv[3]);
+      ExitProcessing(FATAL_ERROR);
+      }
+    total = AssignText(in, &CB, &PB, out, label, buffer, batch, threads);
+    if (in != stdin)  fclose(in);
+    }
+
+  if (out != stdout)
+    {
+    if (ferror(out) | fclose(out))
+      {
+      ErrorMessage("ERROR: Writing %s failed!\n", argv[4]);
+      ExitProcessing(FATAL_ERROR);
+      }
+    PrintMessage("%lld vectors labelled with %i centroids\n", total,
+                 BookSize(&CB));
+    }
+
+  FreePackedCodebook(&PB);
+  FreeCodebook(&CB);
+  free(weight);
+  free(order);
+  free(label);
+  free(buffer);
+  return EVERYTHING_OK;
+}
+
+
+/* ----------------------------------------------------------------- */
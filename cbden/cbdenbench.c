@@ -0,0 +1,576 @@
+/*-------------------------------------------------------------------*/
+/* CBDENBENCH.C    agent.                                            */
+/*                                                                   */
+/* Benchmarks for the density-based random swap. Generates a set of  */
+/* nested clusters (a sparse cluster with a dense one inside, as in  */
+/* the j1/j2 sets, at any size) and times the main operations and a  */
+/* full CBDEN run. Rates are reported in points or iterations per    */
+/* second. With -K, the cluster-count search of k..K is timed        */
+/* against cold runs of each count and their WB-indices compared.    */
+/*                                                                   */
+/* ChangeLog:                                                        */
+/*                                                                   */
+/* 0.06: 17.10.26 AG: Reference search in the dimension order.       */
+/* 0.05: 17.10.26 AG: Cluster-count search against cold runs (-K).   */
+/* 0.04: 17.10.26 AG: Partition reset between passes, volatile sink. */
+/* 0.03: 17.10.26 AG: Seeding of the full run (-S).                  */
+/* 0.02: 17.10.26 AG: Operations use a workspace.                    */
+/* 0.01: 17.10.26 AG: Initial version.                               */
+/*-------------------------------------------------------------------*/
+
+#define ProgName        "CBDENBENCH"
+#define VersionNumber   "Version 0.06"
+#define LastUpdated     "17.10.2026"
+
+/* Coordinates of the generated data are in 0..BENCH_SCALE. */
+#define BENCH_SCALE     1000000
+#define BENCH_MAXRESULT 8
+
+/* ------------------------------------------------------------------- */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cb.h"
+#include "file.h"
+#include "interfc.h"
+#include "memctrl.h"
+#include "random.h"
+#include "denkern.h"
+#include "denwork.h"
+#include "dentrial.h"
+#include "denstats.h"
+#include "denstore.h"
+#include "denmap.h"
+#include "dentraj.h"
+#include "denrs.h"
+#include "denseed.h"
+#include "denrange.h"
+
+
+/* ========================== PROTOTYPES ============================= */
+
+typedef struct
+  {
+  int     N;             /* data vectors                             */
+  int     Dim;           /* dimensions                               */
+  int     Clusters;      /* clusters (pairs of outer and nested)     */
+  double  Ratio;         /* std of an outer / nested cluster         */
+  int     Uniform;       /* uniform instead of Gaussian clusters     */
+  int     Seed;
+  int     Iterations;    /* swap iterations of the full run          */
+  int     KMeans;        /* K-means iterations per swap              */
+  int     Threads;
+  int     Seeding;       /* initial centroids of the full run        */
+  int     RangeMax;      /* last count of the range search, 0 = none */
+  int     WarmIter;      /* swap iterations of a warm count, 0 = -i  */
+  double  MinTime;       /* minimum time per micro-benchmark (s)     */
+  char   *Output;        /* binary file for the generated set        */
+  } BENCHSETUP;
+
+typedef struct
+  {
+  char   *Name;
+  char   *Unit;
+  int     Repeats;
+  double  Time;
+  double  Rate;
+  } BENCHRESULT;
+
+static unsigned long long BenchState;
+
+/* Results of the searches go here, so they are not optimized away. */
+static volatile llong BenchSink;
+
+static void   ParseBench(int argc, char *argv[], BENCHSETUP *B);
+static void   GenerateNested(TRAININGSET *TS, BENCHSETUP *B);
+static double Uniform01(void);
+static double Coordinate(double center, double sigma, int uniform);
+static void   InitialSolution(TRAININGSET *TS, CODEBOOK *CB,
+    PARTITIONING *P, double *weight, WORKSPACE *W);
+static void   AddResult(BENCHRESULT *R, int *count, char *name, char *unit,
+    int repeats, double time, double work);
+static void   RangeBenchmark(TRAININGSET *TS, BENCHSETUP *B, int threads,
+    BENCHRESULT *R, int *count);
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+static void PrintInfo(void)
+{
+  PrintMessage("%s\t%s\t%s\n\n"
+      "Benchmarks the density-based random swap on generated data.\n"
+      "Use: %s [options]\n\n  Options:\n"
+      "  -n N       data vectors (100000)\n"
+      "  -d D       dimensions (2)\n"
+      "  -k k       clusters, in nested pairs (20)\n"
+      "  -r ratio   std of outer / nested cluster (8)\n"
+      "  -u         uniform instead of Gaussian clusters\n"
+      "  -s seed    random seed (1)\n"
+      "  -i iter    swap iterations of the full run (100)\n"
+      "  -m iter    K-means iterations per swap (2)\n"
+      "  -t threads threads, 0 = default (0)\n"
+      "  -S mode    seeding: 0 random, 1 k-means++, 2 density (0)\n"
+      "  -K kmax    range search of k..kmax against cold runs (0 = off)\n"
+      "  -W iter    swap iterations of a warm count, 0 = -i (0)\n"
+      "  -T sec     minimum time per micro-benchmark (1.0)\n"
+      "  -o file    save the generated set (binary format)\n\n",
+      ProgName, VersionNumber, LastUpdated, ProgName);
+}
+
+
+/* ------------------------------------------------------------------ */
+
+
+static void ParseBench(int argc, char *argv[], BENCHSETUP *B)
+{
+  int i;
+
+  B->N          = 100000;
+  B->Dim        = 2;
+  B->Clusters   = 20;
+  B->Ratio      = 8.0;
+  B->Uniform    = 0;
+  B->Seed       = 1;
+  B->Iterations = 100;
+  B->KMeans     = 2;
+  B->Threads    = 0;
+  B->Seeding    = SEED_RANDOM;
+  B->RangeMax   = 0;
+  B->WarmIter   = 0;
+  B->MinTime    = 1.0;
+  B->Output     = NULL;
+
+  for (i = 1; i < argc; i++)
+    {
+    if (argv[i][0] != '-' || argv[i][1] == '\0' || argv[i][2] != '\0')
+      {
+      PrintInfo();
+      ExitProcessing(FATAL_ERROR);
+      }
+    if (argv[i][1] == 'u')
+      {
+      B->Uniform = 1;
+      continue;
+      }
+    if (i + 1 >= argc)
+      {
+      PrintInfo();
+      ExitProcessing(FATAL_ERROR);
+      }
+    switch (argv[i][1])
+      {
+      case 'n': B->N          = atoi(argv[++i]); break;
+      case 'd': B->Dim        = atoi(argv[++i]); break;
+      case 'k': B->Clusters   = atoi(argv[++i]); break;
+      case 'r': B->Ratio      = atof(argv[++i]); break;
+      case 's': B->Seed       = atoi(argv[++i]); break;
+      case 'i': B->Iterations = atoi(argv[++i]); break;
+      case 'm': B->KMeans     = atoi(argv[++i]); break;
+      case 't': B->Threads    = atoi(argv[++i]); break;
+      case 'S': B->Seeding    = atoi(argv[++i]); break;
+      case 'K': B->RangeMax   = atoi(argv[++i]); break;
+      case 'W': B->WarmIter   = atoi(argv[++i]); break;
+      case 'T': B->MinTime    = atof(argv[++i]); break;
+      case 'o': B->Output     = argv[++i];       break;
+      default:
+        PrintInfo();
+        ExitProcessing(FATAL_ERROR);
+      }
+    }
+
+  if (B->N < 1 || B->Dim < 1 || B->Clusters < 1 || B->Clusters > B->N ||
+      B->Ratio < 1.0 || B->Iterations < 0 || B->KMeans < 0 ||
+      B->Threads < 0 || B->Seeding < SEED_RANDOM ||
+      B->Seeding > SEED_DENSITY || B->WarmIter < 0 ||
+      (B->RangeMax != 0 && (B->RangeMax < B->Clusters ||
+                            B->RangeMax > B->N)))
+    {
+    ErrorMessage("ERROR: Invalid benchmark parameters!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
+}
+
+
+/* ------------------------------------------------------------------ */
+/* Private generator (splitmix64), so that the data does not depend   */
+/* on the toolkit random number generator.                            */
+/* ------------------------------------------------------------------ */
+
+
+static double Uniform01(void)
+{
+  unsigned long long z;
+
+  z = (BenchState += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z = z ^ (z >> 31);
+  return ((z >> 11) + 0.5) / 9007199254740992.0;
+}
+
+
+/* ------------------------------------------------------------------ */
+/* Uniform clusters have the same standard deviation as Gaussian.     */
+/* ------------------------------------------------------------------ */
+
+
+static double Coordinate(double center, double sigma, int uniform)
+{
+  double x;
+
+  if (uniform)
+    {
+    x = center + (2.0 * Uniform01() - 1.0) * sqrt(3.0) * sigma;
+    }
+  else
+    {
+    x = center + sigma * sqrt(-2.0 * log(Uniform01())) *
+        cos(2.0 * M_PI * Uniform01());
+    }
+  if (x < 0)            x = 0;
+  if (x > BENCH_SCALE)  x = BENCH_SCALE;
+  return x;
+}
+
+
+/* ------------------------------------------------------------------ */
+/* Clusters come in pairs: an outer cluster and a nested one, Ratio   */
+/* times narrower, placed half a deviation off the outer center.      */
+/* With odd k, the last cluster has no nested pair. Each cluster gets */
+/* N/k vectors.                                                       */
+/* ------------------------------------------------------------------ */
+
+
+static void GenerateNested(TRAININGSET *TS, BENCHSETUP *B)
+{
+  CODEBOOK base;
+  double   center[B->Dim], sigma, s;
+  int      i, c, d, pairs = (B->Clusters + 1) / 2;
+
+  memset(&base, 0, sizeof(CODEBOOK));
+  base.BlockSizeX      = B->Dim;
+  base.BlockSizeY      = 1;
+  base.BytesPerElement = sizeof(VECTORELEMENT);
+  base.MinValue        = 0;
+  base.MaxValue        = BENCH_SCALE;
+  CreateNewCodebook(TS, B->N, &base);
+
+  BenchState = (unsigned long long) B->Seed;
+  sigma      = 0.15 * BENCH_SCALE / pow(pairs, 1.0 / B->Dim);
+
+  for (i = 0, c = -1; i < B->N; i++)
+    {
+    /* next cluster; outer ones pick a new center */
+    if (i * (llong) B->Clusters / B->N != c)
+      {
+      c = i * (llong) B->Clusters / B->N;
+      if (c % 2 == 0)
+        {
+        for (d = 0; d < B->Dim; d++)
+          center[d] = (0.15 + 0.7 * Uniform01()) * BENCH_SCALE;
+        }
+      }
+    s = (c % 2 == 0) ? sigma : sigma / B->Ratio;
+    for (d = 0; d < B->Dim; d++)
+      {
+      VectorScalar(TS, i, d) = (VECTORELEMENT) Coordinate(center[d] +
+          ((c % 2 && d == 0) ? 0.5 * sigma : 0.0), s, B->Uniform);
+      }
+    VectorFreq(TS, i) = 1;
+    }
+  TotalFreq(TS) = B->N;
+}
+
+
+/* ------------------------------------------------------------------ */
+/* Solution of the micro-benchmarks: random centroids, nearest        */
+/* partition and density weights. The full run does not start from   */
+/* it; RunDenRS seeds its own centroids by -S.                        */
+/* ------------------------------------------------------------------ */
+
+
+static void InitialSolution(TRAININGSET *TS, CODEBOOK *CB,
+PARTITIONING *P, double *weight, WORKSPACE *W)
+{
+  int j;
+
+  SelectRandomRepresentatives(TS, CB, NULL);
+  GenerateOptimalPartitioning(TS, CB, P);
+  for (j = 0; j < BookSize(CB); j++)
+    {
+    if (CCFreq(P, j) > 0)  PartitionCentroid(P, j, &Node(CB, j));
+    }
+  CalculateNewWeights(TS, CB, P, weight, NULL, W);
+}
+
+
+/* ------------------------------------------------------------------ */
+
+
+static void AddResult(BENCHRESULT *R, int *count, char *name, char *unit,
+int repeats, double time, double work)
+{
+  R[*count].Name    = name;
+  R[*count].Unit    = unit;
+  R[*count].Repeats = repeats;
+  R[*count].Time    = time;
+  R[*count].Rate    = (time > 0) ? work / time : 0.0;
+  (*count)++;
+}
+
+
+/* ------------------------------------------------------------------ */
+/* Times RunDenRSRange for k = Clusters..RangeMax (one chain) and the */
+/* same counts clustered from scratch with the seeds the search uses, */
+/* and prints the WB-index of each count for both.                    */
+/* ------------------------------------------------------------------ */
+
+
+static void RangeBenchmark(TRAININGSET *TS, BENCHSETUP *B, int threads,
+BENCHRESULT *R, int *count)
+{
+  DENRSOPTIONS  options;
+  DENRSCONTEXT *ctx;
+  KRANGE        range;
+  CODEBOOK      CB;
+  PARTITIONING  P;
+  double       *cold, time, pass;
+  int           k, counts = B->RangeMax - B->Clusters + 1;
+
+  DefaultDenRSOptions(&options);
+  options.Iterations       = B->Iterations;
+  options.KMeansIterations = B->KMeans;
+  options.Threads          = threads;
+  options.Seeding          = B->Seeding;
+  options.Seed             = B->Seed;
+
+  ctx  = CreateDenRSContext(&options);
+  pass = WallClock();
+  if (RunDenRSRange(ctx, TS, &CB, &P, B->Clusters, B->RangeMax, 0,
+                    B->WarmIter, &range))
+    {
+    ErrorMessage("ERROR: Cluster-count search failed!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
+  AddResult(R, count, "RunDenRSRange", "counts/s", 1, WallClock() - pass,
+            (double) counts);
+  FreeDenRSContext(ctx);
+  FreeCodebook(&CB);
+  FreePartitioning(&P);
+
+  /* count k of the search uses the seed Seed + k */
+  cold = (double*) malloc(counts * sizeof(double));
+  if (!cold)
+    {
+    ErrorMessage("ERROR: Allocating memory failed!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
+  time = 0.0;
+  for (k = B->Clusters; k <= B->RangeMax; k++)
+    {
+    CreateNewCodebook(&CB, k, TS);
+    CreateNewPartitioning(&P, TS, k);
+    options.Seed = B->Seed + k;
+    ctx  = CreateDenRSContext(&options);
+    pass = WallClock();
+    if (RunDenRS(ctx, TS, &CB, &P, 0))
+      {
+      ErrorMessage("ERROR: Clustering failed!\n");
+      ExitProcessing(FATAL_ERROR);
+      }
+    time += WallClock() - pass;
+    cold[k - B->Clusters] = WBIndex(TS, &CB, &P, NULL);
+    FreeDenRSContext(ctx);
+    FreeCodebook(&CB);
+    FreePartitioning(&P);
+    }
+  AddResult(R, count, "RunDenRS per count", "counts/s", 1, time,
+            (double) counts);
+
+  PrintMessage("\nCluster-count search, WB-index (smaller is better)\n");
+  PrintMessage("%6s %5s %12s %12s\n", "k", "warm", "search", "cold");
+  for (k = B->Clusters; k <= B->RangeMax; k++)
+    {
+    KRESULT *res = &range.Result[k - range.Min];
+
+    if (res->Failed)
+      {
+      PrintMessage("%6i %5s %12s %12.5f\n", k, "-", "failed",
+                   cold[k - B->Clusters]);
+      }
+    else
+      {
+      PrintMessage("%6i %5i %12.5f %12.5f\n", k, res->Warm, res->Index,
+                   cold[k - B->Clusters]);
+      }
+    }
+  free(cold);
+  FreeKRange(&range);
+}
+
+
+/* ===========================  MAIN  ================================ */
+
+
+int main(int argc, char* argv[])
+{
+  BENCHSETUP    B;
+  BENCHRESULT   R[BENCH_MAXRESULT];
+  TRAININGSET   TS;
+  CODEBOOK      CB;
+  PARTITIONING  P;
+  DENSESTORE    TSstore, CBstore;
+  WORKSPACE     W;
+  DENRSOPTIONS  options;
+  DENRSCONTEXT *ctx;
+  double        *weight;
+  llong         *distance, *initialDistance, error;
+  int           *active, *initialMap;
+  double        start, time, pass;
+  int           i, j, n, reps, results = 0, threads, k;
+
+  ParseBench(argc, argv, &B);
+  threads = (B.Threads > 0) ? B.Threads : DefaultThreads();
+  k       = B.Clusters;
+
+  GenerateNested(&TS, &B);
+  if (B.Output != NULL)  WriteMappedDataset(B.Output, &TS);
+
+  initrandom(B.Seed);
+  CreateNewCodebook(&CB, k, &TS);
+  CreateNewPartitioning(&P, &TS, k);
+  weight   = (double*) malloc(k * sizeof(double));
+  active   = (int*) malloc(k * sizeof(int));
+  distance = (llong*) malloc(B.N * sizeof(llong));
+  initialDistance = (llong*) malloc(B.N * sizeof(llong));
+  initialMap      = (int*) malloc(B.N * sizeof(int));
+  if (!weight || !active || !distance || !initialDistance || !initialMap)
+    {
+    ErrorMessage("ERROR: Allocating memory failed!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
+
+  /* the micro-benchmarks use the storage that RunDenRS uses */
+  AttachDenseStore(&TSstore, &TS, 0);
+  AttachDenseStore(&CBstore, &CB, 1);
+  CreateWorkspace(&W, &TS, &CB, threads, 1);
+  InitialSolution(&TS, &CB, &P, weight, &W);
+  for (j = 0; j < k; j++)  active[j] = j;
+
+  /* nearest weighted centroid, one vector at a time */
+  start = WallClock();
+  for (reps = 0; reps == 0 || WallClock() - start < B.MinTime; reps++)
+    {
+    for (i = 0; i < B.N; i++)
+      {
+      BenchSink += FindNearestVectorWithWeight(&Node(&TS, i), &CB, &error,
+             Map(&P, i), EUCLIDEANSQ, weight, W.order);
+      }
+    }
+  time = WallClock() - start;
+  AddResult(R, &results, "FindNearestVectorWithWeight", "points/s", reps,
+            time, (double) reps * B.N);
+
+  /* K-means partition step with all clusters active (the worst case);
+     every pass starts from the initial partition, so that it does the
+     work of a first pass instead of confirming a converged one */
+  CalculateDistances(&TS, &CB, &P, initialDistance, weight, threads);
+  for (i = 0; i < B.N; i++)  initialMap[i] = Map(&P, i);
+  time = 0.0;
+  for (reps = 0; reps == 0 || time < B.MinTime; reps++)
+    {
+    for (i = 0; i < B.N; i++)
+      {
+      if (Map(&P, i) != initialMap[i])
+        {
+        ChangePartition(&TS, &P, initialMap[i], i);
+        }
+      }
+    memcpy(distance, initialDistance, B.N * sizeof(llong));
+    pass = WallClock();
+    OptimalPartition(NULL, &CB, &TS, &P, active, NULL, k, distance, weight,
+                     0, threads, NULL, &W);
+    time += WallClock() - pass;
+    }
+  AddResult(R, &results, "OptimalPartition", "points/s", reps, time,
+            (double) reps * B.N);
+
+  start = WallClock();
+  for (reps = 0; reps == 0 || WallClock() - start < B.MinTime; reps++)
+    {
+    CalculateNewWeights(&TS, &CB, &P, weight, NULL, &W);
+    }
+  time = WallClock() - start;
+  AddResult(R, &results, "CalculateNewWeights", "points/s", reps, time,
+            (double) reps * B.N);
+
+  start = WallClock();
+  for (reps = 0; reps == 0 || WallClock() - start < B.MinTime; reps++)
+    {
+    BenchSink += ObjectiveFunction(&P, &CB, &TS, weight, &W);
+    }
+  time = WallClock() - start;
+  AddResult(R, &results, "ObjectiveFunction", "points/s", reps, time,
+            (double) reps * B.N);
+
+  FreeWorkspace(&W);
+  DetachDenseStore(&CBstore, &CB);
+  DetachDenseStore(&TSstore, &TS);
+
+  /* full run from the seeding of -S */
+  FreePartitioning(&P);
+  CreateNewPartitioning(&P, &TS, k);
+  DefaultDenRSOptions(&options);
+  options.Iterations       = B.Iterations;
+  options.KMeansIterations = B.KMeans;
+  options.Threads          = threads;
+  options.Seeding          = B.Seeding;
+  options.Seed             = -1;
+  ctx   = CreateDenRSContext(&options);
+  start = WallClock();
+  if (RunDenRS(ctx, &TS, &CB, &P, 0))
+    {
+    ErrorMessage("ERROR: Clustering failed!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
+  time = WallClock() - start;
+  /* with -i 0 the run decides the number of iterations */
+  AddResult(R, &results, "RunDenRS", "iterations/s", 1, time,
+            (double) ctx->Iterations);
+  error = ctx->Error;
+  FreeDenRSContext(ctx);
+
+  if (B.RangeMax > 0)  RangeBenchmark(&TS, &B, threads, R, &results);
+
+  PrintMessage("\n%s\t%s\n", ProgName, VersionNumber);
+  PrintMessage("N=%i D=%i k=%i ratio=%g %s threads=%i kernel=%s\n",
+               B.N, B.Dim, k, B.Ratio, B.Uniform ? "uniform" : "gaussian",
+               threads, KernelName());
+  PrintMessage("%-28s %8s %10s %14s\n", "benchmark", "repeats", "time(s)",
+               "rate");
+  for (n = 0; n < results; n++)
+    {
+    PrintMessage("%-28s %8i %10.3f %14.1f %s\n", R[n].Name, R[n].Repeats,
+                 R[n].Time, R[n].Rate, R[n].Unit);
+    }
+  PrintMessage("Seeding %i: final error %lld (MSE %f)\n", B.Seeding,
+               error, (double) error / ((double) TotalFreq(&TS) * B.Dim));
+
+  free(weight);
+  free(active);
+  free(distance);
+  free(initialDistance);
+  free(initialMap);
+  FreeCodebook(&TS);
+  FreeCodebook(&CB);
+  FreePartitioning(&P);
+
+  return EVERYTHING_OK;
+}
+
+
+/* ----------------------------------------------------------------- */
@@ -0,0 +1,52 @@
+/*-------------------------------------------------------------------*/
+/* CBDENBIN.C      agent.                                            */
+/*                                                                   */
+/* Converts a training set to the binary format that CBDEN maps      */
+/* into memory (see DENMAP.C).                                       */
+/*                                                                   */
+/* ChangeLog:                                                        */
+/*                                                                   */
+/* 0.01: 17.10.26 AG: Initial version.                               */
+/*-------------------------------------------------------------------*/
+
+#define ProgName        "CBDENBIN"
+#define VersionNumber   "Version 0.01"
+#define LastUpdated     "17.10.2026"
+
+/* ------------------------------------------------------------------- */
+
+#include <stdio.h>
+
+#include "cb.h"
+#include "file.h"
+#include "interfc.h"
+#include "denmap.h"
+
+
+/* ===========================  MAIN  ================================ */
+
+
+int main(int argc, char* argv[])
+{
+  TRAININGSET TS;
+
+  if (argc != 3)
+    {
+    PrintMessage("%s\t%s\t%s\n\n"
+        "Converts a training set to the binary format of CBDEN.\n"
+        "Use: %s <dataset> <binary dataset>\n\n",
+        ProgName, VersionNumber, LastUpdated, ProgName);
+    return EVERYTHING_OK;
+    }
+
+  ReadTrainingSet(argv[1], &TS);
+  WriteMappedDataset(argv[2], &TS);
+  PrintMessage("%s: %i vectors of %i elements\n", argv[2], BookSize(&TS),
+      VectorSize(&TS));
+  FreeCodebook(&TS);
+
+  return EVERYTHING_OK;
+}
+
+
+/* ----------------------------------------------------------------- */
@@ -0,0 +1,134 @@
+/*-------------------------------------------------------------------*/
+/* CBDENTRAJ.C     agent.                                            */
+/*                                                                   */
+/* Reads a trajectory written by CBDEN (SaveTrajectory). Without an  */
+/* iteration, lists the accepted swaps. With one, rebuilds the       */
+/* solution after that iteration and writes the partition (one       */
+/* cluster per line, starting from 1) and optionally the centroids   */
+/* (one per line), as read by GENERALIZEDPLOTTING.M.                 */
+/*                                                                   */
+/* ChangeLog:                                                        */
+/*                                                                   */
+/* 0.01: 17.10.26 AG: Initial version.                               */
+/*-------------------------------------------------------------------*/
+
+#define ProgName        "CBDENTRAJ"
+#define VersionNumber   "Version 0.01"
+#define LastUpdated     "17.10.2026"
+
+/* ------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "cb.h"
+#include "interfc.h"
+#include "dentrial.h"
+#include "dentraj.h"
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+static FILE* CreateOutput(char *name)
+{
+  FILE *f = fopen(name, "w");
+
+  if (!f)
+    {
+    ErrorMessage("ERROR: Cannot create %s!\n", name);
+    ExitProcessing(FATAL_ERROR);
+    }
+  return f;
+}
+
+
+/* ------------------------------------------------------------------ */
+
+
+static void WriteState(TRAJSTATE *S, char *PAName, char *CBName)
+{
+  FILE *f;
+  int   i, d;
+
+  f = CreateOutput(PAName);
+  for (i = 0; i < S->Header.N; i++)  fprintf(f, "%i\n", S->map[i] + 1);
+  fclose(f);
+
+  if (CBName == NULL)  return;
+
+  f = CreateOutput(CBName);
+  for (i = 0; i < S->Header.Size; i++)
+    {
+    for (d = 0; d < S->Header.Dim; d++)
+      {
+      fprintf(f, (d > 0) ? " %i" : "%i",
+              S->centroid[(size_t) i * S->Header.Dim + d]);
+      }
+    fprintf(f, "\n");
+    }
+  fclose(f);
+}
+
+
+/* ===========================  MAIN  ================================ */
+
+
+int main(int argc, char* argv[])
+{
+  TRAJSTATE S;
+  FILE     *f;
+  int       i, iter;
+
+  if (argc != 2 && argc != 4 && argc != 5)
+    {
+    PrintMessage("%s\t%s\t%s\n\n"
+        "Lists the accepted swaps of a CBDEN trajectory, or rebuilds\n"
+        "the solution after an iteration.\n"
+        "Use: %s <trajectory>\n"
+        "     %s <trajectory> <iteration> <partition> [centroids]\n\n",
+        ProgName, VersionNumber, LastUpdated, ProgName, ProgName);
+    return EVERYTHING_OK;
+    }
+
+  iter = (argc > 2) ? atoi(argv[2]) : INT_MAX;
+  f    = OpenTrajectoryState(argv[1], &S);
+
+  if (argc == 2)
+    {
+    PrintMessage("%10s %8s %20s %10s %10s\n", "iteration", "swapped",
+                 "error", "centroids", "moves");
+    }
+  while (ReadTrajectoryRecord(f, &S, iter))
+    {
+    if (argc == 2)
+      {
+      PrintMessage("%10i %8i %20lld %10i %10i\n", S.Record.Iteration,
+                   S.Record.Swapped, S.Record.Error, S.Record.Centroids,
+                   S.Record.Moves);
+      }
+    }
+  fclose(f);
+
+  if (S.Record.Iteration < 0)
+    {
+    ErrorMessage("ERROR: No solution in %s!\n", argv[1]);
+    ExitProcessing(FATAL_ERROR);
+    }
+
+  if (argc > 2)
+    {
+    WriteState(&S, argv[3], (argc > 4) ? argv[4] : NULL);
+    PrintMessage("Iteration %i (accepted at %i): error %lld\nWeights:",
+                 iter, S.Record.Iteration, S.Record.Error);
+    for (i = 0; i < S.Header.Size; i++)  PrintMessage(" %f", S.weight[i]);
+    PrintMessage("\n");
+    }
+
+  FreeTrajectoryState(&S);
+  return EVERYTHING_OK;
+}
+
+
+/* ----------------------------------------------------------------- */
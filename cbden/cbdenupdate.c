@@ -0,0 +1,212 @@
+/*-------------------------------------------------------------------*/
+/* CBDENUPDATE.C   agent.                                            */
+/*                                                                   */
+/* Updates a CBDEN solution (codebook, centroid weights and          */
+/* partition) with a batch of new vectors instead of clustering the  */
+/* grown dataset again (see DENUPDATE.C). The new partition covers   */
+/* the vectors of the dataset followed by the new ones, so the new   */
+/* vectors are to be appended to the dataset before the next update. */
+/* Datasets may be text or binary (see CBDENBIN). The squared errors */
+/* of the clusters are read and written with the weights; a weight   */
+/* file without them costs one pass over the dataset. Existing       */
+/* output files are only replaced with -o.                           */
+/*                                                                   */
+/* ChangeLog:                                                        */
+/*                                                                   */
+/* 0.02: 17.10.26 AG: Cluster errors from the weight file; -o.       */
+/* 0.01: 17.10.26 AG: Initial version.                               */
+/*-------------------------------------------------------------------*/
+
+#define ProgName        "CBDENUPDATE"
+#define VersionNumber   "Version 0.02"
+#define LastUpdated     "17.10.2026"
+
+/* Swap trials unless given. */
+#define UPDATE_SWAPS    100
+
+/* ------------------------------------------------------------------- */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cb.h"
+#include "file.h"
+#include "interfc.h"
+#include "denkern.h"
+#include "denwork.h"
+#include "dentrial.h"
+#include "denstats.h"
+#include "denstore.h"
+#include "dentraj.h"
+#include "denrs.h"
+#include "denmap.h"
+#include "denassign.h"
+#include "denupdate.h"
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+static int ReadVectors(char *name, TRAININGSET *TS, MAPPEDSET *M)
+{
+  if (IsMappedDataset(name))
+    {
+    ReadMappedDataset(name, TS, M);
+    return 1;
+    }
+  ReadTrainingSet(name, TS);
+  return 0;
+}
+
+
+/* ------------------------------------------------------------------ */
+
+
+static void FreeVectors(TRAININGSET *TS, MAPPEDSET *M, int mapped)
+{
+  if (mapped)  FreeMappedDataset(TS, M);
+  else         FreeCodebook(TS);
+}
+
+
+/* ------------------------------------------------------------------ */
+/* Stops before the update if an output file exists and may not be    */
+/* overwritten.                                                       */
+/* ------------------------------------------------------------------ */
+
+
+static void CheckOutputFile(char *name, int overWrite)
+{
+  FILE *f;
+
+  if (overWrite)  return;
+  f = fopen(name, "r");
+  if (f)
+    {
+    fclose(f);
+    ErrorMessage("ERROR: File %s already exists!\n", name);
+    ExitProcessing(FATAL_ERROR);
+    }
+}
+
+
+/* ===========================  MAIN  ================================ */
+
+
+int main(int argc, char* argv[])
+{
+  TRAININGSET   Old, New, TS;
+  MAPPEDSET     OldMap, NewMap;
+  CODEBOOK      CB;
+  PARTITIONING  Pold, P;
+  DENRSOPTIONS  options;
+  DENRSCONTEXT *ctx;
+  UPDATESTATS   stats;
+  double       *weight;
+  llong        *sse;
+  int           oldMapped, newMapped, i, overWrite = NO;
+
+  if (argc > 1 && strcmp(argv[1], "-o") == 0)
+    {
+    overWrite = YES;
+    argv++;
+    argc--;
+    }
+  if (argc < 9 || argc > 13)
+    {
+    PrintMessage("%s\t%s\t%s\n\n"
+        "Updates a CBDEN solution with new vectors, refining only the\n"
+        "clusters they reach.\n"
+        "Use: %s [-o] <dataset> <partition> <codebook> <weights>\n"
+        "       <new vectors> <new codebook> <new partition> <new weights>\n"
+        "       [swaps] [K-means iterations] [seed] [threads]\n"
+        "The new partition covers the dataset followed by the new "
+        "vectors;\nthreads 0 uses all processors; -o overwrites existing "
+        "output files.\n\n",
+        ProgName, VersionNumber, LastUpdated, ProgName);
+    return EVERYTHING_OK;
+    }
+
+  DefaultDenRSOptions(&options);
+  options.Iterations = UPDATE_SWAPS;
+  if (argc > 9)   options.Iterations       = atoi(argv[9]);
+  if (argc > 10)  options.KMeansIterations = atoi(argv[10]);
+  if (argc > 11)  options.Seed             = atoll(argv[11]);
+  if (argc > 12)  options.Threads          = atoi(argv[12]);
+  CheckOutputFile(argv[6], overWrite);
+  CheckOutputFile(argv[7], overWrite);
+  CheckOutputFile(argv[8], overWrite);
+
+  oldMapped = ReadVectors(argv[1], &Old, &OldMap);
+  newMapped = ReadVectors(argv[5], &New, &NewMap);
+  ReadCodebook(argv[3], &CB);
+  if (VectorSize(&Old) != VectorSize(&CB) ||
+      VectorSize(&New) != VectorSize(&CB))
+    {
+    ErrorMessage("ERROR: Dimensions of the datasets and the codebook "
+                 "differ!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
+  ReadPartitioning(argv[2], &Pold, &Old);
+  if (PartitionCount(&Pold) != BookSize(&CB))
+    {
+    ErrorMessage("ERROR: %s and the codebook have different numbers of "
+                 "clusters!\n", argv[2]);
+    ExitProcessing(FATAL_ERROR);
+    }
+  weight = (double*) malloc(BookSize(&CB) * sizeof(double));
+  sse    = (llong*) malloc(BookSize(&CB) * sizeof(llong));
+  if (!weight || !sse)
+    {
+    ErrorMessage("ERROR: Allocating memory failed!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
+  if (!ReadWeights(argv[4], weight, sse, BookSize(&CB)))
+    {
+    PartitionErrors(&Old, &CB, &Pold, sse);
+    }
+
+  /* the old vectors keep their clusters; the update places the new */
+  JoinTrainingSets(&Old, &New, &TS);
+  CreateNewPartitioning(&P, &TS, BookSize(&CB));
+  for (i = 0; i < BookSize(&Old); i++)
+    {
+    if (Map(&P, i) != Map(&Pold, i))
+      {
+      ChangePartition(&TS, &P, Map(&Pold, i), i);
+      }
+    }
+  ctx = CreateDenRSContext(&options);
+  if (UpdateDenRS(ctx, &TS, BookSize(&Old), &CB, &P, weight, sse, &stats))
+    {
+    ErrorMessage("ERROR: Update failed!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
+  FreeDenRSContext(ctx);
+
+  WriteCodebook(argv[6], &CB, overWrite);
+  WritePartitioning(argv[7], &P, &TS, overWrite);
+  WriteWeights(argv[8], weight, sse, BookSize(&CB), overWrite);
+
+  PrintMessage("%i new vectors, %i of %i clusters affected\n"
+               "K-means iterations %i, swaps %i of %i accepted\n"
+               "Vectors moved %lld, searched %lld of %i\n",
+               stats.Added, stats.Affected, BookSize(&CB),
+               stats.Iterations, stats.Accepted, stats.Swaps,
+               stats.Moves, stats.Visited, BookSize(&TS));
+
+  FreePartitioning(&P);
+  FreePartitioning(&Pold);
+  FreeJoinedSet(&TS);
+  FreeVectors(&New, &NewMap, newMapped);
+  FreeVectors(&Old, &OldMap, oldMapped);
+  FreeCodebook(&CB);
+  free(weight);
+  free(sse);
+  return EVERYTHING_OK;
+}
+
+
+/* ----------------------------------------------------------------- */
@@ -0,0 +1,180 @@
+/*--------------------------------------------------------------------*/
+/* DENASSIGN.C     agent                                              */
+/*                                                                    */
+/* Labelling of new vectors with a trained codebook of the density-   */
+/* based random swap. Each vector gets the centroid j that minimizes  */
+/* w_j*||x - c_j||, the rule the clustering itself partitions with.   */
+/* The vectors are labelled in tiles by the nearest centroid kernel   */
+/* (see DENKERN.C) and the tiles are divided between threads. The     */
+/* centroid weights, with the squared errors of the clusters, are     */
+/* kept in a text file next to the codebook.                          */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.03: 17.10.26 AG: Cluster errors next to the weights.             */
+/* 0.02: 17.10.26 AG: Weight file is not overwritten unless allowed.  */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "cb.h"
+#include "interfc.h"
+#include "denkern.h"
+#include "denassign.h"
+
+
+#define min(a,b) ((a) < (b) ? (a) : (b))
+#define max(a,b) ((a) > (b) ? (a) : (b))
+
+/* longest line of a weight file */
+#define WEIGHT_LINE   256
+
+
+/* ========================== PROTOTYPES ============================= */
+
+static void WeightError(char *message, char *name);
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+void WriteWeights(char *name, double *weight, llong *sse, int size,
+int overWrite)
+{
+  FILE *f;
+  int   j;
+
+  if (!overWrite && (f = fopen(name, "r")) != NULL)
+    {
+    fclose(f);
+    WeightError("Will not overwrite the", name);
+    }
+  f = fopen(name, "w");
+  if (!f)  WeightError("Cannot create", name);
+
+  for (j = 0; j < size; j++)
+    {
+    if (sse != NULL)  fprintf(f, "%.17g %lld\n", weight[j], sse[j]);
+    else              fprintf(f, "%.17g\n", weight[j]);
+    }
+  if (ferror(f) | fclose(f))  WeightError("Writing failed for", name);
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+int ReadWeights(char *name, double *weight, llong *sse, int size)
+{
+  FILE  *f;
+  char   line[WEIGHT_LINE];
+  double w;
+  llong  e;
+  int    j = 0, n, at, errors = 0;
+
+  f = fopen(name, "r");
+  if (!f)  WeightError("Cannot open", name);
+
+  while (fgets(line, WEIGHT_LINE, f) != NULL)
+    {
+    at = 0;
+    n  = sscanf(line, "%lf%n %lld%n", &w, &at, &e, &at);
+    if (n == EOF)  continue;
+    if (n < 1 || strspn(line + at, " \t\r\n") != strlen(line + at))
+      {
+      WeightError("Malformed line in the", name);
+      }
+    if (j == size)
+      {
+      WeightError("Too many weights for the codebook in", name);
+      }
+    weight[j] = w;
+    if (n == 2)
+      {
+      if (sse != NULL)  sse[j] = e;
+      errors++;
+      }
+    j++;
+    }
+  fclose(f);
+  if (j < size)  WeightError("Too few weights for the codebook in", name);
+  if (errors > 0 && errors < size)
+    {
+    WeightError("Cluster errors missing from lines of the", name);
+    }
+  return (errors == size) ? YES : NO;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void PartitionErrors(TRAININGSET *TS, CODEBOOK *CB, PARTITIONING *P,
+llong *sse)
+{
+  int i, j;
+
+  for (j = 0; j < BookSize(CB); j++)
+    {
+    sse[j] = 0;
+    for (i = FirstVector(P, j); !EndOfPartition(i); i = NextVector(P, i))
+      {
+      sse[j] += VectorDistance(Vector(TS, i), Vector(CB, j), VectorSize(CB),
+                               MAXLLONG, EUCLIDEANSQ);
+      }
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Tiles are split statically, so a batch needs no synchronization   */
+/* but the end of the loop. Small batches use fewer threads.         */
+/*-------------------------------------------------------------------*/
+
+
+void AssignVectors(TRAININGSET *TS, int first, int count, PACKEDBOOK *PB,
+int *label, int threads)
+{
+  int tiles = (count + KERNEL_TILE - 1) / KERNEL_TILE, t;
+
+  threads = max(1, min(threads, count / ASSIGN_MIN_SHARE));
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(threads) if (threads > 1)
+#endif
+  for (t = 0; t < tiles; t++)
+    {
+    llong error[KERNEL_TILE];
+    int   vec[KERNEL_TILE], guess[KERNEL_TILE];
+    int   n, lo = t * KERNEL_TILE, size = min(KERNEL_TILE, count - lo);
+
+    for (n = 0; n < size; n++)
+      {
+      vec[n]   = first + lo + n;
+      guess[n] = 0;
+      }
+    FindNearestVectorsPacked(TS, PB, vec, guess, size, label + lo, error,
+                             NULL, NULL);
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+static void WeightError(char *message, char *name)
+{
+  ErrorMessage("ERROR: %s weight file %s!\n", message, name);
+  ExitProcessing(FATAL_ERROR);
+}
+
+
+/*-------------------------------------------------------------------*/
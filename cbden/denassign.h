@@ -0,0 +1,31 @@
+#if ! defined(__DENASSIGN_H)
+#define __DENASSIGN_H
+
+/* Vectors per thread below which a batch is labelled on one thread. */
+#define ASSIGN_MIN_SHARE  1024
+
+/* Centroid weights of a codebook as text, one per line. They are
+   written with 17 significant digits, so reading gives back the same
+   doubles. With sse (may be NULL), each line also holds the squared
+   error of the cluster (see PartitionErrors), which DENUPDATE.C keeps
+   up to date. Like the toolkit's writers, WriteWeights stops if the
+   file exists and overWrite is NO. ReadWeights requires exactly size
+   lines, all with or all without the errors; it returns YES if they
+   have them (given to sse if not NULL). */
+void WriteWeights(char *name, double *weight, llong *sse, int size,
+    int overWrite);
+int  ReadWeights(char *name, double *weight, llong *sse, int size);
+
+/* Squared error of each cluster of P: the sum of the squared
+   distances of its vectors to its centroid. */
+void PartitionErrors(TRAININGSET *TS, CODEBOOK *CB, PARTITIONING *P,
+    llong *sse);
+
+/* Labels vectors first..first+count-1 of TS with the nearest centroid
+   of PB by the weighted rule of the search (w*sqrt(d), ties to the
+   lowest index): label[n] for vector first+n. PB is shared by the
+   threads and not changed. */
+void AssignVectors(TRAININGSET *TS, int first, int count, PACKEDBOOK *PB,
+    int *label, int threads);
+
+#endif /* __DENASSIGN_H */
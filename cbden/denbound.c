@@ -0,0 +1,350 @@
+/*--------------------------------------------------------------------*/
+/* DENBOUND.C      agent                                              */
+/*                                                                    */
+/* Distance bounds for the K-means of the density-based random swap.  */
+/* A vector keeps an upper bound for the distance to its own centroid */
+/* and, for each group of centroids, a lower bound for the distance   */
+/* to the other centroids of the group. A group can be skipped when   */
+/* its smallest weight times the lower bound exceeds the weighted     */
+/* distance to the own centroid. When a centroid moves by delta, the  */
+/* bounds change by at most delta (triangle inequality).              */
+/*                                                                    */
+/* The result is the same as FindNearestVectorWithWeight() in DENRS.C */
+/* with the current centroid as guess, including the ties of the      */
+/* truncated (llong) errors.                                          */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.03: 17.10.26 AG: Search buffers from the caller.                 */
+/* 0.02: 17.10.26 AG: Count the distance evaluations.                 */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+/* Relative slack for the rounding errors of the bounds. */
+#define BOUND_SLACK     1e-9
+/* Lower bounds are rounded down by this before storing as floats. */
+#define BOUND_FLOAT     (1.0 - 1e-6)
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+
+#include "cb.h"
+#include "interfc.h"
+#include "denutil.h"
+#include "denbound.h"
+
+
+/* ========================== PROTOTYPES ============================= */
+
+static double Distance(BOUNDS *B, TRAININGSET *TS, int i, int j,
+    llong *evals);
+static int    GroupEnd(BOUNDS *B, int g);
+static void   StoreLower(BOUNDS *B, float *stored, double *lower);
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+void CreateBounds(BOUNDS *B, TRAININGSET *TS, CODEBOOK *CB)
+{
+  int i;
+
+  memset(B, 0, sizeof(BOUNDS));
+  B->N         = BookSize(TS);
+  B->Size      = BookSize(CB);
+  B->Dim       = VectorSize(CB);
+  B->GroupSize = (B->Size + BOUND_MAXGROUPS - 1) / BOUND_MAXGROUPS;
+  if (B->GroupSize < BOUND_GROUPSIZE)  B->GroupSize = BOUND_GROUPSIZE;
+  B->Groups    = (B->Size + B->GroupSize - 1) / B->GroupSize;
+
+  B->upper       = (double*) DenZeroAlloc(B->N * sizeof(double));
+  B->lower       = (float*) DenZeroAlloc((size_t) B->N * B->Groups *
+                   sizeof(float));
+  B->cluster     = (int*) DenZeroAlloc(B->N * sizeof(int));
+  B->cent        = (VECTORELEMENT*) DenZeroAlloc((size_t) B->Size *
+                   B->Dim * sizeof(VECTORELEMENT));
+  B->drift       = (double*) DenZeroAlloc(B->Size * sizeof(double));
+  B->groupDrift  = (double*) DenZeroAlloc(B->Groups * sizeof(double));
+  B->groupWeight = (double*) DenZeroAlloc(B->Groups * sizeof(double));
+
+  for (i = 0; i < B->N; i++)
+    {
+    B->cluster[i] = -1;
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void FreeBounds(BOUNDS *B)
+{
+  free(B->upper);
+  free(B->lower);
+  free(B->cluster);
+  free(B->cent);
+  free(B->drift);
+  free(B->groupDrift);
+  free(B->groupWeight);
+  memset(B, 0, sizeof(BOUNDS));
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Must be called before a pass of NearestWithBounds(): calculates   */
+/* how far the centroids have moved since CommitBounds() and the     */
+/* smallest current weight of each group.                            */
+/*-------------------------------------------------------------------*/
+
+
+void PrepareBounds(BOUNDS *B, CODEBOOK *CB, double *weight)
+{
+  int j, g;
+
+  B->CB     = CB;
+  B->weight = weight;
+  B->Usable = 1;
+
+  for (g = 0; g < B->Groups; g++)
+    {
+    B->groupDrift[g]  = 0.0;
+    B->groupWeight[g] = DBL_MAX;
+    }
+
+  for (j = 0; j < B->Size; j++)
+    {
+    g = j / B->GroupSize;
+    if (!isfinite(weight[j]) || weight[j] < 0.0)  B->Usable = 0;
+    if (weight[j] < B->groupWeight[g])  B->groupWeight[g] = weight[j];
+
+    B->drift[j] = 0.0;
+    if (B->Valid)
+      {
+      B->drift[j] = sqrt(VectorDistance(B->cent + (size_t) j * B->Dim,
+                         Vector(CB, j), B->Dim, MAXLLONG, EUCLIDEANSQ));
+      }
+    if (B->drift[j] > B->groupDrift[g])  B->groupDrift[g] = B->drift[j];
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Returns the nearest centroid (weighted) of vector i, which is now */
+/* in cluster guess, and updates the bounds of i. Distances are only */
+/* calculated for the groups that the bounds cannot rule out; their  */
+/* number is added to evals. scratch holds Size + Groups doubles.    */
+/*-------------------------------------------------------------------*/
+
+
+int NearestWithBounds(BOUNDS *B, TRAININGSET *TS, int i, int guess,
+double *scratch, llong *evals)
+{
+  float  *stored = B->lower + (size_t) i * B->Groups;
+  double *dist   = scratch;
+  double *lower  = scratch + B->Size;
+  char    search[BOUND_MAXGROUPS];
+  double  upper, bound, d;
+  llong   error, e;
+  int     g, j, jend, old, nearest, exact, more;
+
+  /* correct the bounds by the movement of the centroids */
+  old = B->cluster[i];
+  if (!B->Usable || old < 0)
+    {
+    for (g = 0; g < B->Groups; g++)  lower[g] = 0.0;
+    upper = Distance(B, TS, i, guess, evals);
+    exact = 1;
+    }
+  else
+    {
+    for (g = 0; g < B->Groups; g++)
+      {
+      lower[g] = stored[g] - B->groupDrift[g];
+      if (lower[g] < 0.0)  lower[g] = 0.0;
+      }
+    if (old != guess)
+      {
+      /* vector was moved after the bounds were set: the old centroid
+         is now one of the others */
+      d = Distance(B, TS, i, old, evals);
+      g = old / B->GroupSize;
+      if (d < lower[g])  lower[g] = d;
+      upper = Distance(B, TS, i, guess, evals);
+      exact = 1;
+      }
+    else
+      {
+      upper = B->upper[i] + B->drift[guess];
+      exact = 0;
+      }
+    }
+
+  /* groups that could contain a nearer centroid */
+  for (;;)
+    {
+    bound = B->weight[guess] * upper * (1.0 + BOUND_SLACK);
+    more  = 0;
+    for (g = 0; g < B->Groups; g++)
+      {
+      search[g] = !B->Usable || !(B->groupWeight[g] * lower[g] > bound);
+      more |= search[g];
+      }
+    if (!more || exact)  break;
+    upper = Distance(B, TS, i, guess, evals);
+    exact = 1;
+    }
+
+  if (!more)
+    {
+    B->upper[i]   = upper;
+    B->cluster[i] = guess;
+    StoreLower(B, stored, lower);
+    return guess;
+    }
+
+  /* search the groups in index order with the rule of the original
+     search; the groups left out must be clearly worse than the winner
+     so that they cannot tie with it after truncation */
+  dist[guess] = upper;
+  do
+    {
+    for (g = 0; g < B->Groups; g++)
+      {
+      if (search[g] != 1)  continue;
+      jend = GroupEnd(B, g);
+      for (j = g * B->GroupSize; j < jend; j++)
+        {
+        if (j != guess)  dist[j] = Distance(B, TS, i, j, evals);
+        }
+      search[g] = 2;
+      }
+
+    nearest = guess;
+    error   = B->weight[guess] * dist[guess];
+    for (g = 0; g < B->Groups; g++)
+      {
+      if (search[g] != 2)  continue;
+      jend = GroupEnd(B, g);
+      for (j = g * B->GroupSize; j < jend; j++)
+        {
+        if (j == guess)  continue;
+        e = B->weight[j] * dist[j];
+        if (e < error)
+          {
+          error   = e;
+          nearest = j;
+          }
+        }
+      }
+
+    more = 0;
+    for (g = 0; g < B->Groups; g++)
+      {
+      bound = B->groupWeight[g] * lower[g] * (1.0 - BOUND_SLACK);
+      if (search[g] == 0 && !(bound >= error + 1))
+        {
+        search[g] = 1;
+        more      = 1;
+        }
+      }
+    }
+  while (more);
+
+  /* new bounds */
+  for (g = 0; g < B->Groups; g++)
+    {
+    if (search[g] != 2)  continue;
+    lower[g] = DBL_MAX;
+    jend = GroupEnd(B, g);
+    for (j = g * B->GroupSize; j < jend; j++)
+      {
+      if (j != nearest && dist[j] < lower[g])  lower[g] = dist[j];
+      }
+    }
+  g = guess / B->GroupSize;
+  if (nearest != guess && dist[guess] < lower[g])
+    {
+    lower[g] = dist[guess];
+    }
+
+  B->upper[i]   = dist[nearest];
+  B->cluster[i] = B->Usable ? nearest : -1;
+  StoreLower(B, stored, lower);
+  return nearest;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Saves the current centroids: all bounds now refer to them. Must   */
+/* follow a pass of NearestWithBounds() over every vector.           */
+/*-------------------------------------------------------------------*/
+
+
+void CommitBounds(BOUNDS *B)
+{
+  int j;
+
+  for (j = 0; j < B->Size; j++)
+    {
+    CopyVector(Vector(B->CB, j), B->cent + (size_t) j * B->Dim, B->Dim);
+    }
+  B->Valid = 1;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* |x_i - c_j| with the current centroids, as in the original search. */
+/*-------------------------------------------------------------------*/
+
+
+static double Distance(BOUNDS *B, TRAININGSET *TS, int i, int j,
+llong *evals)
+{
+  (*evals)++;
+  return sqrt(VectorDistance(Vector(TS, i), Vector(B->CB, j), B->Dim,
+                             MAXLLONG, EUCLIDEANSQ));
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+/*-------------------------------------------------------------------*/
+/* Group g consists of centroids g*GroupSize .. GroupEnd()-1.        */
+/*-------------------------------------------------------------------*/
+
+
+static int GroupEnd(BOUNDS *B, int g)
+{
+  int end = (g + 1) * B->GroupSize;
+
+  return (end < B->Size) ? end : B->Size;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+/*-------------------------------------------------------------------*/
+/* Stores the lower bounds as floats, rounded down.                  */
+/*-------------------------------------------------------------------*/
+
+
+static void StoreLower(BOUNDS *B, float *stored, double *lower)
+{
+  int g;
+
+  for (g = 0; g < B->Groups; g++)
+    {
+    stored[g] = (lower[g] < FLT_MAX) ? (float) (lower[g] * BOUND_FLOAT)
+                                     : FLT_MAX;
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
@@ -0,0 +1,46 @@
+#if ! defined(__DENBOUND_H)
+#define __DENBOUND_H
+
+/* Centroids per group and maximum number of groups; each vector keeps
+   one lower bound per group. */
+#define BOUND_GROUPSIZE   4
+#define BOUND_MAXGROUPS   32
+
+/* Yinyang-style bounds for the weighted nearest centroid search. The
+   centroids are divided into groups of consecutive indices. For each
+   vector i, upper[i] bounds |x - c| of its own centroid cluster[i] from
+   above and lower[i*Groups + g] bounds |x - c| of the other centroids
+   of group g from below. The bounds are unweighted, so changing the
+   weights does not loosen them; they are multiplied by the current
+   weights when they are tested. The lower bounds are stored as floats
+   (rounded down) to halve their memory. The bounds refer to the
+   centroids saved in cent and are corrected by how much each centroid
+   has moved since then. */
+typedef struct
+  {
+  int            N;           /* number of vectors                    */
+  int            Size;        /* codebook size                        */
+  int            Dim;         /* vector dimension                     */
+  int            Groups;      /* number of centroid groups            */
+  int            GroupSize;   /* centroids per group                  */
+  int            Valid;       /* cent has been saved                  */
+  int            Usable;      /* weights allow the bounds to be used  */
+  double        *upper;       /* N                                    */
+  float         *lower;       /* N x Groups                           */
+  int           *cluster;     /* centroid of upper[i], -1 = unknown   */
+  VECTORELEMENT *cent;        /* centroids of the bounds, Size x Dim  */
+  CODEBOOK      *CB;          /* current centroids (PrepareBounds)    */
+  double        *weight;      /* current weights (PrepareBounds)      */
+  double        *drift;       /* |c - saved c| for each centroid      */
+  double        *groupDrift;  /* largest drift in each group          */
+  double        *groupWeight; /* smallest weight in each group        */
+  } BOUNDS;
+
+void CreateBounds(BOUNDS *B, TRAININGSET *TS, CODEBOOK *CB);
+void FreeBounds(BOUNDS *B);
+void PrepareBounds(BOUNDS *B, CODEBOOK *CB, double *weight);
+int  NearestWithBounds(BOUNDS *B, TRAININGSET *TS, int i, int guess,
+    double *scratch, llong *evals);
+void CommitBounds(BOUNDS *B);
+
+#endif /* __DENBOUND_H */
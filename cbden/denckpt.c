@@ -0,0 +1,180 @@
+/*--------------------------------------------------------------------*/
+/* DENCKPT.C       agent                                              */
+/*                                                                    */
+/* Checkpoints of the density-based random swap. Between two rounds   */
+/* of swaps, the whole state a run needs to continue is written to a  */
+/* binary file: the solution, the weights, the error, the iteration,  */
+/* the state of the automatic stop, of the progress monitor and of    */
+/* the random streams. A run resumed from the file continues exactly  */
+/* as the interrupted one would have. The file is replaced by         */
+/* renaming a temporary copy, so an interrupted write keeps the       */
+/* previous checkpoint.                                               */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.02: 17.10.26 AG: State of the progress monitor.                  */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cb.h"
+#include "interfc.h"
+#include "denutil.h"
+#include "denckpt.h"
+
+
+/* ========================== PROTOTYPES ============================= */
+
+static void  CkptError(char *message, char *name);
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+void WriteCheckpoint(char *name, CHECKPOINT *C, CODEBOOK *CB,
+PARTITIONING *P, double *weight, int **second, llong **secondDist)
+{
+  char *temp;
+  FILE *f;
+  int   i, t, ok;
+
+  memcpy(C->Magic, CKPT_MAGIC, 4);
+  C->Version  = CKPT_VERSION;
+  C->Endian   = CKPT_ENDIAN;
+  C->Reserved = 0;
+
+  temp = (char*) DenAlloc(strlen(name) + 5);
+  strcpy(temp, name);
+  strcat(temp, ".tmp");
+
+  f  = fopen(temp, "wb");
+  ok = (f != NULL);
+  if (ok)
+    {
+    fwrite(C, sizeof(CHECKPOINT), 1, f);
+    for (i = 0; i < C->Size; i++)
+      {
+      fwrite(Vector(CB, i), sizeof(VECTORELEMENT), C->Dim, f);
+      }
+    for (i = 0; i < C->Size; i++)
+      {
+      fwrite(&VectorFreq(CB, i), sizeof(int), 1, f);
+      }
+    for (i = 0; i < C->N; i++)
+      {
+      fwrite(&Map(P, i), sizeof(int), 1, f);
+      }
+    fwrite(weight, sizeof(double), C->Size, f);
+    for (t = 0; C->Deterministic && t < C->Trials; t++)
+      {
+      fwrite(second[t], sizeof(int), C->N, f);
+      fwrite(secondDist[t], sizeof(llong), C->N, f);
+      }
+    ok = !(ferror(f) | fclose(f));
+    }
+
+  if (!ok || rename(temp, name) != 0)
+    {
+    ErrorMessage("WARNING: Writing the checkpoint file %s failed!\n", name);
+    remove(temp);
+    }
+  free(temp);
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+FILE* OpenCheckpoint(char *name, CHECKPOINT *C, TRAININGSET *TS,
+CODEBOOK *CB, PARTITIONING *P, double *weight)
+{
+  CHECKPOINT H;
+  FILE      *f;
+  int       *map;
+  int        i, ok;
+
+  f = fopen(name, "rb");
+  if (!f)  return NULL;
+
+  if (fread(&H, sizeof(CHECKPOINT), 1, f) != 1 ||
+      memcmp(H.Magic, CKPT_MAGIC, 4) != 0 || H.Version != CKPT_VERSION)
+    {
+    CkptError("Unknown format version in", name);
+    }
+  if (H.Endian != CKPT_ENDIAN)  CkptError("Wrong byte order in", name);
+  if (H.N != C->N || H.Size != C->Size || H.Dim != C->Dim ||
+      H.Trials != C->Trials || H.Deterministic != C->Deterministic ||
+      H.Monitoring != C->Monitoring ||
+      H.Iteration < 1 || H.Target < 0 || H.Target >= H.Size)
+    {
+    CkptError("Different data or options in", name);
+    }
+
+  ok = 1;
+  for (i = 0; ok && i < H.Size; i++)
+    {
+    ok = (fread(Vector(CB, i), sizeof(VECTORELEMENT), H.Dim, f) ==
+          (size_t) H.Dim);
+    }
+  for (i = 0; ok && i < H.Size; i++)
+    {
+    ok = (fread(&VectorFreq(CB, i), sizeof(int), 1, f) == 1);
+    }
+
+  map = (int*) DenAlloc(H.N * sizeof(int));
+  ok  = ok && fread(map, sizeof(int), H.N, f) == (size_t) H.N;
+  ok  = ok && fread(weight, sizeof(double), H.Size, f) == (size_t) H.Size;
+  for (i = 0; ok && i < H.N; i++)
+    {
+    ok = (map[i] >= 0 && map[i] < H.Size);
+    }
+  if (!ok)  CkptError("Corrupted", name);
+
+  for (i = 0; i < H.N; i++)
+    {
+    if (Map(P, i) != map[i])  ChangePartition(TS, P, map[i], i);
+    }
+  free(map);
+
+  *C = H;
+  return f;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void CloseCheckpoint(FILE *f, char *name, CHECKPOINT *C, int **second,
+llong **secondDist)
+{
+  int t, i, ok = 1;
+
+  for (t = 0; C->Deterministic && ok && t < C->Trials; t++)
+    {
+    ok = (fread(second[t], sizeof(int), C->N, f) == (size_t) C->N &&
+          fread(secondDist[t], sizeof(llong), C->N, f) == (size_t) C->N);
+    for (i = 0; ok && i < C->N; i++)
+      {
+      ok = (second[t][i] >= -1 && second[t][i] < C->Size);
+      }
+    }
+  fclose(f);
+  if (!ok)  CkptError("Corrupted", name);
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+static void CkptError(char *message, char *name)
+{
+  ErrorMessage("ERROR: %s checkpoint file %s!\n", message, name);
+  ExitProcessing(FATAL_ERROR);
+}
+
+
+/*-------------------------------------------------------------------*/
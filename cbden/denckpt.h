@@ -0,0 +1,64 @@
+#if ! defined(__DENCKPT_H)
+#define __DENCKPT_H
+
+#define CKPT_MAGIC        "CBDC"
+#define CKPT_VERSION      2
+#define CKPT_ENDIAN       0x01020304
+/* Bins of the progress monitor's CI histogram. */
+#define CKPT_CIBINS       111
+
+/* Header of a checkpoint: the state of a run between two rounds of
+   swaps. Numbers are in the byte order of the machine that wrote the
+   file. The header is followed by Size x Dim centroid elements, Size
+   int centroid frequencies, N int partitions, Size double weights and,
+   with Deterministic, for each of the Trials slots N int second
+   nearest centroids and N llong squared distances to them. The CI
+   fields are the state of the progress monitor (used with
+   Monitoring). */
+typedef struct
+  {
+  char       Magic[4];
+  int        Version;
+  int        Endian;
+  int        N;                 /* training set size                  */
+  int        Size;              /* codebook size                      */
+  int        Dim;               /* vector dimension                   */
+  int        Trials;            /* candidate swaps per round          */
+  int        Deterministic;
+  int        Iteration;         /* next swap iteration                */
+  int        Target;            /* centroid of the next determ. swap  */
+  int        PrevIter;          /* state of the automatic stop        */
+  int        Reserved;
+  int        Monitoring;
+  int        CIPrev;            /* CI of the current solution         */
+  int        CIZero;            /* iteration that reached CI = 0      */
+  int        CIMax;             /* largest CI in the histogram        */
+  int        PrevSuccess;       /* iteration of the last CI decrease  */
+  int        CIHistogram[CKPT_CIBINS];
+  llong      Error;             /* objective function value           */
+  double     PrevImpr;
+  unsigned long long Random;    /* state of the run's random stream   */
+  unsigned long long Seed;      /* seed of the parallel trials        */
+  } CHECKPOINT;
+
+/* Writes C (header fields other than Magic, Version and Endian set by
+   the caller) and the solution to a temporary file and then renames
+   it to name, so an interrupted write leaves the previous checkpoint.
+   second and secondDist have Trials entries (used with
+   Deterministic). A failed write is reported but not fatal. */
+void  WriteCheckpoint(char *name, CHECKPOINT *C, CODEBOOK *CB,
+    PARTITIONING *P, double *weight, int **second, llong **secondDist);
+
+/* Reads the checkpoint into CB, P (valid partitionings of TS, of the
+   size in the file) and weight. C holds the expected N, Size, Dim,
+   Trials, Deterministic and Monitoring; a different file is a fatal
+   error.
+   Returns NULL if the file does not exist, otherwise the file for
+   CloseCheckpoint, which reads the rest into second and secondDist
+   (Trials entries, used with Deterministic). */
+FILE* OpenCheckpoint(char *name, CHECKPOINT *C, TRAININGSET *TS,
+    CODEBOOK *CB, PARTITIONING *P, double *weight);
+void  CloseCheckpoint(FILE *f, char *name, CHECKPOINT *C, int **second,
+    llong **secondDist);
+
+#endif /* __DENCKPT_H */
@@ -0,0 +1,262 @@
+/*--------------------------------------------------------------------*/
+/* DENINDEX.C      agent                                              */
+/*                                                                    */
+/* Uniform grid over the training set for the density-based random    */
+/* swap. The object attraction of a swap can only take vectors that   */
+/* lie near the new centroid, so it visits the cells around it        */
+/* instead of the whole training set.                                 */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.02: 17.10.26 AG: Local densities from the cell counts.           */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cb.h"
+#include "interfc.h"
+#include "denutil.h"
+#include "denindex.h"
+
+
+/* ========================== PROTOTYPES ============================= */
+
+static int CellOf(GRIDINDEX *G, int n, double x);
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+void CreateGridIndex(GRIDINDEX *G, TRAININGSET *TS)
+{
+  int    i, d, n, c, used, total, *cell;
+  double low[VectorSize(TS)], range[VectorSize(TS)], x, w, area;
+
+  memset(G, 0, sizeof(GRIDINDEX));
+  G->N = BookSize(TS);
+
+  for (d = 0; d < VectorSize(TS); d++)
+    {
+    low[d]   = VectorScalar(TS, 0, d);
+    range[d] = low[d];
+    for (i = 1; i < BookSize(TS); i++)
+      {
+      x = VectorScalar(TS, i, d);
+      if (x < low[d])    low[d]   = x;
+      if (x > range[d])  range[d] = x;
+      }
+    range[d] -= low[d];
+    }
+
+  /* dimensions with the largest ranges */
+  G->Dims = VectorSize(TS);
+  if (G->Dims > GRID_MAXDIMS)  G->Dims = GRID_MAXDIMS;
+  for (n = 0; n < G->Dims; n++)
+    {
+    G->dim[n] = -1;
+    for (d = 0; d < VectorSize(TS); d++)
+      {
+      if ((n == 0 || d != G->dim[0]) &&
+          (G->dim[n] < 0 || range[d] > range[G->dim[n]]))
+        {
+        G->dim[n] = d;
+        }
+      }
+    }
+
+  /* square cells, about GRID_CELLVECTORS vectors per cell */
+  area = 1.0;
+  used = 0;
+  for (n = 0; n < G->Dims; n++)
+    {
+    if (range[G->dim[n]] > 0)
+      {
+      area *= range[G->dim[n]];
+      used++;
+      }
+    }
+  w = 1.0;
+  if (used > 0)  w = pow(area * GRID_CELLVECTORS / G->N, 1.0 / used);
+
+  total = 1;
+  for (n = 0; n < G->Dims; n++)
+    {
+    d            = G->dim[n];
+    G->low[n]    = low[d];
+    G->cells[n]  = (range[d] > 0) ? (int) (range[d] / w) + 1 : 1;
+    if (G->cells[n] > G->N)  G->cells[n] = G->N;
+    G->width[n]  = (range[d] + 1.0) / G->cells[n];
+    total       *= G->cells[n];
+    }
+
+  /* counting sort by cell keeps each cell in index order */
+  G->start = (int*) DenZeroAlloc((total + 1) * sizeof(int));
+  G->vec   = (int*) DenZeroAlloc(G->N * sizeof(int));
+  cell     = (int*) DenZeroAlloc(G->N * sizeof(int));
+
+  for (i = 0; i < G->N; i++)
+    {
+    cell[i] = 0;
+    for (n = G->Dims - 1; n >= 0; n--)
+      {
+      c       = CellOf(G, n, VectorScalar(TS, i, G->dim[n]));
+      cell[i] = cell[i] * G->cells[n] + c;
+      }
+    G->start[cell[i] + 1]++;
+    }
+  for (c = 0; c < total; c++)
+    {
+    G->start[c + 1] += G->start[c];
+    }
+  for (i = 0; i < G->N; i++)
+    {
+    G->vec[G->start[cell[i]]++] = i;
+    }
+  for (c = total; c > 0; c--)
+    {
+    G->start[c] = G->start[c - 1];
+    }
+  G->start[0] = 0;
+
+  free(cell);
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void FreeGridIndex(GRIDINDEX *G)
+{
+  free(G->start);
+  free(G->vec);
+  memset(G, 0, sizeof(GRIDINDEX));
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Number of vectors in the cell of each vector and its neighbours   */
+/* (3 cells wide in each dimension), relative to the average over    */
+/* all vectors.                                                      */
+/*-------------------------------------------------------------------*/
+
+
+void GridDensity(GRIDINDEX *G, double *density)
+{
+  int    lo[GRID_MAXDIMS], hi[GRID_MAXDIMS], at[GRID_MAXDIMS];
+  int    n, c, b, i, count, total = 1;
+  double sum = 0.0;
+
+  for (n = 0; n < G->Dims; n++)  total *= G->cells[n];
+
+  for (c = 0; c < total; c++)
+    {
+    if (G->start[c] == G->start[c + 1])  continue;
+
+    for (b = c, n = 0; n < G->Dims; n++)
+      {
+      at[n] = b % G->cells[n];
+      b    /= G->cells[n];
+      lo[n] = (at[n] > 0) ? at[n] - 1 : 0;
+      hi[n] = (at[n] < G->cells[n] - 1) ? at[n] + 1 : at[n];
+      at[n] = lo[n];
+      }
+
+    count = 0;
+    for (;;)
+      {
+      b = 0;
+      for (n = G->Dims - 1; n >= 0; n--)
+        {
+        b = b * G->cells[n] + at[n];
+        }
+      count += G->start[b + 1] - G->start[b];
+
+      for (n = 0; n < G->Dims && at[n] == hi[n]; n++)
+        {
+        at[n] = lo[n];
+        }
+      if (n == G->Dims)  break;
+      at[n]++;
+      }
+
+    for (i = G->start[c]; i < G->start[c + 1]; i++)
+      {
+      density[G->vec[i]] = count;
+      }
+    sum += (double) count * (G->start[c + 1] - G->start[c]);
+    }
+
+  for (i = 0; i < G->N; i++)  density[i] *= G->N / sum;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Collects into candidate every vector whose distance to centroid j */
+/* can be at most radius, and some others. Returns their number.     */
+/*-------------------------------------------------------------------*/
+
+
+int GridCandidates(GRIDINDEX *G, CODEBOOK *CB, int j, double radius,
+int *candidate)
+{
+  int    lo[GRID_MAXDIMS], hi[GRID_MAXDIMS], at[GRID_MAXDIMS];
+  int    n, c, i, count = 0;
+  double x;
+
+  for (n = 0; n < G->Dims; n++)
+    {
+    x     = VectorScalar(CB, j, G->dim[n]);
+    lo[n] = CellOf(G, n, x - radius);
+    hi[n] = CellOf(G, n, x + radius);
+    at[n] = lo[n];
+    }
+
+  for (;;)
+    {
+    c = 0;
+    for (n = G->Dims - 1; n >= 0; n--)
+      {
+      c = c * G->cells[n] + at[n];
+      }
+    for (i = G->start[c]; i < G->start[c + 1]; i++)
+      {
+      candidate[count++] = G->vec[i];
+      }
+
+    /* next cell of the box */
+    for (n = 0; n < G->Dims && at[n] == hi[n]; n++)
+      {
+      at[n] = lo[n];
+      }
+    if (n == G->Dims)  break;
+    at[n]++;
+    }
+
+  return count;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+/*-------------------------------------------------------------------*/
+/* Cell of coordinate x in grid dimension n, clamped to the grid.    */
+/*-------------------------------------------------------------------*/
+
+
+static int CellOf(GRIDINDEX *G, int n, double x)
+{
+  double c = floor((x - G->low[n]) / G->width[n]);
+
+  if (c < 0)                return 0;
+  if (c >= G->cells[n])     return G->cells[n] - 1;
+  return (int) c;
+}
+
+
+/*-------------------------------------------------------------------*/
@@ -0,0 +1,32 @@
+#if ! defined(__DENINDEX_H)
+#define __DENINDEX_H
+
+/* Average number of vectors per grid cell. */
+#define GRID_CELLVECTORS  4
+/* Number of dimensions the grid is built on. */
+#define GRID_MAXDIMS      2
+
+/* Uniform grid over the training set, built once per run. The grid
+   uses the GRID_MAXDIMS dimensions with the largest range; a box in
+   them contains every vector within the same distance of its center
+   (in all dimensions). The vectors of each cell are stored in index
+   order in vec[start[c] .. start[c+1]-1]. */
+typedef struct
+  {
+  int     N;                    /* number of vectors                  */
+  int     Dims;                 /* dimensions used                    */
+  int     dim[GRID_MAXDIMS];    /* which dimensions                   */
+  int     cells[GRID_MAXDIMS];  /* cells in each dimension            */
+  double  low[GRID_MAXDIMS];    /* smallest coordinate                */
+  double  width[GRID_MAXDIMS];  /* cell width                         */
+  int    *start;                /* first vector of each cell          */
+  int    *vec;                  /* vectors ordered by cell            */
+  } GRIDINDEX;
+
+void CreateGridIndex(GRIDINDEX *G, TRAININGSET *TS);
+void FreeGridIndex(GRIDINDEX *G);
+int  GridCandidates(GRIDINDEX *G, CODEBOOK *CB, int j, double radius,
+    int *candidate);
+void GridDensity(GRIDINDEX *G, double *density);
+
+#endif /* __DENINDEX_H */
@@ -0,0 +1,631 @@
+/*--------------------------------------------------------------------*/
+/* DENKERN.C       agent                                              */
+/*                                                                    */
+/* Weighted nearest centroid search for the density-based random      */
+/* swap. A tile of data vectors is compared against the whole         */
+/* codebook with squared weighted distances w^2*d(x,c), using AVX2 or */
+/* AVX-512 when the processor supports them and a scalar loop         */
+/* otherwise. The winner is then verified with the original           */
+/* (llong) w*sqrt(d) rule, so the results are identical to            */
+/* FindNearestVectorWithWeight() in DENRS.C. For high dimensions with */
+/* a dimension order, the centroids are instead compared with partial */
+/* distances that stop once a centroid cannot be among the two        */
+/* nearest.                                                           */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.06: 17.10.26 AG: The nearest centroid is never left unset.       */
+/* 0.05: 17.10.26 AG: Kernel can be chosen by name (UseKernel).       */
+/* 0.04: 17.10.26 AG: Partial distance search for high dimensions.    */
+/* 0.03: 17.10.26 AG: Runner-up centroid as an optional output.       */
+/* 0.02: 17.10.26 AG: Kernel is selected once, also under threads.    */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+/* Centroids processed per kernel call; bounds the stack buffers. */
+#define KERNEL_CHUNK    256
+/* Codebook rows are padded to a multiple of this (AVX-512 width). */
+#define KERNEL_WIDTH    8
+/* Relative slack when deciding that the runner-up cannot tie. */
+#define KERNEL_SLACK    1e-9
+/* Dimensions from which partial distances replace the SIMD tiles. */
+#define KERNEL_PARTIAL  64
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNEL_X86      1
+#else
+#define KERNEL_X86      0
+#endif
+
+/*-------------------------------------------------------------------*/
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <pthread.h>
+
+#if KERNEL_X86
+#include <immintrin.h>
+#endif
+
+#include "cb.h"
+#include "interfc.h"
+#include "denstore.h"
+#include "denkern.h"
+
+/* ========================== PROTOTYPES ============================= */
+
+typedef void (*TILEKERNEL)(PACKEDBOOK *PB, double *x, int tp, int j0,
+    int j1, double *q);
+
+static void TileScalar(PACKEDBOOK *PB, double *x, int tp, int j0, int j1,
+    double *q);
+static TILEKERNEL SelectKernel(char *name);
+static void InitKernel(void);
+static llong LegacyDistance(PACKEDBOOK *PB, VECTORTYPE v, int j,
+    llong best);
+static int NearestScalar(PACKEDBOOK *PB, VECTORTYPE v, int guess,
+    llong *error);
+static void NearestPartial(PACKEDBOOK *PB, double *x, int guess,
+    double *qmin, double *q2, int *jmin, int *j2);
+
+static TILEKERNEL  Kernel     = NULL;
+static char       *KernelStr  = "scalar";
+static pthread_once_t KernelOnce = PTHREAD_ONCE_INIT;
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+void InitPackedCodebook(PACKEDBOOK *PB)
+{
+  memset(PB, 0, sizeof(PACKEDBOOK));
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+static double* AlignedAlloc(size_t count)
+{
+  void *p = NULL;
+
+  if (posix_memalign(&p, 64, count * sizeof(double)) != 0)
+    {
+    ErrorMessage("ERROR: Allocating memory failed!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
+  return (double*) p;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Copies codebook CB and its weights into the packed layout. Must be */
+/* called again whenever a centroid or a weight changes. With a       */
+/* dimension order and high dimensions, rows in that order are kept   */
+/* for the partial distance search.                                   */
+/*-------------------------------------------------------------------*/
+
+
+void PackCodebook(CODEBOOK *CB, double *weight, PACKEDBOOK *PB)
+{
+  int i, d;
+  int stride = (BookSize(CB) + KERNEL_WIDTH - 1) / KERNEL_WIDTH * KERNEL_WIDTH;
+
+  pthread_once(&KernelOnce, InitKernel);
+
+  if (stride > PB->Allocated || VectorSize(CB) > PB->AllocDim)
+    {
+    free(PB->Coord);
+    free(PB->Weight2);
+    PB->Coord     = AlignedAlloc((size_t) stride * VectorSize(CB));
+    PB->Weight2   = AlignedAlloc(stride);
+    PB->Allocated = stride;
+    PB->AllocDim  = VectorSize(CB);
+    }
+
+  if (PB->Order != NULL && VectorSize(CB) >= KERNEL_PARTIAL)
+    {
+    if (BookSize(CB) * VectorSize(CB) > PB->AllocRow)
+      {
+      free(PB->Row);
+      PB->Row      = AlignedAlloc((size_t) BookSize(CB) * VectorSize(CB));
+      PB->AllocRow = BookSize(CB) * VectorSize(CB);
+      }
+    for (i = 0; i < BookSize(CB); i++)
+      for (d = 0; d < VectorSize(CB); d++)
+        PB->Row[(size_t) i * VectorSize(CB) + d] =
+          (double) VectorScalar(CB, i, PB->Order[d]);
+    }
+
+  PB->CB     = CB;
+  PB->weight = weight;
+  PB->Size   = BookSize(CB);
+  PB->Dim    = VectorSize(CB);
+  PB->Stride = stride;
+  PB->Finite = 1;
+
+  for (i = 0; i < stride; i++)
+    {
+    if (i < PB->Size)
+      {
+      PB->Weight2[i] = weight[i] * weight[i];
+      if (!isfinite(weight[i]))  PB->Finite = 0;
+      for (d = 0; d < PB->Dim; d++)
+        PB->Coord[d * stride + i] = (double) VectorScalar(CB, i, d);
+      }
+    else
+      {
+      PB->Weight2[i] = 0.0;
+      for (d = 0; d < PB->Dim; d++)
+        PB->Coord[d * stride + i] = 0.0;
+      }
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void FreePackedCodebook(PACKEDBOOK *PB)
+{
+  free(PB->Coord);
+  free(PB->Weight2);
+  free(PB->Row);
+  InitPackedCodebook(PB);
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+char* KernelName(void)
+{
+  pthread_once(&KernelOnce, InitKernel);
+  return KernelStr;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Replaces the kernel selected at start-up by the one named (as in   */
+/* KernelName()). Returns NO if the processor does not support it.    */
+/* Must not be called while a search is running.                      */
+/*-------------------------------------------------------------------*/
+
+
+int UseKernel(char *name)
+{
+  TILEKERNEL k;
+
+  pthread_once(&KernelOnce, InitKernel);
+  k = SelectKernel(name);
+  if (k == NULL)  return NO;
+  Kernel = k;
+  return YES;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Finds the nearest centroid (weighted) of the data vectors          */
+/* index[0..count-1]. Equivalent to calling                           */
+/* FindNearestVectorWithWeight(&Node(TS,index[n]), CB, &error[n],     */
+/* guess[n], EUCLIDEANSQ, weight) for each n. second (may be NULL)    */
+/* gets the runner-up centroid, -1 if not known, and secondError its  */
+/* distance from the kernel (may differ from the original rule by     */
+/* rounding).                                                         */
+/*-------------------------------------------------------------------*/
+
+
+void FindNearestVectorsPacked(TRAININGSET *TS, PACKEDBOOK *PB, int *index,
+int *guess, int count, int *nearest, llong *error, int *second,
+llong *secondError)
+{
+  double x[KERNEL_TILE * PB->Dim];
+  double q[KERNEL_TILE * KERNEL_CHUNK];
+  double qmin[KERNEL_TILE], q2[KERNEL_TILE], limit, v;
+  int    jmin[KERNEL_TILE], j2[KERNEL_TILE];
+  int    n, p, d, j, j0, j1, jend, tp;
+
+  for (n = 0; n < count; n += KERNEL_TILE)
+    {
+    tp = (count - n < KERNEL_TILE) ? count - n : KERNEL_TILE;
+
+    if (!PB->Finite)
+      {
+      for (p = 0; p < tp; p++)
+        {
+        nearest[n+p] = NearestScalar(PB, Vector(TS, index[n+p]),
+                                     guess[n+p], &error[n+p]);
+        if (second != NULL)
+          {
+          second[n+p]      = -1;
+          secondError[n+p] = MAXLLONG;
+          }
+        }
+      continue;
+      }
+
+    if (PB->Order != NULL && PB->Dim >= KERNEL_PARTIAL)
+      {
+      for (p = 0; p < tp; p++)
+        {
+        for (d = 0; d < PB->Dim; d++)
+          x[d] = (double) VectorScalar(TS, index[n+p], PB->Order[d]);
+        NearestPartial(PB, x, guess[n+p], &qmin[p], &q2[p], &jmin[p],
+                       &j2[p]);
+        }
+      }
+    else
+      {
+      for (p = 0; p < tp; p++)
+        {
+        for (d = 0; d < PB->Dim; d++)
+          x[p * PB->Dim + d] = (double) VectorScalar(TS, index[n+p], d);
+        qmin[p] = DBL_MAX;
+        q2[p]   = DBL_MAX;
+        jmin[p] = 0;
+        j2[p]   = -1;
+        }
+
+      for (j0 = 0; j0 < PB->Size; j0 += KERNEL_CHUNK)
+        {
+        j1   = (j0 + KERNEL_CHUNK < PB->Stride) ? j0 + KERNEL_CHUNK
+                                                : PB->Stride;
+        jend = (j1 < PB->Size) ? j1 : PB->Size;
+        Kernel(PB, x, tp, j0, j1, q);
+
+        for (p = 0; p < tp; p++)
+          {
+          for (j = j0; j < jend; j++)
+            {
+            v = q[p * KERNEL_CHUNK + j - j0];
+            if (v < qmin[p])
+              {
+              q2[p]   = qmin[p];
+              j2[p]   = jmin[p];
+              qmin[p] = v;
+              jmin[p] = j;
+              }
+            else if (v < q2[p])
+              {
+              q2[p] = v;
+              j2[p] = j;
+              }
+            }
+          }
+        }
+      }
+
+    /* The winner's error is computed with the original rule. If no
+       other centroid can truncate to the same value, the original
+       search would have found the same centroid; otherwise redo the
+       search with the original rule to resolve the tie. */
+    for (p = 0; p < tp; p++)
+      {
+      error[n+p] = LegacyDistance(PB, Vector(TS, index[n+p]), jmin[p],
+                                  MAXLLONG);
+      limit = (double) (error[n+p] + 1) * (1.0 + KERNEL_SLACK);
+      if (q2[p] < limit * limit)
+        {
+        nearest[n+p] = NearestScalar(PB, Vector(TS, index[n+p]),
+                                     guess[n+p], &error[n+p]);
+        }
+      else
+        {
+        nearest[n+p] = jmin[p];
+        }
+      if (second != NULL)
+        {
+        v = (nearest[n+p] == jmin[p]) ? q2[p] : qmin[p];
+        second[n+p]      = (nearest[n+p] == jmin[p]) ? j2[p] : jmin[p];
+        if (v >= DBL_MAX)  second[n+p] = -1;
+        secondError[n+p] = (second[n+p] < 0) ? MAXLLONG : (llong) sqrt(v);
+        }
+      }
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+int FindNearestVectorPacked(TRAININGSET *TS, PACKEDBOOK *PB, int index,
+int guess, llong *error, int *second, llong *secondError)
+{
+  int nearest;
+
+  FindNearestVectorsPacked(TS, PB, &index, &guess, 1, &nearest, error,
+                           second, secondError);
+  return nearest;
+}
+
+
+/* ======================= SCALAR REFERENCE ========================== */
+
+
+/*-------------------------------------------------------------------*/
+/* Weighted distance by the original rule. A result of at least best */
+/* may be inexact: the sum stops once the centroid cannot beat best. */
+/*-------------------------------------------------------------------*/
+
+
+static llong LegacyDistance(PACKEDBOOK *PB, VECTORTYPE v, int j,
+llong best)
+{
+  return PB->weight[j] * sqrt(PartialDistance(Vector(PB->CB, j), v,
+                              PB->Order, PB->Dim,
+                              WeightedLimit(best, PB->weight[j])));
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+static int NearestScalar(PACKEDBOOK *PB, VECTORTYPE v, int guess,
+llong *error)
+{
+  int   i;
+  int   MinIndex = guess;
+  llong e;
+
+  *error = LegacyDistance(PB, v, guess, MAXLLONG);
+
+  for (i = 0; i < PB->Size; i++)
+    {
+    if (i == guess)  continue;
+    e = LegacyDistance(PB, v, i, *error);
+    if (e < *error)
+      {
+      *error   = e;
+      MinIndex = i;
+      if (e == 0)  return MinIndex;
+      }
+    }
+
+  return MinIndex;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Two smallest squared weighted distances of v (qmin at jmin, q2 at */
+/* j2) like the tile loop, but each centroid is summed in the        */
+/* dimension order of PB only until it exceeds q2. The guess goes    */
+/* first, so the limits are tight early.                             */
+/*-------------------------------------------------------------------*/
+
+
+static void NearestPartial(PACKEDBOOK *PB, double *x, int guess,
+double *qmin, double *q2, int *jmin, int *j2)
+{
+  double sum, limit, t, *c;
+  int    n, j, d, e, end;
+
+  *qmin = DBL_MAX;
+  *q2   = DBL_MAX;
+  *jmin = guess;
+  *j2   = -1;
+
+  for (n = 0; n < PB->Size; n++)
+    {
+    j     = (n == 0) ? guess : (n <= guess) ? n - 1 : n;
+    c     = PB->Row + (size_t) j * PB->Dim;
+    limit = (PB->Weight2[j] > 0.0) ? *q2 / PB->Weight2[j] : DBL_MAX;
+    sum   = 0.0;
+    for (d = 0; d < PB->Dim && sum <= limit; d = end)
+      {
+      end = (d + PARTIAL_STEP < PB->Dim) ? d + PARTIAL_STEP : PB->Dim;
+      for (e = d; e < end; e++)
+        {
+        t    = x[e] - c[e];
+        sum += t * t;
+        }
+      }
+    if (sum > limit)  continue;
+
+    sum *= PB->Weight2[j];
+    if (sum < *qmin)
+      {
+      *q2   = *qmin;
+      *j2   = *jmin;
+      *qmin = sum;
+      *jmin = j;
+      }
+    else if (sum < *q2)
+      {
+      *q2 = sum;
+      *j2 = j;
+      }
+    }
+}
+
+
+/* ============================ KERNELS ============================== */
+/* Computes q[p*KERNEL_CHUNK + j-j0] = w[j]^2 * |x_p - c_j|^2 for the */
+/* tp vectors in x and the centroids j0..j1-1 (j0, j1 are multiples   */
+/* of KERNEL_WIDTH).                                                  */
+/*-------------------------------------------------------------------*/
+
+
+static void TileScalar(PACKEDBOOK *PB, double *x, int tp, int j0, int j1,
+double *q)
+{
+  int     p, d, j;
+  double  xd, t, *c, *qp;
+
+  for (p = 0; p < tp; p++)
+    {
+    qp = q + p * KERNEL_CHUNK - j0;
+    for (j = j0; j < j1; j++)  qp[j] = 0.0;
+    for (d = 0; d < PB->Dim; d++)
+      {
+      xd = x[p * PB->Dim + d];
+      c  = PB->Coord + (size_t) d * PB->Stride;
+      for (j = j0; j < j1; j++)
+        {
+        t      = xd - c[j];
+        qp[j] += t * t;
+        }
+      }
+    for (j = j0; j < j1; j++)  qp[j] *= PB->Weight2[j];
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+#if KERNEL_X86
+
+__attribute__((target("avx2,fma")))
+static void TileAVX2(PACKEDBOOK *PB, double *x, int tp, int j0, int j1,
+double *q)
+{
+  int      p, d, j, D = PB->Dim;
+  double  *c;
+  __m256d  a0, a1, a2, a3, cv, t, w;
+
+  if (tp == KERNEL_TILE)
+    {
+    for (j = j0; j < j1; j += 4)
+      {
+      a0 = a1 = a2 = a3 = _mm256_setzero_pd();
+      c  = PB->Coord + j;
+      for (d = 0; d < D; d++, c += PB->Stride)
+        {
+        cv = _mm256_load_pd(c);
+        t  = _mm256_sub_pd(_mm256_broadcast_sd(x + d), cv);
+        a0 = _mm256_fmadd_pd(t, t, a0);
+        t  = _mm256_sub_pd(_mm256_broadcast_sd(x + D + d), cv);
+        a1 = _mm256_fmadd_pd(t, t, a1);
+        t  = _mm256_sub_pd(_mm256_broadcast_sd(x + 2*D + d), cv);
+        a2 = _mm256_fmadd_pd(t, t, a2);
+        t  = _mm256_sub_pd(_mm256_broadcast_sd(x + 3*D + d), cv);
+        a3 = _mm256_fmadd_pd(t, t, a3);
+        }
+      w = _mm256_load_pd(PB->Weight2 + j);
+      _mm256_storeu_pd(q + j - j0,                  _mm256_mul_pd(a0, w));
+      _mm256_storeu_pd(q + KERNEL_CHUNK + j - j0,   _mm256_mul_pd(a1, w));
+      _mm256_storeu_pd(q + 2*KERNEL_CHUNK + j - j0, _mm256_mul_pd(a2, w));
+      _mm256_storeu_pd(q + 3*KERNEL_CHUNK + j - j0, _mm256_mul_pd(a3, w));
+      }
+    return;
+    }
+
+  for (p = 0; p < tp; p++)
+    {
+    for (j = j0; j < j1; j += 4)
+      {
+      a0 = _mm256_setzero_pd();
+      c  = PB->Coord + j;
+      for (d = 0; d < D; d++, c += PB->Stride)
+        {
+        t  = _mm256_sub_pd(_mm256_broadcast_sd(x + p*D + d), _mm256_load_pd(c));
+        a0 = _mm256_fmadd_pd(t, t, a0);
+        }
+      w = _mm256_load_pd(PB->Weight2 + j);
+      _mm256_storeu_pd(q + p*KERNEL_CHUNK + j - j0, _mm256_mul_pd(a0, w));
+      }
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+__attribute__((target("avx512f")))
+static void TileAVX512(PACKEDBOOK *PB, double *x, int tp, int j0, int j1,
+double *q)
+{
+  int      p, d, j, D = PB->Dim;
+  double  *c;
+  __m512d  a0, a1, a2, a3, cv, t, w;
+
+  if (tp == KERNEL_TILE)
+    {
+    for (j = j0; j < j1; j += 8)
+      {
+      a0 = a1 = a2 = a3 = _mm512_setzero_pd();
+      c  = PB->Coord + j;
+      for (d = 0; d < D; d++, c += PB->Stride)
+        {
+        cv = _mm512_load_pd(c);
+        t  = _mm512_sub_pd(_mm512_set1_pd(x[d]), cv);
+        a0 = _mm512_fmadd_pd(t, t, a0);
+        t  = _mm512_sub_pd(_mm512_set1_pd(x[D + d]), cv);
+        a1 = _mm512_fmadd_pd(t, t, a1);
+        t  = _mm512_sub_pd(_mm512_set1_pd(x[2*D + d]), cv);
+        a2 = _mm512_fmadd_pd(t, t, a2);
+        t  = _mm512_sub_pd(_mm512_set1_pd(x[3*D + d]), cv);
+        a3 = _mm512_fmadd_pd(t, t, a3);
+        }
+      w = _mm512_load_pd(PB->Weight2 + j);
+      _mm512_storeu_pd(q + j - j0,                  _mm512_mul_pd(a0, w));
+      _mm512_storeu_pd(q + KERNEL_CHUNK + j - j0,   _mm512_mul_pd(a1, w));
+      _mm512_storeu_pd(q + 2*KERNEL_CHUNK + j - j0, _mm512_mul_pd(a2, w));
+      _mm512_storeu_pd(q + 3*KERNEL_CHUNK + j - j0, _mm512_mul_pd(a3, w));
+      }
+    return;
+    }
+
+  for (p = 0; p < tp; p++)
+    {
+    for (j = j0; j < j1; j += 8)
+      {
+      a0 = _mm512_setzero_pd();
+      c  = PB->Coord + j;
+      for (d = 0; d < D; d++, c += PB->Stride)
+        {
+        t  = _mm512_sub_pd(_mm512_set1_pd(x[p*D + d]), _mm512_load_pd(c));
+        a0 = _mm512_fmadd_pd(t, t, a0);
+        }
+      w = _mm512_load_pd(PB->Weight2 + j);
+      _mm512_storeu_pd(q + p*KERNEL_CHUNK + j - j0, _mm512_mul_pd(a0, w));
+      }
+    }
+}
+
+#endif /* KERNEL_X86 */
+
+
+/*-------------------------------------------------------------------*/
+
+
+static void InitKernel(void)
+{
+  Kernel = SelectKernel(NULL);
+}
+
+
+/*-------------------------------------------------------------------*/
+/* The named kernel, or the fastest one the processor supports if     */
+/* name is NULL. NULL if the named kernel is not supported.           */
+/*-------------------------------------------------------------------*/
+
+
+static TILEKERNEL SelectKernel(char *name)
+{
+#if KERNEL_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") &&
+      (name == NULL || strcmp(name, "AVX-512") == 0))
+    {
+    KernelStr = "AVX-512";
+    return TileAVX512;
+    }
+  if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") &&
+      (name == NULL || strcmp(name, "AVX2") == 0))
+    {
+    KernelStr = "AVX2";
+    return TileAVX2;
+    }
+#endif
+  if (name != NULL && strcmp(name, "scalar") != 0)  return NULL;
+  KernelStr = "scalar";
+  return TileScalar;
+}
+
+
+/*-------------------------------------------------------------------*/
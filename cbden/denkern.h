@@ -0,0 +1,46 @@
+#if ! defined(__DENKERN_H)
+#define __DENKERN_H
+
+/* Number of data vectors the nearest centroid kernel processes at once. */
+#define KERNEL_TILE   4
+
+/* Codebook packed for the weighted nearest centroid kernel. Coordinates
+   are stored dimension by dimension (Coord[d*Stride + j]), so one SIMD
+   register holds the same coordinate of consecutive centroids. */
+typedef struct
+  {
+  CODEBOOK  *CB;          /* packed codebook                         */
+  double    *weight;      /* centroid weights (indexed as in CB)     */
+  int        Size;        /* number of centroids                     */
+  int        Dim;         /* vector dimension                        */
+  int        Stride;      /* Size rounded up to the SIMD width       */
+  int        Allocated;   /* Stride the buffers were allocated for   */
+  int        AllocDim;    /* Dim the buffers were allocated for      */
+  int        Finite;      /* all weights are finite                  */
+  double    *Coord;       /* Dim x Stride coordinates, 64B aligned   */
+  double    *Weight2;     /* squared weights, 64B aligned            */
+  int       *Order;       /* dimension order for partial distances,  */
+                          /* set by the owner (NULL = none)          */
+  double    *Row;         /* Size x Dim coordinates in Order         */
+  int        AllocRow;    /* elements Row was allocated for          */
+  } PACKEDBOOK;
+
+void InitPackedCodebook(PACKEDBOOK *PB);
+void PackCodebook(CODEBOOK *CB, double *weight, PACKEDBOOK *PB);
+void FreePackedCodebook(PACKEDBOOK *PB);
+
+/* second (may be NULL) receives the runner-up centroid of each vector,
+   -1 if it is not known (fewer than two centroids or infinite weights),
+   and secondError its distance (MAXLLONG if not known). */
+void FindNearestVectorsPacked(TRAININGSET *TS, PACKEDBOOK *PB, int *index,
+    int *guess, int count, int *nearest, llong *error, int *second,
+    llong *secondError);
+int  FindNearestVectorPacked(TRAININGSET *TS, PACKEDBOOK *PB, int index,
+    int guess, llong *error, int *second, llong *secondError);
+
+char* KernelName(void);
+
+/* Selects the kernel by name, NO if not supported (see DENKERN.C). */
+int   UseKernel(char *name);
+
+#endif /* __DENKERN_H */
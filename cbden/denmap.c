@@ -0,0 +1,241 @@
+/*--------------------------------------------------------------------*/
+/* DENMAP.C        agent                                              */
+/*                                                                    */
+/* Binary training sets for the density-based random swap. The file   */
+/* is mapped into memory (read only, shared) and the vectors of the   */
+/* TRAININGSET point into the mapping, so nothing is parsed or copied */
+/* and jobs on the same data share the page cache. Only the node      */
+/* array is allocated. The vectors must not be modified.              */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.02: 17.10.26 AG: Header sizes checked against overflow.          */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cb.h"
+#include "interfc.h"
+#include "denmap.h"
+
+
+/* ========================== PROTOTYPES ============================= */
+
+static int  ValidHeader(DATAHEADER *H, size_t size);
+static void MapError(char *message, char *name);
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+/*-------------------------------------------------------------------*/
+/* Returns 1 if the file starts with the header of a binary set.     */
+/*-------------------------------------------------------------------*/
+
+
+int IsMappedDataset(char *name)
+{
+  FILE *f = fopen(name, "rb");
+  char  magic[4];
+  int   found;
+
+  if (!f)  return 0;
+  found = (fread(magic, 1, 4, f) == 4 &&
+           memcmp(magic, DENMAP_MAGIC, 4) == 0);
+  fclose(f);
+  return found;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void ReadMappedDataset(char *name, TRAININGSET *TS, MAPPEDSET *M)
+{
+  DATAHEADER    *H;
+  VECTORELEMENT *data;
+  int           *freq;
+  struct stat    st;
+  llong          i;
+  int            fd, dim;
+
+  fd = open(name, O_RDONLY);
+  if (fd < 0 || fstat(fd, &st) != 0)  MapError("Cannot open", name);
+  if ((size_t) st.st_size < sizeof(DATAHEADER))
+    {
+    MapError("Truncated header in", name);
+    }
+
+  M->Size = st.st_size;
+  M->Base = mmap(NULL, M->Size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (M->Base == MAP_FAILED)  MapError("Cannot map", name);
+
+  H = (DATAHEADER*) M->Base;
+  if (memcmp(H->Magic, DENMAP_MAGIC, 4) != 0 ||
+      H->Version != DENMAP_VERSION)
+    {
+    MapError("Unknown format version in", name);
+    }
+  if (H->Endian != DENMAP_ENDIAN)  MapError("Wrong byte order in", name);
+  if (H->ElementType != DENMAP_INT32 || sizeof(VECTORELEMENT) != 4)
+    {
+    MapError("Unsupported element type in", name);
+    }
+
+  if (!ValidHeader(H, M->Size))  MapError("Inconsistent header in", name);
+  dim = H->BlockSizeX * H->BlockSizeY;
+
+  data = (VECTORELEMENT*) ((char*) M->Base + H->HeaderSize);
+  freq = (int*) (data + (size_t) H->Count * dim);
+
+  /* the fields the toolkit readers fill in */
+  memset(TS, 0, sizeof(TRAININGSET));
+  TS->BlockSizeX      = H->BlockSizeX;
+  TS->BlockSizeY      = H->BlockSizeY;
+  TS->BytesPerElement = H->BytesPerElement;
+  TS->MinValue        = H->MinValue;
+  TS->MaxValue        = H->MaxValue;
+  TS->CodebookSize    = (int) H->Count;
+  TS->AllocatedSize   = (int) H->Count;
+  TS->TotalFreq       = (int) H->TotalFreq;
+  TS->Book            = (BOOKNODE*) calloc(H->Count, sizeof(BOOKNODE));
+  if (!TS->Book)
+    {
+    ErrorMessage("ERROR: Allocating memory failed!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
+
+  for (i = 0; i < H->Count; i++)
+    {
+    Vector(TS, i)     = data + (size_t) i * dim;
+    VectorFreq(TS, i) = H->HasFreq ? freq[i] : 1;
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Checks that the sizes of the header fit in int and that the data  */
+/* they describe fits in the file of size bytes. The products are    */
+/* checked before they are formed, so a corrupt header cannot wrap   */
+/* them around.                                                      */
+/*-------------------------------------------------------------------*/
+
+
+static int ValidHeader(DATAHEADER *H, size_t size)
+{
+  size_t per;
+
+  if (H->HeaderSize < (int) sizeof(DATAHEADER) ||
+      (size_t) H->HeaderSize > size ||
+      H->HeaderSize % sizeof(VECTORELEMENT) != 0)
+    {
+    return 0;
+    }
+  if (H->BlockSizeX < 1 || H->BlockSizeY < 1 ||
+      H->BlockSizeX > INT_MAX / H->BlockSizeY)
+    {
+    return 0;
+    }
+  if (H->Count < 1 || H->Count > INT_MAX ||
+      H->TotalFreq < 0 || H->TotalFreq > INT_MAX)
+    {
+    return 0;
+    }
+
+  /* bytes per vector, with its frequency */
+  per = (size_t) H->BlockSizeX * H->BlockSizeY;
+  if (per > SIZE_MAX / sizeof(VECTORELEMENT) - 1)  return 0;
+  per = per * sizeof(VECTORELEMENT) + (H->HasFreq ? sizeof(int) : 0);
+  return (size_t) H->Count <= (size - H->HeaderSize) / per;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Replaces FreeCodebook() for a mapped set.                         */
+/*-------------------------------------------------------------------*/
+
+
+void FreeMappedDataset(TRAININGSET *TS, MAPPEDSET *M)
+{
+  free(TS->Book);
+  TS->Book = NULL;
+  munmap(M->Base, M->Size);
+  M->Base = NULL;
+  M->Size = 0;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void WriteMappedDataset(char *name, TRAININGSET *TS)
+{
+  DATAHEADER H;
+  char       pad[DENMAP_ALIGN];
+  FILE      *f;
+  int        i, ok, freq, hasFreq = 0;
+
+  for (i = 0; i < BookSize(TS); i++)
+    {
+    if (VectorFreq(TS, i) != 1)  hasFreq = 1;
+    }
+
+  memset(&H, 0, sizeof(DATAHEADER));
+  memcpy(H.Magic, DENMAP_MAGIC, 4);
+  H.Version         = DENMAP_VERSION;
+  H.Endian          = DENMAP_ENDIAN;
+  H.HeaderSize      = DENMAP_ALIGN;
+  H.ElementType     = DENMAP_INT32;
+  H.BlockSizeX      = TS->BlockSizeX;
+  H.BlockSizeY      = TS->BlockSizeY;
+  H.BytesPerElement = TS->BytesPerElement;
+  H.MinValue        = TS->MinValue;
+  H.MaxValue        = TS->MaxValue;
+  H.HasFreq         = hasFreq;
+  H.Count           = BookSize(TS);
+  H.TotalFreq       = TotalFreq(TS);
+
+  f = fopen(name, "wb");
+  if (!f)  MapError("Cannot create", name);
+
+  memset(pad, 0, DENMAP_ALIGN);
+  ok = (fwrite(&H, sizeof(DATAHEADER), 1, f) == 1 &&
+        fwrite(pad, 1, DENMAP_ALIGN - sizeof(DATAHEADER), f) ==
+        DENMAP_ALIGN - sizeof(DATAHEADER));
+  for (i = 0; ok && i < BookSize(TS); i++)
+    {
+    ok = (fwrite(Vector(TS, i), sizeof(VECTORELEMENT), VectorSize(TS), f)
+          == (size_t) VectorSize(TS));
+    }
+  for (i = 0; ok && hasFreq && i < BookSize(TS); i++)
+    {
+    freq = VectorFreq(TS, i);
+    ok   = (fwrite(&freq, sizeof(int), 1, f) == 1);
+    }
+
+  if (fclose(f) != 0 || !ok)  MapError("Cannot write", name);
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+static void MapError(char *message, char *name)
+{
+  ErrorMessage("ERROR: %s binary training set %s!\n", message, name);
+  ExitProcessing(FATAL_ERROR);
+}
+
+
+/*-------------------------------------------------------------------*/
@@ -0,0 +1,47 @@
+#if ! defined(__DENMAP_H)
+#define __DENMAP_H
+
+#define DENMAP_MAGIC      "CBDB"
+#define DENMAP_VERSION    1
+#define DENMAP_ENDIAN     0x01020304
+/* Offset of the vectors from the start of the file. */
+#define DENMAP_ALIGN      64
+
+/* Element types. Only the type of VECTORELEMENT can be read in place. */
+#define DENMAP_INT32      1
+
+/* Header of a binary training set. It is followed (at HeaderSize) by
+   Count x Dim elements, vector by vector, and then, if HasFreq, by
+   Count int frequencies. Numbers are in the byte order of the machine
+   that wrote the file; Endian tells if it is the same. */
+typedef struct
+  {
+  char       Magic[4];
+  int        Version;
+  int        Endian;
+  int        HeaderSize;
+  int        ElementType;
+  int        BlockSizeX;
+  int        BlockSizeY;
+  int        BytesPerElement;     /* of the original text file       */
+  int        MinValue;
+  int        MaxValue;
+  int        HasFreq;
+  int        Reserved;
+  llong      Count;
+  llong      TotalFreq;
+  } DATAHEADER;
+
+/* A training set mapped from a binary file. */
+typedef struct
+  {
+  void      *Base;
+  size_t     Size;
+  } MAPPEDSET;
+
+int  IsMappedDataset(char *name);
+void ReadMappedDataset(char *name, TRAININGSET *TS, MAPPEDSET *M);
+void FreeMappedDataset(TRAININGSET *TS, MAPPEDSET *M);
+void WriteMappedDataset(char *name, TRAININGSET *TS);
+
+#endif /* __DENMAP_H */
@@ -0,0 +1,332 @@
+/*--------------------------------------------------------------------*/
+/* DENRANGE.C      agent                                              */
+/*                                                                    */
+/* Cluster-count search for the density-based random swap. Clusters   */
+/* the data for a range of k in one process: each k after the first   */
+/* of a chain starts from the solution of k-1 with its worst cluster  */
+/* split, so it needs far fewer swaps than a run from scratch. The    */
+/* solutions are compared with the WB-index (Zhao & Fränti).         */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.05: 17.10.26 AG: One deadline for the whole range.               */
+/* 0.04: 17.10.26 AG: Chains use their threads; shared seed helper.   */
+/* 0.03: 17.10.26 AG: Chain restarts cold after a failed count.       */
+/* 0.02: 17.10.26 AG: Toolkit allocations through the shared lock.    */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "cb.h"
+#include "interfc.h"
+#include "denutil.h"
+#include "denkern.h"
+#include "denwork.h"
+#include "dentrial.h"
+#include "denstats.h"
+#include "denstore.h"
+#include "dentraj.h"
+#include "denrs.h"
+#include "denrange.h"
+
+
+#define min(a,b) ((a) < (b) ? (a) : (b))
+#define max(a,b) ((a) > (b) ? (a) : (b))
+
+
+/* ========================== PROTOTYPES ============================= */
+
+static void  SplitWorstCluster(TRAININGSET *TS, CODEBOOK *CB,
+             PARTITIONING *P, CODEBOOK *CBnew);
+static void  RunChain(DENRSCONTEXT *ctx, TRAININGSET *pTS, CODEBOOK *pCB,
+             PARTITIONING *pP, int lo, int hi, int warmIter, int threads,
+             llong seed, double deadline, KRANGE *R, double *bestWeight,
+             int *have);
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+int RunDenRSRange(DENRSCONTEXT *ctx, TRAININGSET *pTS, CODEBOOK *pCB,
+PARTITIONING *pP, int kmin, int kmax, int chain, int warmIter, KRANGE *R)
+{
+  DENSESTORE  TSstore;
+  double     *bestWeight, deadline;
+  llong       seed;
+  int         threads = ctx->Options.Threads;
+  int         k, c, chains, outer, inner, levels, have = 0;
+
+  memset(R, 0, sizeof(KRANGE));
+  if ((kmin < 1) || (kmax < kmin) || (kmax > BookSize(pTS)) ||
+      (chain < 0) || (warmIter < 0) || (threads < 0))
+    {
+    return 1;
+    }
+
+  R->Min    = kmin;
+  R->Max    = kmax;
+  R->Result = (KRESULT*) DenAlloc((kmax - kmin + 1) * sizeof(KRESULT));
+  for (k = kmin; k <= kmax; k++)
+    {
+    memset(&R->Result[k - kmin], 0, sizeof(KRESULT));
+    R->Result[k - kmin].K      = k;
+    R->Result[k - kmin].Failed = 1;
+    }
+
+  if (chain == 0)  chain = kmax - kmin + 1;
+  if (threads == 0)  threads = DefaultThreads();
+  chains   = (kmax - kmin + chain) / chain;
+  deadline = DenRSDeadline(ctx);
+  seed     = ctx->Options.Seed;
+  if (seed < 0)
+    {
+    seed = RandomSeed();
+    }
+  bestWeight = (double*) DenAlloc(kmax * sizeof(double));
+
+  /* attached once, so the runs use the store in place */
+  AttachDenseStore(&TSstore, pTS, 0);
+  levels = BeginNesting(threads, chains, &outer, &inner);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) num_threads(outer) if (outer > 1)
+#endif
+  for (c = 0; c < chains; c++)
+    {
+    RunChain(ctx, pTS, pCB, pP, kmin + c * chain,
+             min(kmax, kmin + (c + 1) * chain - 1), warmIter, inner, seed,
+             deadline, R, bestWeight, &have);
+    }
+
+  EndNesting(levels);
+  DetachDenseStore(&TSstore, pTS);
+
+  if (R->Best > 0 && ctx->Weights != NULL)
+    {
+    memcpy(ctx->Weights, bestWeight, R->Best * sizeof(double));
+    }
+  free(bestWeight);
+  return (R->Best == 0);
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void FreeKRange(KRANGE *R)
+{
+  free(R->Result);
+  memset(R, 0, sizeof(KRANGE));
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Clusters k = lo..hi, each k from the solution of k-1 unless that  */
+/* run failed. The best solution so far (*have set) is kept in pCB,  */
+/* pP and bestWeight. Every run stops at the deadline of the whole   */
+/* range (0 = none), and a count that would start after it fails.    */
+/*-------------------------------------------------------------------*/
+
+
+static void RunChain(DENRSCONTEXT *ctx, TRAININGSET *pTS, CODEBOOK *pCB,
+PARTITIONING *pP, int lo, int hi, int warmIter, int threads, llong seed,
+double deadline, KRANGE *R, double *bestWeight, int *have)
+{
+  DENRSOPTIONS  options = ctx->Options;
+  DENRSCONTEXT *run;
+  CODEBOOK      CB, CBprev;
+  PARTITIONING  P, Pprev;
+  KRESULT      *res;
+  double       *weight;
+  int           k, i, result, prev = 0;
+
+  weight = (double*) DenAlloc(hi * sizeof(double));
+  options.Threads    = threads;
+  options.QuietLevel = 0;
+  options.Monitoring = 0;
+
+  for (k = lo; k <= hi; k++)
+    {
+    res = &R->Result[k - R->Min];
+
+    DenNewCodebook(&CB, k, pTS);
+    DenNewPartitioning(&P, pTS, k);
+
+    /* previous centroids and a new one in the worst cluster */
+    res->Warm = prev;
+    if (res->Warm)
+      {
+      for (i = 0; i < k - 1; i++)
+        {
+        CopyVector(Vector(&CBprev, i), Vector(&CB, i), VectorSize(&CB));
+        VectorFreq(&CB, i) = VectorFreq(&CBprev, i);
+        }
+      SplitWorstCluster(pTS, &CBprev, &Pprev, &CB);
+      DenFreeCodebook(&CBprev);
+      DenFreePartitioning(&Pprev);
+      }
+
+    options.Seed       = seed + k;
+    options.Iterations = (res->Warm && warmIter > 0) ? warmIter
+                                                     : ctx->Options.Iterations;
+    run           = CreateDenRSContext(&options);
+    run->Weights  = weight;
+    run->Deadline = deadline;
+    result        = 1;
+    if (deadline <= 0.0 || WallClock() < deadline)
+      {
+      result = RunDenRS(run, pTS, &CB, &P, res->Warm);
+      }
+
+    res->Failed = result;
+    if (!result)
+      {
+      res->Error = run->Error;
+      res->Index = WBIndex(pTS, &CB, &P, &res->MSE);
+      }
+    FreeDenRSContext(run);
+
+#ifdef _OPENMP
+#pragma omp critical (DenRSRange)
+#endif
+      {
+      if (!result && (!*have || res->Index < R->Result[R->Best - R->Min].Index
+          || (res->Index == R->Result[R->Best - R->Min].Index && k < R->Best)))
+        {
+        if (*have)
+          {
+          DenFreeCodebook(pCB);
+          DenFreePartitioning(pP);
+          }
+        DenNewCodebook(pCB, k, pTS);
+        DenNewPartitioning(pP, pTS, k);
+        CopyCodebook(&CB, pCB);
+        CopyPartitioning(&P, pP);
+        memcpy(bestWeight, weight, k * sizeof(double));
+        R->Best = k;
+        *have   = 1;
+        }
+      }
+
+    /* a failed run leaves no solution to start the next k from */
+    prev = !result;
+    if (prev)
+      {
+      CBprev = CB;
+      Pprev  = P;
+      }
+    else
+      {
+      DenFreeCodebook(&CB);
+      DenFreePartitioning(&P);
+      }
+    }
+
+  if (prev)
+    {
+    DenFreeCodebook(&CBprev);
+    DenFreePartitioning(&Pprev);
+    }
+  free(weight);
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Sets the last centroid of CBnew to the vector farthest from its   */
+/* centroid in the cluster of CB with the largest squared error.     */
+/*-------------------------------------------------------------------*/
+
+
+static void SplitWorstCluster(TRAININGSET *TS, CODEBOOK *CB,
+PARTITIONING *P, CODEBOOK *CBnew)
+{
+  llong *sse, d, far = -1;
+  int    i, j, worst = 0, vec = 0;
+
+  sse = (llong*) DenAlloc(BookSize(CB) * sizeof(llong));
+  memset(sse, 0, BookSize(CB) * sizeof(llong));
+
+  for (i = 0; i < BookSize(TS); i++)
+    {
+    j       = Map(P, i);
+    sse[j] += VectorFreq(TS, i) *
+              VectorDistance(Vector(TS, i), Vector(CB, j), VectorSize(TS),
+                             MAXLLONG, EUCLIDEANSQ);
+    }
+  for (j = 1; j < BookSize(CB); j++)
+    {
+    if (sse[j] > sse[worst])  worst = j;
+    }
+
+  for (i = 0; i < BookSize(TS); i++)
+    {
+    if (Map(P, i) != worst)  continue;
+    d = VectorDistance(Vector(TS, i), Vector(CB, worst), VectorSize(TS),
+                       MAXLLONG, EUCLIDEANSQ);
+    if (d > far)
+      {
+      far = d;
+      vec = i;
+      }
+    }
+
+  CopyVector(Vector(TS, vec), Vector(CBnew, BookSize(CB)), VectorSize(TS));
+  VectorFreq(CBnew, BookSize(CB)) = 0;
+  free(sse);
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+double WBIndex(TRAININGSET *TS, CODEBOOK *CB, PARTITIONING *P, double *mse)
+{
+  double *mean, ssw = 0.0, ssb = 0.0, diff, sum;
+  llong   total = 0;
+  int     i, j, d, dim = VectorSize(TS);
+
+  mean = (double*) DenAlloc(dim * sizeof(double));
+  for (d = 0; d < dim; d++)  mean[d] = 0.0;
+
+  for (i = 0; i < BookSize(TS); i++)
+    {
+    ssw   += (double) VectorFreq(TS, i) *
+             VectorDistance(Vector(TS, i), Vector(CB, Map(P, i)), dim,
+                            MAXLLONG, EUCLIDEANSQ);
+    total += VectorFreq(TS, i);
+    for (d = 0; d < dim; d++)
+      {
+      mean[d] += (double) VectorFreq(TS, i) * Vector(TS, i)[d];
+      }
+    }
+  for (d = 0; d < dim; d++)  mean[d] /= max(total, 1);
+
+  for (j = 0; j < BookSize(CB); j++)
+    {
+    if (CCFreq(P, j) == 0)  continue;
+    sum = 0.0;
+    for (d = 0; d < dim; d++)
+      {
+      diff = Vector(CB, j)[d] - mean[d];
+      sum += diff * diff;
+      }
+    ssb += CCFreq(P, j) * sum;
+    }
+  free(mean);
+
+  if (mse != NULL)  *mse = ssw / ((double) max(total, 1) * dim);
+  return (ssb > 0.0) ? BookSize(CB) * ssw / ssb : DBL_MAX;
+}
+
+
+/*-------------------------------------------------------------------*/
@@ -0,0 +1,46 @@
+#if ! defined(__DENRANGE_H)
+#define __DENRANGE_H
+
+/* Solution of one cluster count of RunDenRSRange. */
+typedef struct
+  {
+  int        K;
+  int        Warm;              /* started from the solution of K-1   */
+  int        Failed;            /* or not run before the deadline     */
+  llong      Error;             /* objective function value           */
+  double     MSE;               /* unweighted MSE                     */
+  double     Index;             /* WB-index, smaller is better        */
+  } KRESULT;
+
+/* Cluster counts Min..Max; Result has one entry per count. */
+typedef struct
+  {
+  int        Min;
+  int        Max;
+  int        Best;              /* chosen count, 0 if none            */
+  KRESULT   *Result;
+  } KRANGE;
+
+/* Clusters pTS for k = kmin..kmax and returns the k with the smallest
+   WB-index in pCB and pP (created here, with the chosen size) and in
+   ctx->Weights (at least kmax entries, may be NULL). The counts are
+   divided into chains of chain consecutive values (0 = one chain).
+   The first count of a chain, and a count after a failed one, starts
+   from a random solution and the others from the previous solution
+   with its worst cluster split, running warmIter swap iterations
+   (0 = Options.Iterations). Chains are independent and run in
+   parallel; with fewer chains than threads, each chain runs on its
+   share of them. Count k uses the seed Options.Seed + k, so the result
+   does not depend on the threads. TimeLimit is the time of the whole
+   range: all runs share one deadline. */
+int    RunDenRSRange(DENRSCONTEXT *ctx, TRAININGSET *pTS, CODEBOOK *pCB,
+    PARTITIONING *pP, int kmin, int kmax, int chain, int warmIter,
+    KRANGE *R);
+void   FreeKRange(KRANGE *R);
+
+/* WB-index k*SSW/SSB (sum of squares within / between clusters);
+   mse (may be NULL) receives SSW as MSE. */
+double WBIndex(TRAININGSET *TS, CODEBOOK *CB, PARTITIONING *P,
+    double *mse);
+
+#endif /* __DENRANGE_H */
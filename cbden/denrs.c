@@ -11,6 +11,36 @@
 /*                                                                    */
 /* ChangeLog:                                                         */
 /*                                                                    */
+/* 0.42: 17.10.26 AG: Repeats share one deadline.                     */
+/* 0.41: 17.10.26 AG: Monitor state in the checkpoints.               */
+/* 0.40: 17.10.26 AG: Reference search with partial distances.        */
+/* 0.39: 17.10.26 AG: Second nearest centroids in the undo log.       */
+/* 0.38: 17.10.26 AG: Stale second nearest centroids are forgotten.   */
+/* 0.37: 17.10.26 AG: Duplicate check of the swap with a hash.        */
+/* 0.36: 17.10.26 AG: Repeats use their threads; one seed helper.     */
+/* 0.35: 17.10.26 AG: Toolkit allocations through the shared lock.    */
+/* 0.34: 17.10.26 AG: Removed the unused CalculateWeights.            */
+/* 0.33: 17.10.26 AG: All run output through the context.             */
+/* 0.32: 17.10.26 AG: Time limit and best-so-far solutions.           */
+/* 0.31: 17.10.26 AG: Checkpoints and resume of a run.                */
+/* 0.30: 17.10.26 AG: Partial distances with weight-scaled limits.    */
+/* 0.29: 17.10.26 AG: Second nearest centroids kept by K-means.       */
+/* 0.28: 17.10.26 AG: K-means++ seeding, optionally density-biased.   */
+/* 0.27: 17.10.26 AG: Independent restarts with best-of selection.    */
+/* 0.26: 17.10.26 AG: Per-iteration buffers kept in a workspace.      */
+/* 0.25: 17.10.26 AG: Reentrant run with an explicit context.         */
+/* 0.24: 17.10.26 AG: Trajectory of the accepted swaps.               */
+/* 0.23: 17.10.26 AG: Vectors in contiguous aligned storage.          */
+/* 0.22: 17.10.26 AG: Per-phase metrics written to CSV or JSON.       */
+/* 0.21: 17.10.26 AG: Cluster walks over contiguous member lists.     */
+/* 0.20: 17.10.26 AG: Object attraction with a grid index.            */
+/* 0.19: 17.10.26 AG: Optional K-means with distance bounds.          */
+/* 0.18: 17.10.26 AG: Densities from cached cluster distances.        */
+/* 0.17: 17.10.26 AG: Objective function from per-cluster sums.       */
+/* 0.16: 17.10.26 AG: Trials work in place with an undo log.          */
+/* 0.15: 17.10.26 AG: Speculative parallel swap trials.               */
+/* 0.14: 17.10.26 AG: Parallel partitioning with deterministic merge. */
+/* 0.13: 17.10.26 AG: Nearest centroid search with SIMD kernels.      */
 /* 0.12:  16.3.18 RS: Clean up unused parts of the code.              */
 /* 0.11:  11.3.18 RS: Density calculation based on dens(i)=n/md(i).   */
 /* 0.10:  10.3.18 RS: Removed weight trial-and-error.                 */
@@ -27,8 +57,8 @@
 
 
 #define ProgName       "DENRS"
-#define VersionNumber  "Version 0.12"
-#define LastUpdated    "15.3.2018"  /* JP */
+#define VersionNumber  "Version 0.42"
+#define LastUpdated    "17.10.2026"
 
 /* converts ObjectiveFunction values to MSE values */
 #define CALC_MSE(val) (double) (val) / (TotalFreq(pTS) * VectorSize(pTS))
@@ -37,6 +67,13 @@
 #define AUTOMATIC_MAX_ITER  50000
 #define AUTOMATIC_MIN_SPEED 1e-5
 #define min(a,b) ((a) < (b) ? (a) : (b))
+#define max(a,b) ((a) > (b) ? (a) : (b))
+
+/* relative slack for the search radius of the object attraction */
+#define ATTRACTION_SLACK    1e-9
+
+/* longest message passed to the output callback */
+#define DENRS_MESSAGE       1024
 
 /*-------------------------------------------------------------------*/
 
@@ -46,63 +83,169 @@
 #include <limits.h>
 #include <float.h>
 #include <string.h>
+#include <stdarg.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "cb.h"
 #include "random.h"
 #include "interfc.h"
-#include "reporting.h"
+#include "denutil.h"
 #include "file.h"
 #include "memctrl.h"
+#include "denkern.h"
+#include "denwork.h"
+#include "denbound.h"
+#include "denindex.h"
+#include "dentrial.h"
+#include "denstats.h"
+#include "denstore.h"
+#include "dentraj.h"
+#include "denckpt.h"
+#include "denrs.h"
+#include "denseed.h"
 
 /* ========================== PROTOTYPES ============================= */
 
-int PerformDenRS(TRAININGSET *pTS, CODEBOOK *pCB, PARTITIONING *pP, int iter,
-    int kmIter, int deterministic, int quietLevel, int useInitialCB,
-    int monitoring);
+/* One candidate solution of the swap loop. The trial modifies CB and P
+   in place and records the changes in log. A single trial works on the
+   current solution itself; parallel trials each have a private copy.
+   bounds (NULL if not used) belong to the same copy. grid (NULL if
+   not used) is shared by all slots; candidate is the buffer for it.
+   stats is NULL unless metrics are written. distance holds the
+   distances to the own centroids; second and secondDist the second
+   nearest centroids and their squared distances, which the log keeps
+   for the deterministic variant (see OptimalPartition).
+   hash holds the centroids of CB for the duplicate check of the swap.
+   store holds the vectors of CBown. work is the workspace of the run
+   for a single trial and workOwn for parallel ones. expired is set
+   when the time limit cut the trial short. */
+typedef struct
+  {
+  CODEBOOK     *CB;
+  PARTITIONING *P;
+  CODEBOOK      CBown;
+  PARTITIONING  Pown;
+  DENSESTORE    store;
+  WORKSPACE    *work;
+  WORKSPACE     workOwn;
+  TRIALLOG      log;
+  VECTORHASH    hash;           /* centroids, for the swap            */
+  BOUNDS       *bounds;
+  GRIDINDEX    *grid;
+  int          *candidate;
+  TRIALSTATS   *stats;
+  double       *weight;
+  llong        *distance;
+  int          *second;
+  llong        *secondDist;
+  llong         error;
+  int           j;
+  int           valid;
+  int           expired;
+  } TRIALSLOT;
+
+static void ContextMessage(DENRSCONTEXT *ctx, char *format, ...);
+static void PrintToStdout(void *user, char *message);
+static double RunTime(DENRSCONTEXT *ctx);
+static void ReportHeader(DENRSCONTEXT *ctx, int quietLevel);
+static void ReportIteration(DENRSCONTEXT *ctx, int quietLevel, int iter,
+    double error, int ci, int better);
+static void ReportFooter(DENRSCONTEXT *ctx, int quietLevel, int iter,
+    double error);
+static YESNO TimeOver(double deadline);
+void RunTrial(DENRSCONTEXT *ctx, TRAININGSET *pTS, double *weight,
+    TRIALSLOT *S, RANDOMSTATE *rng, int deterministic, int kmIter,
+    int quietLevel, llong currError, int threads, double deadline);
+TRIALSLOT* CreateTrialSlots(TRAININGSET *pTS, CODEBOOK *pCB,
+    PARTITIONING *pP, int count, int bounded, GRIDINDEX *grid, int stats,
+    WORKSPACE *work);
+void FreeTrialSlots(TRIALSLOT *slot, int count);
+static void CheckpointHeader(CHECKPOINT *C, TRAININGSET *pTS,
+    CODEBOOK *pCB, int trials, int deterministic, int monitoring);
+static void SaveCheckpoint(DENRSCONTEXT *ctx, CHECKPOINT *C,
+    CODEBOOK *pCB, PARTITIONING *pP, double *weight, TRIALSLOT *slot,
+    WORKSPACE *W);
+static void ResumeTrialSlots(FILE *f, DENRSCONTEXT *ctx, CHECKPOINT *C,
+    TRIALSLOT *slot, WORKSPACE *W);
+static void SlotArrays(CHECKPOINT *C, TRIALSLOT *slot, WORKSPACE *W);
+void SeedRandom(RANDOMSTATE *rng, unsigned long long seed, int trial);
+unsigned long long NextRandom(RANDOMSTATE *rng);
 void InitializeSolution(PARTITIONING *pP, CODEBOOK *pCB, TRAININGSET *pTS,
     int clus);
 void FreeSolution(PARTITIONING *pP, CODEBOOK *pCB);
-YESNO StopCondition(double currError, double newError, int iter);
+YESNO StopCondition(DENRSCONTEXT *ctx, double currError, double newError,
+    int iter);
 llong GenerateInitialSolution(PARTITIONING *pP, CODEBOOK *pCB,
-    TRAININGSET *pTS, int useInitialCB, double *weight);
-void SelectRandomRepresentatives(TRAININGSET *pTS, CODEBOOK *pCB);
-int SelectRandomDataObject(CODEBOOK *pCB, TRAININGSET *pTS);
+    TRAININGSET *pTS, int useInitialCB, int seeding, double *weight,
+    int threads, RANDOMSTATE *rng, WORKSPACE *W);
+void SelectRandomRepresentatives(TRAININGSET *pTS, CODEBOOK *pCB,
+    RANDOMSTATE *rng);
+int SelectRandomDataObject(CODEBOOK *pCB, TRAININGSET *pTS, RANDOMSTATE *rng,
+    VECTORHASH *H);
 void RandomCodebook(TRAININGSET *pTS, CODEBOOK *pCB);
-void RandomSwap(CODEBOOK *pCB, TRAININGSET *pTS, int *j, int deterministic, 
-    int quietLevel);
-void LocalRepartition(PARTITIONING *pP, CODEBOOK *pCB, TRAININGSET *pTS, 
-    double *weight, int j, double time, int quietLevel);
+void RandomSwap(DENRSCONTEXT *ctx, CODEBOOK *pCB, TRAININGSET *pTS, int *j,
+    int deterministic, int quietLevel, RANDOMSTATE *rng, TRIALLOG *log,
+    VECTORHASH *H);
+void LocalRepartition(DENRSCONTEXT *ctx, PARTITIONING *pP, CODEBOOK *pCB,
+    TRAININGSET *pTS, double *weight, int j, int quietLevel, TRIALLOG *log,
+    GRIDINDEX *grid, int *candidate, WORKSPACE *W);
+void RepartitionDueToNewVector(DENRSCONTEXT *ctx, TRAININGSET *pTS,
+    CODEBOOK *pCB, PARTITIONING *pP, int j, TRIALLOG *log, GRIDINDEX *grid,
+    int *candidate, int quietLevel);
 void OptimalRepresentatives(PARTITIONING *pP, TRAININGSET *pTS,
-    CODEBOOK *pCB, int *active, llong *cdist, int *activeCount);
+    CODEBOOK *pCB, int *active, llong *cdist, int *activeCount, TRIALLOG *log,
+    WORKSPACE *W);
 int BinarySearch(int *arr, int size, int key);
-void OptimalPartition(CODEBOOK *pCB, TRAININGSET *pTS, PARTITIONING *pP, int *active,
-    llong *cdist, int activeCount, llong *distance, double *weight, int quietLevel);
-void KMeans(PARTITIONING *pP, CODEBOOK *pCB, TRAININGSET *pTS, llong *distance,
-    double *weight, int iter, int quietLevel, double time, double *tempweight, llong currError);
+void OptimalPartition(DENRSCONTEXT *ctx, CODEBOOK *pCB, TRAININGSET *pTS,
+    PARTITIONING *pP, int *active, llong *cdist, int activeCount,
+    llong *distance, double *weight, int quietLevel, int threads,
+    TRIALLOG *log, WORKSPACE *W);
+void BoundedPartition(DENRSCONTEXT *ctx, CODEBOOK *pCB, TRAININGSET *pTS,
+    PARTITIONING *pP, double *weight, BOUNDS *B, int quietLevel, int threads,
+    TRIALLOG *log, WORKSPACE *W);
+int  KMeans(DENRSCONTEXT *ctx, PARTITIONING *pP, CODEBOOK *pCB, TRAININGSET *pTS, llong *distance,
+    double *weight, int iter, int quietLevel, double *tempweight, llong currError,
+    int threads, TRIALLOG *log, BOUNDS *bounds, TRIALSTATS *stats,
+    WORKSPACE *W, double deadline);
 llong ObjectiveFunction(PARTITIONING *pP, CODEBOOK *pCB, TRAININGSET *pTS,
-    double *weight);
+    double *weight, WORKSPACE *W);
 void CalculateDistances(TRAININGSET *pTS, CODEBOOK *pCB, PARTITIONING *pP,
-    llong *distance, double *weight);
+    llong *distance, double *weight, int threads);
 int FindSecondNearestVector(BOOKNODE *node, CODEBOOK *pCB, int firstIndex,
-    llong *secondError);
+    double *weight, int *order, llong *secondError, llong *secondDist);
 int SelectClusterToBeSwapped(TRAININGSET *pTS, CODEBOOK *pCB, 
-    PARTITIONING *pP, llong *distance);
+    PARTITIONING *pP, llong *distance, double *weight, TRIALLOG *log,
+    WORKSPACE *W);
 char* DenRSInfo(void);
 double GenerateOptimalPartitioningWithWeight(TRAININGSET* TS, CODEBOOK* CB,
-    PARTITIONING* P, ERRORFTYPE errorf, double *weight);
+    PARTITIONING* P, ERRORFTYPE errorf, double *weight, int threads,
+    WORKSPACE *W);
 void LocalRepartitioningWithWeight(TRAININGSET* TS,CODEBOOK* CB, PARTITIONING* P,
-    double* weight, int index, DISTANCETYPE disttype);
+    double* weight, int index, DISTANCETYPE disttype, TRIALLOG *log,
+    WORKSPACE *W);
 int FindNearestVectorWithWeight(BOOKNODE* v, CODEBOOK* CB, llong* error,
-    int guess, DISTANCETYPE disttype, double* weight);
+    int guess, DISTANCETYPE disttype, double* weight, int *order);
+static llong WeightedDistance(BOOKNODE* v, CODEBOOK* CB, int i,
+    DISTANCETYPE disttype, double* weight, int *order, llong best);
 double GenerateOptimalPartitioningMeanErrorWithWeight(TRAININGSET* TS,
-    CODEBOOK* CB, PARTITIONING* P, DISTANCETYPE  disttype, double* weight);
+    CODEBOOK* CB, PARTITIONING* P, DISTANCETYPE  disttype, double* weight,
+    int threads, WORKSPACE *W);
+int  DefaultThreads(void);
+void AddMove(MOVELIST *M, int vec, int to);
+void ApplyMoves(TRAININGSET *TS, PARTITIONING *P, MOVELIST *M, int threads,
+    TRIALLOG *log);
+static void ThreadRange(int size, int *tid, int *lo, int *hi);
 llong TotalDistance(TRAININGSET* TS, CODEBOOK* CB, PARTITIONING* P, int index);
 double MeanDistance(TRAININGSET* TS, CODEBOOK* CB, PARTITIONING* P, int index);
-void CalculateWeights(TRAININGSET* TS, CODEBOOK* CB, PARTITIONING* P, double *weight);
-void CalculateNewWeights(TRAININGSET* TS, CODEBOOK* CB, PARTITIONING* P, double *tempweight);
-void PrintCentroidWeights(CODEBOOK *CB, double *weight, double *tempweight);
+void CalculateNewWeights(TRAININGSET* TS, CODEBOOK* CB, PARTITIONING* P, double *tempweight,
+    TRIALLOG *log, WORKSPACE *W);
+void PrintCentroidWeights(DENRSCONTEXT *ctx, CODEBOOK *CB, double *weight,
+    double *tempweight);
 void CheckOverflow(llong a, llong b);
-int  CheckClusterFreqs(CODEBOOK *pCB, PARTITIONING *pP);
+int  CheckClusterFreqs(DENRSCONTEXT *ctx, CODEBOOK *pCB, PARTITIONING *pP);
 void InitializeWeights(CODEBOOK *pCB, double *weight);
 void CopyWeights(double *weight, double *tempweight, int size);
 void CopyFinalWeights(double *weight, double *tempweight, int size);
@@ -111,118 +254,425 @@ int CheckIsNan(double *weight, int size);
 
 /* ========================== FUNCTIONS ============================== */
 
-/* Gets training set pTS (and optionally initial codebook pCB or 
-   partitioning pP) as a parameter, generates solution (codebook pCB + 
-   partitioning pP) and returns 0 if clustering completed successfully. 
+/* Old interface: runs a context with the given options that uses the
+   random number generator of random.c and prints to stdout.
    N.B. Random number generator (in random.c) must be initialized! */
 
 int PerformDenRS(TRAININGSET *pTS, CODEBOOK *pCB, PARTITIONING *pP, int iter, 
-int kmIter, int deterministic, int quietLevel, int useInitial, int monitoring)
+int kmIter, int deterministic, int quietLevel, int useInitial, int monitoring,
+int threads, int trials, int bounded, int indexed, RUNSTATS *metrics,
+TRAJECTORY *trajectory)
+{
+  DENRSOPTIONS  options;
+  DENRSCONTEXT *ctx;
+  int           result;
+
+  DefaultDenRSOptions(&options);
+  options.Iterations       = iter;
+  options.KMeansIterations = kmIter;
+  options.Deterministic    = deterministic;
+  options.QuietLevel       = quietLevel;
+  options.Monitoring       = monitoring;
+  options.Threads          = threads;
+  options.Trials           = trials;
+  options.Bounded          = bounded;
+  options.Indexed          = indexed;
+  options.Seed             = -1;
+
+  ctx             = CreateDenRSContext(&options);
+  ctx->Output     = PrintToStdout;
+  ctx->Metrics    = metrics;
+  ctx->Trajectory = trajectory;
+  result          = RunDenRS(ctx, pTS, pCB, pP, useInitial);
+  FreeDenRSContext(ctx);
+
+  return result;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void DefaultDenRSOptions(DENRSOPTIONS *options)
+{
+  memset(options, 0, sizeof(DENRSOPTIONS));
+  options->Iterations       = 5000;
+  options->KMeansIterations = 2;
+  options->Trials           = 1;
+  options->Threads          = 1;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+DENRSCONTEXT* CreateDenRSContext(DENRSOPTIONS *options)
+{
+  DENRSCONTEXT *ctx = (DENRSCONTEXT*) calloc(1, sizeof(DENRSCONTEXT));
+
+  if (!ctx)
+    {
+    ErrorMessage("ERROR: Allocating memory failed!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
+
+  ctx->Options = *options;
+  if (options->Seed >= 0)
+    {
+    SeedRandom(&ctx->Random, (unsigned long long) options->Seed, 0);
+    ctx->rng = &ctx->Random;
+    }
+  return ctx;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void FreeDenRSContext(DENRSCONTEXT *ctx)
+{
+  free(ctx);
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Formats a message and passes it to the output callback (if any).  */
+/*-------------------------------------------------------------------*/
+
+
+static void ContextMessage(DENRSCONTEXT *ctx, char *format, ...)
+{
+  char    text[DENRS_MESSAGE];
+  va_list args;
+
+  if (ctx == NULL || ctx->Output == NULL)  return;
+
+  va_start(args, format);
+  vsnprintf(text, DENRS_MESSAGE, format, args);
+  va_end(args);
+  ctx->Output(ctx->User, text);
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+static void PrintToStdout(void *user, char *message)
+{
+  fputs(message, stdout);
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Wall time (s) since the run of ctx started; 0 without a context.  */
+/*-------------------------------------------------------------------*/
+
+
+static double RunTime(DENRSCONTEXT *ctx)
+{
+  return (ctx != NULL) ? WallClock() - ctx->Start : 0.0;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Progress of the swap iterations. Every iteration is reported from */
+/* quiet level 3 and the improvements from level 2; the result from  */
+/* level 1.                                                          */
+/*-------------------------------------------------------------------*/
+
+
+static void ReportHeader(DENRSCONTEXT *ctx, int quietLevel)
+{
+  if (quietLevel >= 2)
+    {
+    ContextMessage(ctx, "\n%10s %16s %6s %10s\n", "Iteration", "MSE", "CI",
+                   "Time");
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+static void ReportIteration(DENRSCONTEXT *ctx, int quietLevel, int iter,
+double error, int ci, int better)
+{
+  if (quietLevel >= 3 || (quietLevel == 2 && better))
+    {
+    ContextMessage(ctx, "%10i %16.4f %6i %10.2f%s\n", iter, error, ci,
+                   RunTime(ctx), better ? " *" : "");
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+static void ReportFooter(DENRSCONTEXT *ctx, int quietLevel, int iter,
+double error)
+{
+  if (quietLevel >= 1)
+    {
+    ContextMessage(ctx, "\nIterations %i, MSE %.4f, time %.2f s\n", iter,
+                   error, RunTime(ctx));
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Gets training set pTS (and optionally initial codebook pCB or 
+   partitioning pP) as a parameter, generates solution (codebook pCB + 
+   partitioning pP) and returns 0 if clustering completed successfully. 
+   With Trials > 1, that many candidate swaps are tuned in parallel per
+   round and the best improving one is accepted; each candidate then
+   uses its own random stream derived from the trial number.
+   With Bounded, K-means assigns each vector to its nearest centroid
+   and uses distance bounds to skip most of the distance calculations.
+   With Metrics (may be NULL), a record of each iteration is written.
+   With Trajectory (may be NULL), the initial solution and the changes
+   of each accepted swap are written.
+   With Checkpoint, the state is saved every Interval iterations and,
+   with Resume, restored in place of the initial solution.
+   With TimeLimit, the run stops at that wall time: trials still being
+   tuned are discarded and the best accepted solution is returned.
+   With Solution, the best solution so far is passed on at most every
+   Period seconds (when it changed).
+   During the run the vectors of pTS and pCB are kept in contiguous
+   storage (see DENSTORE.C); pCB gets its final values on return.
+   Runs on different contexts (and data) may execute concurrently. */
+
+int RunDenRS(DENRSCONTEXT *ctx, TRAININGSET *pTS, CODEBOOK *pCB,
+PARTITIONING *pP, int useInitial)
 {
-  PARTITIONING  Pnew;
-  CODEBOOK      CBnew, CBref;
-  int           i, j, better;
+  TRIALSLOT     *slot, *new;
+  TRIALSTATS    roundstats;
+  CHECKPOINT    ckpt;
+  FILE          *resume = NULL;
+  CODEBOOK      CBref, CBprev;
+  GRIDINDEX     grid;
+  DENSESTORE    TSstore, CBstore;
+  WORKSPACE     work;
+  RUNSTATS      *metrics    = ctx->Metrics;
+  TRAJECTORY    *trajectory = ctx->Trajectory;
+  int           iter          = ctx->Options.Iterations;
+  int           kmIter        = ctx->Options.KMeansIterations;
+  int           deterministic = ctx->Options.Deterministic;
+  int           quietLevel    = ctx->Options.QuietLevel;
+  int           monitoring    = ctx->Options.Monitoring;
+  int           threads       = ctx->Options.Threads;
+  int           trials        = ctx->Options.Trials;
+  int           bounded       = ctx->Options.Bounded;
+  int           indexed       = ctx->Options.Indexed;
+  int           i, j=0, s, t, count, better, first=1;
   int           ci=0, ciPrev=0, ciZero=0, ciMax=0, PrevSuccess=0;
-  int           CIHistogram[111];
-  llong         currError, newError;
-  llong         distance[BookSize(pTS)];
-  double        weight[BookSize(pCB)], tempweight[BookSize(pCB)];
-  double        c, error;
+  int           CIHistogram[CKPT_CIBINS];
+  llong         currError, newError, prevError;
+  double        *weight;
+  double        error, deadline, emitted;
+  int           emit=NO;
   int           stop=NO, automatic=((iter==0) ? YES : NO);
-  int 			nullcluster=0;
+  unsigned long long seed=0;
   
 
-  printf("\nInitial infor: TotalFreq(pTS) = %d  VectorSize(pTS) = %d\n",TotalFreq(pTS),VectorSize(pTS));
+  ContextMessage(ctx, "\nInitial infor: TotalFreq(pTS) = %d  VectorSize(pTS) = %d\n",TotalFreq(pTS),VectorSize(pTS));
   /* Error checking for invalid parameters */ 
-  if ((iter < 0) || (kmIter < 0) || (BookSize(pTS) < BookSize(pCB)))
+  if ((iter < 0) || (kmIter < 0) || (threads < 0) || (trials < 1) ||
+      (ctx->Options.TimeLimit < 0.0) || (BookSize(pTS) < BookSize(pCB)) ||
+      (!useInitial && CountDistinct(pTS, BookSize(pCB)) < BookSize(pCB)))
     {
     return 1;  // Error: clustering failed
     }
 
+  /* the time limit covers the whole run (or the caller's whole job) */
+  deadline = DenRSDeadline(ctx);
+
+  ctx->prevImpr = DBL_MAX;
+  ctx->prevIter = 1;
+  if (threads == 0)  threads = DefaultThreads();
+
+  /* a checkpoint saves the state of the run's own stream */
+  if (ctx->Checkpoint != NULL && ctx->rng == NULL)
+    {
+    SeedRandom(&ctx->Random, RandomSeed(), 0);
+    ctx->rng = &ctx->Random;
+    }
+  AttachDenseStore(&TSstore, pTS, 0);
+  AttachDenseStore(&CBstore, pCB, 1);
+  CreateWorkspace(&work, pTS, pCB, threads, trials);
+  weight = work.weight;
   InitializeWeights(pCB, weight);
-  printf("\nUseful information: TotalFreq = %d, VectorSize = %d, TotalFreq(pTS) * VectorSize(pTS) = %d \n",TotalFreq(pTS),VectorSize(pTS),TotalFreq(pTS) * VectorSize(pTS));
+  ContextMessage(ctx, "\nUseful information: TotalFreq = %d, VectorSize = %d, TotalFreq(pTS) * VectorSize(pTS) = %d \n",TotalFreq(pTS),VectorSize(pTS),TotalFreq(pTS) * VectorSize(pTS));
   /* Progress monitor uses input codebook as reference */
   if (monitoring)
     {
-    CreateNewCodebook(&CBref, BookSize(pCB), pTS);
+    DenNewCodebook(&CBref, BookSize(pCB), pTS);
     CopyCodebook(pCB, &CBref);
     for( ci=0; ci<=100; ci++ ) CIHistogram[ci]=0;
     useInitial *= 100;  /* Special code: 0->0, 1->100, 2->200 */
     }
-  InitializeSolution(&Pnew, &CBnew, pTS, BookSize(pCB));
-  SetClock(&c);
-  currError = GenerateInitialSolution(pP, pCB, pTS, useInitial, weight);
+  ctx->Start = WallClock();
+  CheckpointHeader(&ckpt, pTS, pCB, trials, deterministic, monitoring);
+  if (ctx->Checkpoint != NULL && ctx->Resume)
+    {
+    resume = OpenCheckpoint(ctx->Checkpoint, &ckpt, pTS, pCB, pP, weight);
+    }
+  if (resume != NULL)
+    {
+    ContextMessage(ctx, "\nResuming from iteration %d\n", ckpt.Iteration);
+    currError = ckpt.Error;
+    }
+  else
+    {
+    currError = GenerateInitialSolution(pP, pCB, pTS, useInitial,
+                                        ctx->Options.Seeding, weight,
+                                        threads, ctx->rng, &work);
+    }
+  WriteInitialState(trajectory, (resume != NULL) ? ckpt.Iteration-1 : 0,
+                    pCB, pP, weight, currError);
+  emitted = WallClock();
+  if (indexed)  CreateGridIndex(&grid, pTS);
+  slot = CreateTrialSlots(pTS, pCB, pP, trials, bounded,
+                          indexed ? &grid : NULL,
+                          metrics != NULL && metrics->File != NULL, &work);
+
+  /* the deterministic swap reads the second nearest centroids that
+     OptimalPartition keeps (bounded K-means does not run it) */
+  if (deterministic && !bounded && kmIter > 0)
+    {
+    for (t = 0; t < trials; t++)
+      {
+      AttachSecond(&slot[t].log, slot[t].second, slot[t].secondDist);
+      }
+    }
+  if (monitoring)
+    {
+    /* trials modify the solution in place; keep the previous one for CI */
+    DenNewCodebook(&CBprev, BookSize(pCB), pTS);
+    CopyCodebook(pCB, &CBprev);
+    }
   error = CALC_MSE(currError);
-  printf("\nTotal MSE: %lld",currError);
-  printf("\n================Initialization Ends========================\n");
+  ContextMessage(ctx, "\nTotal MSE: %lld",currError);
+  ContextMessage(ctx, "\n================Initialization Ends========================\n");
   if(useInitial) ciPrev = CentroidIndex(&CBref, pCB);
   else           ciPrev = 100;
   
   /* use automatic iteration count */
   if (automatic)  iter = AUTOMATIC_MAX_ITER;
 
-  PrintHeader(quietLevel);
-  PrintIterationRS(quietLevel, 0, error, 0, GetClock(c), 1);
+  /* parallel trials draw from streams seeded by the run's generator */
+  if (trials > 1 && ctx->rng != NULL)
+    {
+    seed = NextRandom(ctx->rng);
+    }
+  else if (trials > 1)
+    {
+    seed = RandomSeed();
+    }
+
+  /* the saved streams, target and stop state continue the run */
+  if (resume != NULL)
+    {
+    ResumeTrialSlots(resume, ctx, &ckpt, slot, &work);
+    seed  = ckpt.Seed;
+    j     = ckpt.Target;
+    first = ckpt.Iteration;
+    }
+  if (resume != NULL && monitoring)
+    {
+    ciPrev      = ckpt.CIPrev;
+    ciZero      = ckpt.CIZero;
+    ciMax       = ckpt.CIMax;
+    PrevSuccess = ckpt.PrevSuccess;
+    memcpy(CIHistogram, ckpt.CIHistogram, sizeof(CIHistogram));
+    }
+
+  ReportHeader(ctx, quietLevel);
+  ReportIteration(ctx, quietLevel, 0, error, 0, 1);
 
-  printf("Initial Centroids and weights");
-  PrintCentroidWeights(pCB, weight, tempweight);
+  ContextMessage(ctx, "Initial Centroids and weights");
+  PrintCentroidWeights(ctx, pCB, weight, slot[0].weight);
 
   /* Deterministic variant initialization */
-  if (deterministic)
+  if (deterministic && resume == NULL)
     {
-    CalculateDistances(pTS, pCB, pP, distance, weight);
-    j = SelectClusterToBeSwapped(pTS, pCB, pP, distance);
+    CalculateDistances(pTS, pCB, pP, slot[0].distance, weight, threads);
+    j = SelectClusterToBeSwapped(pTS, pCB, pP, slot[0].distance, weight,
+                                 NULL, &work);
     }
   
   /* - - - - -  Random Swap iterations - - - - - */
 
-  for (i=1; (i<=iter) && (!stop); i++)
+  for (i=first; (i<=iter) && (!stop); i+=count)
     {
-    better = NO;
+    better    = NO;
+    count     = min(trials, iter - i + 1);
+    prevError = currError;
+
+    /* generate and tune new solutions (trials i..i+count-1) */
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) num_threads(min(threads, count)) if (count > 1)
+#endif
+    for (s = 0; s < count; s++)
+      {
+      RANDOMSTATE rng;
 
-    /* generate new solution */
-	CopyWeights(weight, tempweight, BookSize(pCB));
-	
-    CopyCodebook(pCB, &CBnew);
-    CopyPartitioning(pP, &Pnew);
-    
-    RandomSwap(&CBnew, pTS, &j, deterministic, quietLevel);
-    /*printf("*******ONE MORE*******");
-    PrintCentroidWeights(&CBnew, weight, tempweight);
-    printf("**********************");*/
-    /* tuning new solution */
-    LocalRepartition(&Pnew, &CBnew, pTS, tempweight, j, c, quietLevel);
-    
-	
-    KMeans(&Pnew, &CBnew, pTS, distance, weight, kmIter, quietLevel, c, tempweight, currError);
-	CalculateNewWeights(pTS, &CBnew, &Pnew, tempweight);
-	
-	printf("\nRS Iteration number: %d\n",i);
-    newError = ObjectiveFunction(&Pnew, &CBnew, pTS, tempweight);
-	printf("\nNew SSE: %lld",newError);
-	printf("\nOld SSE: %lld",currError);
+      slot[s].j = j;
+      if (trials > 1)
+        {
+        SeedRandom(&rng, seed, i + s);
+        RunTrial(ctx, pTS, weight, &slot[s], &rng, deterministic, kmIter,
+                 0, currError, 1, deadline);
+        }
+      else
+        {
+        RunTrial(ctx, pTS, weight, &slot[s], ctx->rng, deterministic, kmIter,
+                 quietLevel, currError, threads, deadline);
+        }
+      }
+
+    /* best valid candidate; ties go to the earliest trial */
+    s = 0;
+    for (t = 1; t < count; t++)
+      {
+      if (slot[t].valid && (!slot[s].valid || slot[t].error < slot[s].error))
+        {
+        s = t;
+        }
+      }
+    new = &slot[s];
+    if (!deterministic)  j = new->j;
+
+    if (new->stats != NULL)
+      {
+      ResetTrialStats(&roundstats);
+      for (t = 0; t < count; t++)  AddTrialStats(&roundstats, slot[t].stats);
+      }
+
+	ContextMessage(ctx, "\nRS Iteration number: %d\n",i+s);
+    newError = new->error;
+	ContextMessage(ctx, "\nNew SSE: %lld",newError);
+	ContextMessage(ctx, "\nOld SSE: %lld",currError);
     error    = CALC_MSE(newError);
-    nullcluster = CheckClusterFreqs(&CBnew, &Pnew);
 	
     /* Found better solution */
-    if (newError < currError && !nullcluster && !CheckIsNan(tempweight,BookSize(pCB)))
+    if (newError < currError && new->valid)
       {
       /* Monitoring outputs CI-value: relative to Prev or Reference */
       if(monitoring)  
          {
-         if(useInitial) ci = CentroidIndex(&CBnew, &CBref);
-         else           ci = CentroidIndex(&CBnew, pCB);
+         if(useInitial) ci = CentroidIndex(new->CB, &CBref);
+         else           ci = CentroidIndex(new->CB, &CBprev);
          /* CI decreases: update Success histogram */
          if( (ci>=0) && (ci<ciPrev) && (ci<100) )
            {
            /* printf("XXXX Prev=%d  Curr=%d  CI=%d  CIPrev=%i  Iter=%d \n", PrevSuccess, i, ci, ciPrev, (i-PrevSuccess)); */
-           CIHistogram[ci] += (i-PrevSuccess);
+           CIHistogram[ci] += (i+s-PrevSuccess);
            if(ci>ciMax)  ciMax = ci;
-           if(ci==0)     ciZero = i;
-           PrevSuccess = i;
+           if(ci==0)     ciZero = i+s;
+           PrevSuccess = i+s;
            }
          /* CI increases: report warning message */
-         if( (ci>ciPrev) && (quietLevel) ) printf("!!! CI increased %i to %i at iteration %d\n", ciPrev, ci, i);
+         if( (ci>ciPrev) && (quietLevel) ) ContextMessage(ctx, "!!! CI increased %i to %i at iteration %d\n", ciPrev, ci, i+s);
          /* Remember to update CI value */
          ciPrev = ci;
          /* If monitoring, then stop criterion is CI=0 */
@@ -232,36 +682,53 @@ int kmIter, int deterministic, int quietLevel, int useInitial, int monitoring)
       /* Check stopping criterion */
       else if(automatic)
         {
-        stop = StopCondition(currError, newError, i);
+        stop = StopCondition(ctx, currError, newError, i+s);
         }
 
       
-      CopyCodebook(&CBnew, pCB);
-      CopyPartitioning(&Pnew, pP);
-      
-      currError = newError;
-      better = YES;
-
-      //CalculateWeights(pTS, &CBnew, &Pnew, weight);
-	  CopyFinalWeights(weight, tempweight, BookSize(pTS));
+	  CopyFinalWeights(weight, new->weight, BookSize(pCB));
+      /* the second nearest centroids it finds are replayed below */
       if (deterministic) /* Alterantive ro Random. But why here?  */
         {
-        j = SelectClusterToBeSwapped(pTS, pCB, pP, distance);
+        j = SelectClusterToBeSwapped(pTS, new->CB, new->P, new->distance,
+                                     weight, &new->log, new->work);
         }
+
+      /* keep the new solution: the other trials are undone and the
+         changes of the accepted one are replayed on their copies */
+      for (t = 0; t < trials; t++)
+        {
+        if (t == s)  continue;
+        if (t < count)  RollbackTrial(&slot[t].log, pTS, slot[t].CB, slot[t].P);
+        ReplayTrial(&new->log, pTS, new->CB, new->P, &slot[t].log,
+                    slot[t].CB, slot[t].P);
+        }
+      if (new->CB != pCB)
+        {
+        ReplayTrial(&new->log, pTS, new->CB, new->P, NULL, pCB, pP);
+        }
+      if (monitoring)  CopyCodebook(pCB, &CBprev);
+      
+      currError = newError;
+      better = YES;
+      emit   = YES;
 		
-	  //Code to generate partition files after every accepted iteration
-	  printf("Accepted Centroids for iteration %d\n",i);
-	  PrintCentroidWeights(&CBnew, weight, tempweight);
-	  printf("New error: %lld\n",newError);
-	  /*char OutPAName[20] = "Acceptedtemp_pa\0";
-	  char filenumber[10];
-	  sprintf(filenumber, "%d", i);
-	  strcat(OutPAName, filenumber);
-	  WritePartitioning(OutPAName, &Pnew, pTS, 0);*/
+	  ContextMessage(ctx, "Accepted Centroids for iteration %d\n",i+s);
+	  PrintCentroidWeights(ctx, new->CB, weight, new->weight);
+	  ContextMessage(ctx, "New error: %lld\n",newError);
+      /* partitions of the accepted iterations: see CBDENTRAJ */
+      WriteAcceptedSwap(trajectory, i+s, new->j, &new->log, new->CB,
+                        new->P, weight, newError);
 		
       }
+    else
+      {
+      for (t = 0; t < count; t++)
+        {
+        RollbackTrial(&slot[t].log, pTS, slot[t].CB, slot[t].P);
+        }
+      }
 	
-    nullcluster = 0;
     /*printf("Centroids for iteration %d\n",i);
     PrintCentroidWeights(&CBnew, weight, tempweight);*/
 	/*Printing distance array*/
@@ -277,25 +744,79 @@ int kmIter, int deterministic, int quietLevel, int useInitial, int monitoring)
     strcat(OutPAName, filenumber);
     WritePartitioning(OutPAName, &Pnew, pTS, 0);*/
 
-    PrintIterationRS(quietLevel, i, error, ci, GetClock(c), better);
-	printf("\n================RS Iteration %d Ends========================\n",i);
+    if (new->stats != NULL)
+      {
+      WriteIterationStats(metrics, i, count, better ? i+s : 0, prevError,
+                          newError, &roundstats);
+      }
+
+    ReportIteration(ctx, quietLevel, i+count-1, error, ci, better);
+
+    /* the trials cut short were rolled back with the others */
+    if (TimeOver(deadline))
+      {
+      ContextMessage(ctx, "\nTime limit reached at iteration %d\n",
+                     i+count-1);
+      stop = YES;
+      }
+
+    if (ctx->Solution != NULL && emit && !stop &&
+        WallClock() - emitted >= ctx->Period)
+      {
+      ctx->Solution(ctx->User, pCB, pP, weight, currError, i+count-1);
+      emitted = WallClock();
+      emit    = NO;
+      }
+
+    /* at the end of a round, so the trials are not split */
+    if (ctx->Checkpoint != NULL && ctx->Interval > 0 && !stop &&
+        (i+count-1) / ctx->Interval > (i-1) / ctx->Interval)
+      {
+      ckpt.Iteration = i+count;
+      ckpt.Target    = j;
+      ckpt.Error     = currError;
+      ckpt.Seed      = seed;
+      if (monitoring)
+        {
+        ckpt.CIPrev      = ciPrev;
+        ckpt.CIZero      = ciZero;
+        ckpt.CIMax       = ciMax;
+        ckpt.PrevSuccess = PrevSuccess;
+        memcpy(ckpt.CIHistogram, CIHistogram, sizeof(CIHistogram));
+        }
+      SaveCheckpoint(ctx, &ckpt, pCB, pP, weight, slot, &work);
+      }
+	ContextMessage(ctx, "\n================RS Iteration %d Ends========================\n",i+count-1);
     }
 
   /* - - - - -  Random Swap iterations - - - - - */
   error = CALC_MSE(currError);  
-  PrintFooterRS(quietLevel, i-1, error, GetClock(c));
+  ReportFooter(ctx, quietLevel, i-1, error);
 
   if(monitoring && quietLevel)  
      {
-     PrintMessage("Total: %-7d   Swaps: ", ciZero);
+     ContextMessage(ctx, "Total: %-7d   Swaps: ", ciZero);
      for( ci=0; ci<=ciMax; ci++ )
        {
-       PrintMessage("%3d  ", CIHistogram[ci]);
+       ContextMessage(ctx, "%3d  ", CIHistogram[ci]);
        }
-     PrintMessage("\n", ciZero);
+     ContextMessage(ctx, "\n");
      }
 
-  FreeSolution(&Pnew, &CBnew);
+  if (monitoring)
+    {
+    DenFreeCodebook(&CBprev);
+    DenFreeCodebook(&CBref);
+    }
+  ctx->Error      = currError;
+  ctx->Iterations = i-1;
+  if (ctx->Weights != NULL)  CopyWeights(weight, ctx->Weights, BookSize(pCB));
+
+  FreeTrialSlots(slot, trials);
+  FreeWorkspace(&work);
+  if (indexed)  FreeGridIndex(&grid);
+  DetachDenseStore(&CBstore, pCB);
+  DetachDenseStore(&TSstore, pTS);
   return 0;
 }  
 
@@ -303,11 +824,493 @@ int kmIter, int deterministic, int quietLevel, int useInitial, int monitoring)
 /*-------------------------------------------------------------------*/
 
 
+double DenRSDeadline(DENRSCONTEXT *ctx)
+{
+  if (ctx->Deadline > 0.0)  return ctx->Deadline;
+  if (ctx->Options.TimeLimit > 0.0)
+    {
+    return WallClock() + ctx->Options.TimeLimit;
+    }
+  return 0.0;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Runs repeats independent solutions and returns the best one in    */
+/* pCB, pP, ctx->Weights and ctx->Error. Repeat r uses the seed      */
+/* Options.Seed + r (a random base when Seed < 0), so repeat 0 gives  */
+/* the same solution as RunDenRS with the same options. The repeats  */
+/* share pTS read-only and run in parallel on Options.Threads; with  */
+/* fewer repeats than threads, each repeat runs its own parallel     */
+/* regions on its share of them. Ties go to the lowest repeat,       */
+/* so the result does not depend on the thread count. TimeLimit is   */
+/* the time of all repeats: they share one deadline, and a repeat    */
+/* that would start after it is skipped. errors (may be NULL)        */
+/* receives the MSE of each repeat, -1 if it failed or was skipped.  */
+/* Metrics and trajectory are not written. Returns 0 if a repeat     */
+/* succeeded.                                                        */
+/*-------------------------------------------------------------------*/
+
+
+int RunDenRSRepeats(DENRSCONTEXT *ctx, TRAININGSET *pTS, CODEBOOK *pCB,
+PARTITIONING *pP, int useInitial, int repeats, double *errors,
+REPEATSTATS *stats)
+{
+  DENSESTORE    TSstore;
+  double        *mse, *bestWeight, error, deadline, sum=0.0, sumSq=0.0;
+  llong         seed, bestError=MAXLLONG;
+  int           threads = ctx->Options.Threads;
+  int           outer, inner, levels, r, best=-1, done=0, bestIter=0;
+
+  memset(stats, 0, sizeof(REPEATSTATS));
+  stats->Repeats = repeats;
+  stats->Best    = -1;
+  if ((repeats < 1) || (threads < 0) || (BookSize(pTS) < BookSize(pCB)))
+    {
+    return 1;
+    }
+
+  if (threads == 0)  threads = DefaultThreads();
+  deadline = DenRSDeadline(ctx);
+  seed     = ctx->Options.Seed;
+  if (seed < 0)
+    {
+    seed = RandomSeed();
+    }
+
+  mse        = (double*) malloc(repeats * sizeof(double));
+  bestWeight = (double*) malloc(BookSize(pCB) * sizeof(double));
+  if (!mse || !bestWeight)
+    {
+    ErrorMessage("ERROR: Allocating memory failed!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
+
+  /* attached once, so the runs use the store in place */
+  AttachDenseStore(&TSstore, pTS, 0);
+  levels = BeginNesting(threads, repeats, &outer, &inner);
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1) num_threads(outer) if (outer > 1)
+#endif
+  for (r = 0; r < repeats; r++)
+    {
+    DENRSOPTIONS  options = ctx->Options;
+    DENRSCONTEXT *run;
+    CODEBOOK      CB;
+    PARTITIONING  P;
+    double       *weight;
+    int           result;
+
+    options.Seed       = seed + r;
+    options.Threads    = inner;
+    options.QuietLevel = 0;
+    options.Monitoring = 0;
+    run = CreateDenRSContext(&options);
+    run->Deadline = deadline;
+
+    InitializeSolution(&P, &CB, pTS, BookSize(pCB));
+    if (useInitial)
+      {
+      CopyCodebook(pCB, &CB);
+      CopyPartitioning(pP, &P);
+      }
+    weight = (double*) malloc(BookSize(pCB) * sizeof(double));
+    if (!weight)
+      {
+      ErrorMessage("ERROR: Allocating memory failed!\n");
+      ExitProcessing(FATAL_ERROR);
+      }
+    run->Weights = weight;
+
+    result = 1;
+    if (!TimeOver(deadline))
+      {
+      result = RunDenRS(run, pTS, &CB, &P, useInitial);
+      }
+    mse[r] = result ? -1.0 : CALC_MSE(run->Error);
+
+#ifdef _OPENMP
+#pragma omp critical (DenRSRepeats)
+#endif
+      {
+      if (!result && (best < 0 || run->Error < bestError ||
+                      (run->Error == bestError && r < best)))
+        {
+        best      = r;
+        bestError = run->Error;
+        bestIter  = run->Iterations;
+        CopyCodebook(&CB, pCB);
+        CopyPartitioning(&P, pP);
+        CopyWeights(weight, bestWeight, BookSize(pCB));
+        }
+      }
+    FreeSolution(&P, &CB);
+    free(weight);
+    FreeDenRSContext(run);
+    }
+
+  EndNesting(levels);
+  DetachDenseStore(&TSstore, pTS);
+
+  /* spread of the final errors */
+  for (r = 0; r < repeats; r++)
+    {
+    if (errors != NULL)  errors[r] = mse[r];
+    if (mse[r] < 0)  continue;
+    if (done == 0 || mse[r] < stats->MinError)  stats->MinError = mse[r];
+    if (done == 0 || mse[r] > stats->MaxError)  stats->MaxError = mse[r];
+    sum   += mse[r];
+    sumSq += mse[r] * mse[r];
+    done++;
+    }
+  stats->Succeeded = done;
+  if (best >= 0)
+    {
+    error            = sum / done;
+    stats->Best      = best;
+    stats->Seed      = seed + best;
+    stats->MeanError = error;
+    stats->StdError  = sqrt(max(0.0, sumSq / done - error * error));
+    ctx->Error       = bestError;
+    ctx->Iterations  = bestIter;
+    if (ctx->Weights != NULL)
+      {
+      CopyWeights(bestWeight, ctx->Weights, BookSize(pCB));
+      }
+    }
+
+  free(bestWeight);
+  free(mse);
+  return (best < 0);
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Generates one candidate solution in slot S: swaps a centroid of    */
+/* the slot's solution (weights from weight) and tunes it by local    */
+/* repartition and K-means. The changes are logged in S->log, so the  */
+/* caller must either keep them or roll them back. rng == NULL uses   */
+/* the global generator. A trial that reaches the deadline (WallClock */
+/* time, 0 = none) before it is tuned is left invalid and expired.    */
+/*-------------------------------------------------------------------*/
+
+
+void RunTrial(DENRSCONTEXT *ctx, TRAININGSET *pTS, double *weight,
+TRIALSLOT *S, RANDOMSTATE *rng, int deterministic, int kmIter,
+int quietLevel, llong currError, int threads, double deadline)
+{
+  /* generate new solution */
+  BeginTrial(&S->log);
+  ResetTrialStats(S->stats);
+  S->valid   = NO;
+  S->expired = TimeOver(deadline);
+  if (S->expired)  return;
+
+  BeginPhase(S->stats, &S->log, STATS_SWAP);
+  CopyWeights(weight, S->weight, BookSize(S->CB));
+
+  RandomSwap(ctx, S->CB, pTS, &S->j, deterministic, quietLevel, rng,
+             &S->log, &S->hash);
+
+  /* tuning new solution */
+  BeginPhase(S->stats, &S->log, STATS_REPARTITION);
+  LocalRepartition(ctx, S->P, S->CB, pTS, S->weight, S->j, quietLevel,
+                   &S->log, S->grid, S->candidate, S->work);
+  BeginPhase(S->stats, &S->log, STATS_KMEANS);
+  if (KMeans(ctx, S->P, S->CB, pTS, S->distance, weight, kmIter, quietLevel,
+             S->weight, currError, threads, &S->log, S->bounds, S->stats,
+             S->work, deadline) < kmIter)
+    {
+    S->expired = YES;
+    EndPhase(S->stats, &S->log);
+    return;
+    }
+  BeginPhase(S->stats, &S->log, STATS_WEIGHTS);
+  CalculateNewWeights(pTS, S->CB, S->P, S->weight, &S->log, S->work);
+
+  /* bounded K-means does not keep the distances up to date */
+  if (deterministic && S->bounds != NULL)
+    {
+    CalculateDistances(pTS, S->CB, S->P, S->distance, S->weight, threads);
+    CountDistances(&S->log, BookSize(pTS));
+    }
+
+  BeginPhase(S->stats, &S->log, STATS_OBJECTIVE);
+  S->error = TrialObjective(&S->log, S->CB, S->weight);
+  S->valid = !CheckClusterFreqs(ctx, S->CB, S->P) && 
+             !CheckIsNan(S->weight, BookSize(S->CB));
+  EndPhase(S->stats, &S->log);
+}
+
+
+/*-------------------------------------------------------------------*/
+/* A single slot works on pCB, pP directly and uses the workspace    */
+/* work. With several slots, each gets a copy of the current         */
+/* solution and a workspace of its own (each runs on one thread).    */
+/*-------------------------------------------------------------------*/
+
+
+TRIALSLOT* CreateTrialSlots(TRAININGSET *pTS, CODEBOOK *pCB,
+PARTITIONING *pP, int count, int bounded, GRIDINDEX *grid, int stats,
+WORKSPACE *work)
+{
+  TRIALSLOT *slot = (TRIALSLOT*) calloc(count, sizeof(TRIALSLOT));
+  int        s, j, clus = BookSize(pCB);
+
+  if (!slot)
+    {
+    ErrorMessage("ERROR: Allocating memory failed!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
+
+  for (s = 0; s < count; s++)
+    {
+    if (count == 1)
+      {
+      slot[s].CB   = pCB;
+      slot[s].P    = pP;
+      slot[s].work = work;
+      }
+    else
+      {
+      InitializeSolution(&slot[s].Pown, &slot[s].CBown, pTS, clus);
+      CopyCodebook(pCB, &slot[s].CBown);
+      CopyPartitioning(pP, &slot[s].Pown);
+      AttachDenseStore(&slot[s].store, &slot[s].CBown, 0);
+      CreateWorkspace(&slot[s].workOwn, pTS, &slot[s].CBown, 1, 1);
+      slot[s].CB   = &slot[s].CBown;
+      slot[s].P    = &slot[s].Pown;
+      slot[s].work = &slot[s].workOwn;
+      }
+    CreateTrialLog(&slot[s].log, pTS, pCB);
+    InitClusterSums(&slot[s].log, pTS, slot[s].CB, pP);
+    CreateVectorHash(&slot[s].hash, slot[s].CB, clus);
+    for (j = 0; j < clus; j++)  AddVector(&slot[s].hash, j);
+    slot[s].weight   = (double*) calloc(clus, sizeof(double));
+    slot[s].distance = (llong*) calloc(BookSize(pTS), sizeof(llong));
+    slot[s].second   = (int*) malloc(BookSize(pTS) * sizeof(int));
+    slot[s].secondDist = (llong*) calloc(BookSize(pTS), sizeof(llong));
+    if (!slot[s].weight || !slot[s].distance || !slot[s].second ||
+        !slot[s].secondDist)
+      {
+      ErrorMessage("ERROR: Allocating memory failed!\n");
+      ExitProcessing(FATAL_ERROR);
+      }
+    /* not known yet */
+    memset(slot[s].second, 0xff, BookSize(pTS) * sizeof(int));
+    if (bounded)
+      {
+      slot[s].bounds = (BOUNDS*) malloc(sizeof(BOUNDS));
+      if (!slot[s].bounds)
+        {
+        ErrorMessage("ERROR: Allocating memory failed!\n");
+        ExitProcessing(FATAL_ERROR);
+        }
+      CreateBounds(slot[s].bounds, pTS, pCB);
+      }
+    if (grid != NULL)
+      {
+      slot[s].grid      = grid;
+      slot[s].candidate = (int*) malloc(BookSize(pTS) * sizeof(int));
+      if (!slot[s].candidate)
+        {
+        ErrorMessage("ERROR: Allocating memory failed!\n");
+        ExitProcessing(FATAL_ERROR);
+        }
+      }
+    if (stats)
+      {
+      slot[s].stats = (TRIALSTATS*) calloc(1, sizeof(TRIALSTATS));
+      if (!slot[s].stats)
+        {
+        ErrorMessage("ERROR: Allocating memory failed!\n");
+        ExitProcessing(FATAL_ERROR);
+        }
+      }
+    }
+  return slot;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void FreeTrialSlots(TRIALSLOT *slot, int count)
+{
+  int s;
+
+  for (s = 0; s < count; s++)
+    {
+    if (count > 1)
+      {
+      FreeWorkspace(&slot[s].workOwn);
+      DetachDenseStore(&slot[s].store, &slot[s].CBown);
+      FreeSolution(&slot[s].Pown, &slot[s].CBown);
+      }
+    FreeTrialLog(&slot[s].log);
+    FreeVectorHash(&slot[s].hash);
+    free(slot[s].weight);
+    free(slot[s].distance);
+    free(slot[s].second);
+    free(slot[s].secondDist);
+    if (slot[s].bounds != NULL)
+      {
+      FreeBounds(slot[s].bounds);
+      free(slot[s].bounds);
+      }
+    free(slot[s].candidate);
+    free(slot[s].stats);
+    }
+  free(slot);
+}
+
+
+/*-------------------------------------------------------------------*/
+/* YES if the deadline (WallClock time, 0 = none) has passed.        */
+/*-------------------------------------------------------------------*/
+
+
+static YESNO TimeOver(double deadline)
+{
+  return (deadline > 0.0 && WallClock() >= deadline) ? YES : NO;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Sizes and options a checkpoint of the run must match.             */
+/*-------------------------------------------------------------------*/
+
+
+static void CheckpointHeader(CHECKPOINT *C, TRAININGSET *pTS,
+CODEBOOK *pCB, int trials, int deterministic, int monitoring)
+{
+  memset(C, 0, sizeof(CHECKPOINT));
+  C->N             = BookSize(pTS);
+  C->Size          = BookSize(pCB);
+  C->Dim           = VectorSize(pTS);
+  C->Trials        = trials;
+  C->Deterministic = (deterministic != 0);
+  C->Monitoring    = (monitoring != 0);
+}
+
+
+/*-------------------------------------------------------------------*/
+/* The caller sets the iteration, target, error, trial seed and the  */
+/* monitor state of C. The second nearest centroids of every slot    */
+/* are saved, since the deterministic swap reads them from the slot  */
+/* it accepts.                                                       */
+/*-------------------------------------------------------------------*/
+
+
+static void SaveCheckpoint(DENRSCONTEXT *ctx, CHECKPOINT *C,
+CODEBOOK *pCB, PARTITIONING *pP, double *weight, TRIALSLOT *slot,
+WORKSPACE *W)
+{
+  SlotArrays(C, slot, W);
+  C->Random   = ctx->Random.state;
+  C->PrevImpr = ctx->prevImpr;
+  C->PrevIter = ctx->prevIter;
+  WriteCheckpoint(ctx->Checkpoint, C, pCB, pP, weight, W->slotSecond,
+                  W->slotSecondDist);
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Rest of the checkpoint opened in RunDenRS: the slots' second      */
+/* nearest centroids and the state of the random stream and of the   */
+/* automatic stop.                                                   */
+/*-------------------------------------------------------------------*/
+
+
+static void ResumeTrialSlots(FILE *f, DENRSCONTEXT *ctx, CHECKPOINT *C,
+TRIALSLOT *slot, WORKSPACE *W)
+{
+  SlotArrays(C, slot, W);
+  CloseCheckpoint(f, ctx->Checkpoint, C, W->slotSecond, W->slotSecondDist);
+
+  ctx->Random.state = C->Random;
+  ctx->prevImpr     = C->PrevImpr;
+  ctx->prevIter     = C->PrevIter;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* The slots' arrays are listed in the workspace of the run (sized   */
+/* for its trials), so a checkpoint does not allocate.               */
+/*-------------------------------------------------------------------*/
+
+
+static void SlotArrays(CHECKPOINT *C, TRIALSLOT *slot, WORKSPACE *W)
+{
+  int t;
+
+  for (t = 0; t < C->Trials; t++)
+    {
+    W->slotSecond[t]     = slot[t].second;
+    W->slotSecondDist[t] = slot[t].secondDist;
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Private random streams (splitmix64). A stream seeded with the same */
+/* seed and trial number always gives the same sequence.             */
+/*-------------------------------------------------------------------*/
+
+
+void SeedRandom(RANDOMSTATE *rng, unsigned long long seed, int trial)
+{
+  rng->state = seed ^ ((unsigned long long) trial * 0x9E3779B97F4A7C15ULL);
+  NextRandom(rng);
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+unsigned long long NextRandom(RANDOMSTATE *rng)
+{
+  unsigned long long z = (rng->state += 0x9E3779B97F4A7C15ULL);
+
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Random integer 0..n-1 from rng, or from random.c if rng is NULL.  */
+/*-------------------------------------------------------------------*/
+
+
+int RandomIndex(RANDOMSTATE *rng, int n)
+{
+  if (rng == NULL)  return IRZ(n);
+  return (int) (NextRandom(rng) % (unsigned long long) n);
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Random number in [0,1) from rng, or from random.c if rng is NULL. */
+/*-------------------------------------------------------------------*/
+
+
+double RandomUniform(RANDOMSTATE *rng)
+{
+  if (rng == NULL)  return (IRZ(32768) * 32768.0 + IRZ(32768)) / 1073741824.0;
+  return (NextRandom(rng) >> 11) / 9007199254740992.0;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
 void InitializeSolution(PARTITIONING *pP, CODEBOOK *pCB, TRAININGSET *pTS, 
 int clus)
 {
-  CreateNewCodebook(pCB, clus, pTS);
-  CreateNewPartitioning(pP, pTS, clus);
+  DenNewCodebook(pCB, clus, pTS);
+  DenNewPartitioning(pP, pTS, clus);
 } 
 
 
@@ -331,25 +1334,25 @@ int CheckIsNan(double *weight, int size)
 
 void FreeSolution(PARTITIONING *pP, CODEBOOK *pCB)
 {
-  FreeCodebook(pCB);
-  FreePartitioning(pP);
+  DenFreeCodebook(pCB);
+  DenFreePartitioning(pP);
 } 
 
 
 /*-------------------------------------------------------------------*/
 
             
-YESNO  StopCondition(double currError, double newError, int iter)
+YESNO  StopCondition(DENRSCONTEXT *ctx, double currError, double newError,
+int iter)
 {
-  static double   currImpr=DBL_MAX, prevImpr=DBL_MAX;
-  static int      prevIter=1;
+  double currImpr;
 
   currImpr  = (double)(currError - newError) / (double)currError;
-  currImpr /= (double) (iter - prevIter);
-  if (AUTOMATIC_MIN_SPEED < currImpr + prevImpr)
+  currImpr /= (double) (iter - ctx->prevIter);
+  if (AUTOMATIC_MIN_SPEED < currImpr + ctx->prevImpr)
      {
-     prevImpr = currImpr;
-     prevIter = iter;
+     ctx->prevImpr = currImpr;
+     ctx->prevIter = iter;
      return(NO);
      }
   else  /* too slow speed, better to stop.. */
@@ -363,11 +1366,13 @@ YESNO  StopCondition(double currError, double newError, int iter)
 
 
 llong GenerateInitialSolution(PARTITIONING *pP, CODEBOOK *pCB, 
-TRAININGSET *pTS, int useInitial, double *weight)
+TRAININGSET *pTS, int useInitial, int seeding, double *weight, int threads,
+RANDOMSTATE *rng, WORKSPACE *W)
 {
   if (useInitial == 1)
   {
-    GenerateOptimalPartitioningWithWeight(pTS, pCB, pP, MSE, weight);
+    GenerateOptimalPartitioningWithWeight(pTS, pCB, pP, MSE, weight, threads,
+                                          W);
   } 
   else if (useInitial == 2) 
   {
@@ -375,11 +1380,18 @@ TRAININGSET *pTS, int useInitial, double *weight)
   } 
   else
   {
-    SelectRandomRepresentatives(pTS, pCB);
-    GenerateOptimalPartitioningWithWeight(pTS, pCB, pP, MSE, weight);
+    if (seeding == SEED_RANDOM)
+      SelectRandomRepresentatives(pTS, pCB, rng);
+    else
+      SeedPlusPlus(pTS, pCB, seeding == SEED_DENSITY, rng, threads);
+    GenerateOptimalPartitioningWithWeight(pTS, pCB, pP, MSE, weight, threads,
+                                          W);
+    /* a seeded start is compared with the swaps by its own densities */
+    if (seeding != SEED_RANDOM)
+      CalculateNewWeights(pTS, pCB, pP, weight, NULL, W);
   }
   
-  return ObjectiveFunction(pP, pCB, pTS, weight);
+  return ObjectiveFunction(pP, pCB, pTS, weight, W);
 }
 
 
@@ -388,25 +1400,27 @@ TRAININGSET *pTS, int useInitial, double *weight)
 /*-------------------------------------------------------------------*/
 
 
-void SelectRandomRepresentatives(TRAININGSET *pTS, CODEBOOK *pCB)
+void SelectRandomRepresentatives(TRAININGSET *pTS, CODEBOOK *pCB,
+RANDOMSTATE *rng)
 {
-  
-  int k, n, x, Unique;
+  VECTORHASH H;
+  int k, x;
 
+  /* duplicates are found by hashing instead of comparing to all */
+  CreateVectorHash(&H, pCB, BookSize(pCB));
   for (k = 0; k < BookSize(pCB); k++) 
     {
     do 
       {
-      Unique = 1;
-      x = irand(0, BookSize(pTS) - 1);
-      for (n = 0; (n < k) && Unique; n++) 
-         Unique = !EqualVectors(Vector(pTS, x), Vector(pCB, n), VectorSize(pCB));
+      x = RandomIndex(rng, BookSize(pTS));
       } 
-    while (!Unique);
+    while (FindVector(&H, Vector(pTS, x)) >= 0);
 
     CopyVector(Vector(pTS, x), Vector(pCB, k), VectorSize(pCB));
     VectorFreq(pCB, k) = 0;
+    AddVector(&H, k);
     }
+  FreeVectorHash(&H);
 
 }
 
@@ -433,27 +1447,21 @@ void RandomCodebook(TRAININGSET *pTS, CODEBOOK *pCB)
 /*-------------------------------------------------------------------*/
 
 
-int SelectRandomDataObject(CODEBOOK *pCB, TRAININGSET *pTS)
+int SelectRandomDataObject(CODEBOOK *pCB, TRAININGSET *pTS, RANDOMSTATE *rng,
+VECTORHASH *H)
 {
-  int i, j, count = 0;
+  int j, count = 0;
   int ok;
 
   do 
     {
     count++;
-
-    /* random number generator must be initialized! */
-    j = IRZ(BookSize(pTS));
-
-    /* eliminate duplicates */
-    ok = 1;
-    for (i = 0; i < BookSize(pCB); i++) 
-      {
-      if (EqualVectors(Vector(pCB, i), Vector(pTS, j), VectorSize(pTS)))
-        {
-        ok = 0;
-        }
-      }
+
+    /* random number generator must be initialized! */
+    j = RandomIndex(rng, BookSize(pTS));
+
+    /* eliminate duplicates (H holds the centroids of pCB) */
+    ok = (FindVector(H, Vector(pTS, j)) < 0);
   } 
   while (!ok && (count <= BookSize(pTS)));   /* fixed 25.01.2005 */
 
@@ -465,20 +1473,30 @@ int SelectRandomDataObject(CODEBOOK *pCB, TRAININGSET *pTS)
 /* random number generator must be initialized! */
 
 
-void RandomSwap(CODEBOOK *pCB, TRAININGSET *pTS, int *j, int deterministic, 
-                int quietLevel)
+void RandomSwap(DENRSCONTEXT *ctx, CODEBOOK *pCB, TRAININGSET *pTS, int *j,
+                int deterministic, int quietLevel, RANDOMSTATE *rng,
+                TRIALLOG *log, VECTORHASH *H)
 {
-  int i;
+  int i, n, *moved;
 
   if (!deterministic)
     {
-    *j = IRZ(BookSize(pCB));
+    *j = RandomIndex(rng, BookSize(pCB));
     }
 
-  i = SelectRandomDataObject(pCB, pTS);
+  /* the hash follows the centroids moved since the previous swap */
+  moved = ChangedCentroids(log, &n);
+  while (n-- > 0)  UpdateVector(H, moved[n]);
 
+  i = SelectRandomDataObject(pCB, pTS, rng, H);
+
+  SaveCentroid(log, pCB, *j);
   CopyVector(Vector(pTS, i), Vector(pCB, *j), VectorSize(pTS));
-  if (quietLevel >= 5)  PrintMessage("Random Swap done: x=%i  c=%i \n", i, *j);
+  CentroidChanged(log, *j);
+
+  /* the second nearest entries at j are stale until the next pass */
+  if (log != NULL && log->second != NULL)  log->secondMoved = *j;
+  if (quietLevel >= 5)  ContextMessage(ctx, "Random Swap done: x=%i  c=%i \n", i, *j);
 }
 
 
@@ -486,42 +1504,154 @@ void RandomSwap(CODEBOOK *pCB, TRAININGSET *pTS, int *j, int deterministic,
 /*-------------------------------------------------------------------*/
 
 
-void LocalRepartition(PARTITIONING *pP, CODEBOOK *pCB, TRAININGSET *pTS,
-double *weight, int j, double time, int quietLevel)
+void LocalRepartition(DENRSCONTEXT *ctx, PARTITIONING *pP, CODEBOOK *pCB,
+TRAININGSET *pTS, double *weight, int j, int quietLevel, TRIALLOG *log,
+GRIDINDEX *grid, int *candidate, WORKSPACE *W)
 {
-  if (quietLevel >= 5)  PrintMessage("Local repartition of vector %i \n", j);
+  if (quietLevel >= 5)  ContextMessage(ctx, "Local repartition of vector %i \n", j);
 
   /* object rejection; maps points from a cluster to their nearest cluster */
-  LocalRepartitioningWithWeight(pTS, pCB, pP, weight, j, EUCLIDEANSQ);
+  LocalRepartitioningWithWeight(pTS, pCB, pP, weight, j, EUCLIDEANSQ, log, W);
 
   /* object attraction; moves vectors from their old partitions to
      a the cluster j if its centroid is closer */
-  RepartitionDueToNewVectorGeneral(pTS, pCB, pP, j, EUCLIDEANSQ);
+  RepartitionDueToNewVector(ctx, pTS, pCB, pP, j, log, grid, candidate,
+                            quietLevel);
 
-  if (quietLevel >= 3)  PrintMessage("RepartitionTime= %f   ", GetClock(time));
+  if (quietLevel >= 3)  ContextMessage(ctx, "RepartitionTime= %f   ", RunTime(ctx));
 } 
 
 
+/*-------------------------------------------------------------------*/
+/* Object attraction with the same (unweighted) rule as               */
+/* RepartitionDueToNewVectorGeneral(), but the moves are logged.      */
+/* With a grid index, only the vectors near centroid j are visited:   */
+/* a vector of cluster a moves only if |x-c_j| < |x-c_a| < r_a+1,     */
+/* where r_a is the radius of a, and then also |c_a-c_j| < 2(r_a+1).  */
+/*-------------------------------------------------------------------*/
+
+
+void RepartitionDueToNewVector(DENRSCONTEXT *ctx, TRAININGSET *pTS,
+CODEBOOK *pCB, PARTITIONING *pP, int j, TRIALLOG *log, GRIDINDEX *grid,
+int *candidate, int quietLevel)
+{
+  int    i, a, n, count, moved;
+  llong  olderror, newerror;
+  double radius, r;
+
+  if (grid == NULL || log == NULL)
+    {
+    for (i = 0; i < BookSize(pTS); i++)
+      {
+      if (Map(pP, i) != j)
+        {
+        olderror = VectorDistance(Vector(pTS, i), Vector(pCB, Map(pP, i)),
+                                  VectorSize(pTS), MAXLLONG, EUCLIDEANSQ);
+        newerror = VectorDistance(Vector(pTS, i), Vector(pCB, j),
+                                  VectorSize(pTS), olderror, EUCLIDEANSQ);
+        if (newerror < olderror)
+          {
+          MoveVector(log, pTS, pP, j, i);
+          ForgetSecond(log, i);
+          }
+        }
+      }
+    CountDistances(log, 2 * (llong) BookSize(pTS));
+    return;
+    }
+
+  /* largest radius of the clusters that can lose vectors to j */
+  radius = 0.0;
+  for (a = 0; a < BookSize(pCB); a++)
+    {
+    if (a == j || CCFreq(pP, a) == 0)  continue;
+    r = (ClusterRadius(log, pTS, pP, a) + 1.0) * (1.0 + ATTRACTION_SLACK);
+    if (r > radius &&
+        VectorDistance(Vector(pCB, a), Vector(pCB, j), VectorSize(pCB),
+                       MAXLLONG, EUCLIDEANSQ) < 4.0 * r * r)
+      {
+      radius = r;
+      }
+    }
+
+  /* the moves are made in index order, as in the full scan */
+  count = GridCandidates(grid, pCB, j, radius, candidate);
+  moved = 0;
+  for (n = 0; n < count; n++)
+    {
+    i = candidate[n];
+    if (Map(pP, i) != j)
+      {
+      olderror = VectorDistance(Vector(pTS, i), Vector(pCB, Map(pP, i)),
+                                VectorSize(pTS), MAXLLONG, EUCLIDEANSQ);
+      newerror = VectorDistance(Vector(pTS, i), Vector(pCB, j),
+                                VectorSize(pTS), olderror, EUCLIDEANSQ);
+      if (newerror < olderror)  candidate[moved++] = i;
+      }
+    }
+  CountDistances(log, BookSize(pCB) + 2 * (llong) count);
+  qsort(candidate, moved, sizeof(int), CompareInt);
+  for (n = 0; n < moved; n++)
+    {
+    MoveVector(log, pTS, pP, j, candidate[n]);
+    ForgetSecond(log, candidate[n]);
+    }
+
+  if (quietLevel >= 5)
+    {
+    ContextMessage(ctx, "Attraction: %i of %i vectors visited.\n", count,
+                   BookSize(pTS));
+    }
+}
+
+
 /*-------------------------------------------------------------------*/
 
 
 void LocalRepartitioningWithWeight(TRAININGSET* TS,CODEBOOK* CB, PARTITIONING* P,
-double* weight, int index, DISTANCETYPE disttype)
+double* weight, int index, DISTANCETYPE disttype, TRIALLOG *log, WORKSPACE *W)
 {
-  int   i, j;
-  llong error;
-  int   new;
+  int        i, n, m, count, lists;
+  int        vec[KERNEL_TILE], guess[KERNEL_TILE], new[KERNEL_TILE];
+  llong      error[KERNEL_TILE];
 
-  i = FirstVector(P, index);
-  while (!EndOfPartition(i))
+  PackCodebook(CB, weight, &W->PB);
+
+  /* the moves below do not disturb a walk of up-to-date lists */
+  lists = (log != NULL && log->membersValid);
+  m     = lists ? log->start[index] : 0;
+  i     = lists ? 0 : FirstVector(P, index);
+
+  for (;;)
     {
-    new = FindNearestVectorWithWeight(&Node(TS,i), CB, &error, Map(P,i), disttype, weight);
-    j   = i;
-    i   = NextVector(P,i);
+    /* collect a tile before moving any of its vectors */
+    for (count = 0; count < KERNEL_TILE; count++)
+      {
+      if (lists)
+        {
+        if ((vec[count] = NextMember(log, index, &m)) < 0)  break;
+        }
+      else
+        {
+        if (EndOfPartition(i))  break;
+        vec[count] = i;
+        i = NextVector(P,i);
+        }
+      guess[count] = Map(P, vec[count]);
+      }
+    if (count == 0)  break;
+
+    FindNearestVectorsPacked(TS, &W->PB, vec, guess, count, new, error, NULL,
+                             NULL);
+    CountDistances(log, (llong) count * BookSize(CB));
 
-    if (new != index)
+    for (n = 0; n < count; n++)
       {
-      ChangePartition(TS, P, new, j);
+      if (new[n] != index)
+        {
+        MoveVector(log, TS, P, new[n], vec[n]);
+        ForgetSecond(log, vec[n]);
+        }
       }
     }
 }
@@ -531,13 +1661,15 @@ double* weight, int index, DISTANCETYPE disttype)
 
 
 double GenerateOptimalPartitioningWithWeight(TRAININGSET* TS, CODEBOOK* CB,
-PARTITIONING* P, ERRORFTYPE errorf, double* weight)
+PARTITIONING* P, ERRORFTYPE errorf, double* weight, int threads,
+WORKSPACE *W)
 {
   switch (errorf)
     {
     case MSE:
       {
-      return GenerateOptimalPartitioningMeanErrorWithWeight(TS, CB, P, EUCLIDEANSQ, weight);
+      return GenerateOptimalPartitioningMeanErrorWithWeight(TS, CB, P, EUCLIDEANSQ,
+                                                            weight, threads, W);
       }
     default:
       {
@@ -556,52 +1688,181 @@ PARTITIONING* P, ERRORFTYPE errorf, double* weight)
 /*-------------------------------------------------------------------*/
 
 double GenerateOptimalPartitioningMeanErrorWithWeight(TRAININGSET* TS,
-CODEBOOK* CB, PARTITIONING* P, DISTANCETYPE  disttype, double* weight)
+CODEBOOK* CB, PARTITIONING* P, DISTANCETYPE  disttype, double* weight,
+int threads, WORKSPACE *W)
 {
-  llong  error;
-  llong  totalerror = 0;
-  int    i;
-  int    nearest;
+  llong      totalerror = 0;
+  llong      *partial = W->partial;
+  int        t;
+  MOVELIST   *M = W->moves;
 
-  /* Find mapping from training vector to code vector */
-  for(i = 0; i < BookSize(TS); i++)
+  PackCodebook(CB, weight, &W->PB);
+
+  /* Find mapping from training vector to code vector. Each thread
+     handles a contiguous range; partitions are changed afterwards in
+     vector order, so the result does not depend on the thread count. */
+  for(t = 0; t < threads; t++)  partial[t] = 0;
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads)
+#endif
+  {
+  llong  error[KERNEL_TILE];
+  int    vec[KERNEL_TILE], guess[KERNEL_TILE], nearest[KERNEL_TILE];
+  int    i, n, count, lo, hi, tid;
+
+  ThreadRange(BookSize(TS), &tid, &lo, &hi);
+  for(i = lo; i < hi; i += KERNEL_TILE)
     {
-    nearest = FindNearestVectorWithWeight(&Node(TS,i),
-              CB, &error, Map(P,i), disttype, weight);
-    if(nearest != Map(P, i))
+    count = min(KERNEL_TILE, hi - i);
+    for(n = 0; n < count; n++)
+      {
+      vec[n]   = i + n;
+      guess[n] = Map(P, i + n);
+      }
+
+    FindNearestVectorsPacked(TS, &W->PB, vec, guess, count, nearest, error,
+                             NULL, NULL);
+
+    for(n = 0; n < count; n++)
       {
-      ChangePartition(TS, P, nearest, i);
+      if(nearest[n] != Map(P, i + n))
+        {
+        AddMove(&M[tid], i + n, nearest[n]);
+        }
+      partial[tid] += error[n] * VectorFreq(TS, i + n);
       }
-    totalerror += error * VectorFreq(TS, i);
     }
+  }
+
+  ApplyMoves(TS, P, M, threads, NULL);
+  for(t = 0; t < threads; t++)  totalerror += partial[t];
 
   return (double) totalerror / (double) (TotalFreq(TS) * VectorSize(TS));
 }
 
 
+/*-------------------------------------------------------------------*/
+/* Number of threads used when the caller asks for the default (0).  */
+/*-------------------------------------------------------------------*/
+
+
+int DefaultThreads(void)
+{
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Splits 0..size-1 into contiguous ranges, one per thread of the    */
+/* current parallel team. Outside a parallel region gives it all.    */
+/*-------------------------------------------------------------------*/
+
+
+static void ThreadRange(int size, int *tid, int *lo, int *hi)
+{
+  int t = 0, T = 1;
+
+#ifdef _OPENMP
+  t = omp_get_thread_num();
+  T = omp_get_num_threads();
+#endif
+  *tid = t;
+  *lo  = (int) ((llong) size * t / T);
+  *hi  = (int) ((llong) size * (t + 1) / T);
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+/* The lists of a workspace have room for a thread range; they grow  */
+/* only when a pass uses fewer threads than the workspace.           */
+/*-------------------------------------------------------------------*/
+
+
+void AddMove(MOVELIST *M, int vec, int to)
+{
+  if (M->count == M->size)
+    {
+    M->size = (M->size == 0) ? 256 : 2 * M->size;
+    M->vec  = (int*) realloc(M->vec, M->size * sizeof(int));
+    M->to   = (int*) realloc(M->to,  M->size * sizeof(int));
+    if (!M->vec || !M->to)
+      {
+      ErrorMessage("ERROR: Allocating memory failed!\n");
+      ExitProcessing(FATAL_ERROR);
+      }
+    }
+  M->vec[M->count] = vec;
+  M->to[M->count]  = to;
+  M->count++;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Applies the moves thread by thread. Threads own consecutive       */
+/* ranges, so this is the same order as a serial pass.               */
+/*-------------------------------------------------------------------*/
+
+
+void ApplyMoves(TRAININGSET *TS, PARTITIONING *P, MOVELIST *M, int threads,
+TRIALLOG *log)
+{
+  int t, n;
+
+  for (t = 0; t < threads; t++)
+    {
+    for (n = 0; n < M[t].count; n++)
+      {
+      MoveVector(log, TS, P, M[t].to[n], M[t].vec[n]);
+      }
+    M[t].count = 0;
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Squared Euclidean distances are summed in the dimension order     */
+/* (NULL = natural order) and stop once the centroid cannot beat the */
+/* best one; other distance types use the toolkit.                   */
+/*-------------------------------------------------------------------*/
+
+
+static llong WeightedDistance(BOOKNODE* v, CODEBOOK* CB, int i,
+DISTANCETYPE disttype, double* weight, int *order, llong best)
+{
+  if (disttype == EUCLIDEANSQ)
+    {
+    return weight[i] * sqrt(PartialDistance(Vector(CB, i), v->vector,
+                            order, VectorSize(CB),
+                            WeightedLimit(best, weight[i])));
+    }
+  return weight[i] * sqrt(VectorDistance(Vector(CB, i), v->vector,
+                          VectorSize(CB), MAXLLONG, disttype));
+}
+
+
 /*-------------------------------------------------------------------*/
 
 
 int FindNearestVectorWithWeight(BOOKNODE* v, CODEBOOK* CB, llong* error,
-int guess, DISTANCETYPE disttype, double* weight)
+int guess, DISTANCETYPE disttype, double* weight, int *order)
 {
   int   i;
   int   MinIndex = guess;
   llong e;
 
-  *error = weight[guess] * sqrt(VectorDistance(Vector(CB, guess),
-                                          v->vector,
-                                          VectorSize(CB),
-                                          MAXLLONG,
-                                          disttype));
+  *error = WeightedDistance(v, CB, guess, disttype, weight, order, MAXLLONG);
 
   for(i = 0; i < BookSize(CB); i++)
     {
-    e = weight[i] * sqrt(VectorDistance(Vector(CB, i),
-                                   v->vector,
-                                   VectorSize(CB),
-                                   MAXLLONG,
-                                   disttype));
+    if( i == guess )  continue;
+    e = WeightedDistance(v, CB, i, disttype, weight, order, *error);
     if( e < *error )
       {
       *error   = e;
@@ -648,10 +1909,12 @@ double MeanDistance(TRAININGSET* TS, CODEBOOK* CB, PARTITIONING* P, int index)
 
 
 /*----------------------------------------------------------------------*/
-/* Calculates the density of the given cluster.                         */
+/* Calculates the density of the given cluster. With a trial log, the   */
+/* cached total distance of the cluster is used.                        */
 /*----------------------------------------------------------------------*/
 
-double CalculateDensity(TRAININGSET* TS, CODEBOOK* CB, PARTITIONING* P, int index)
+double CalculateDensity(TRAININGSET* TS, CODEBOOK* CB, PARTITIONING* P, int index,
+                        TRIALLOG *log)
 {
   /*
    * Alternatively:
@@ -661,6 +1924,11 @@ double CalculateDensity(TRAININGSET* TS, CODEBOOK* CB, PARTITIONING* P, int inde
   {
 	return 0.001;
   }
+  if (log != NULL)
+  {
+    return ((double) CCFreq(P, index)) / 
+           (ClusterDistance(log, TS, P, index) / (double) CCFreq(P, index));
+  }
   return ((double) CCFreq(P, index)) / MeanDistance(TS, CB, P, index);
 }
 
@@ -668,44 +1936,20 @@ double CalculateDensity(TRAININGSET* TS, CODEBOOK* CB, PARTITIONING* P, int inde
 /* Calculates temporary centroid weights with the specified method.               */
 /*----------------------------------------------------------------------*/
 
-void CalculateNewWeights(TRAININGSET* TS, CODEBOOK* CB, PARTITIONING* P, double *tempweight)
+void CalculateNewWeights(TRAININGSET* TS, CODEBOOK* CB, PARTITIONING* P, double *tempweight,
+TRIALLOG *log, WORKSPACE *W)
 {
   int i;
-  double density[BookSize(CB)];
+  double *density = W->density;
   double totaldensity = 0.0;
 
-  /* Calculate densities */
-  for (i = 0; i < BookSize(CB); i++)
-    {
-    density[i] = CalculateDensity(TS, CB, P, i);
-
-    totaldensity += density[i];
-    }
-
-  /* Calculate weights based on densities */
-  for (i = 0; i < BookSize(CB); i++)
-    {
-    tempweight[i] = density[i] / totaldensity;
-    }
-}
-
-/*-------------------------------------------------------------------*/
-
-
-/*----------------------------------------------------------------------*/
-/* Calculates centroid weights with the specified method.               */
-/*----------------------------------------------------------------------*/
-
-void CalculateWeights(TRAININGSET* TS, CODEBOOK* CB, PARTITIONING* P, double *weight)
-{
-  int i;
-  double density[BookSize(CB)];
-  double totaldensity = 0.0;
+  /* the clusters to recalculate are read as contiguous lists */
+  if (log != NULL)  UpdateMembers(log, P);
 
   /* Calculate densities */
   for (i = 0; i < BookSize(CB); i++)
     {
-    density[i] = CalculateDensity(TS, CB, P, i);
+    density[i] = CalculateDensity(TS, CB, P, i, log);
 
     totaldensity += density[i];
     }
@@ -713,29 +1957,8 @@ void CalculateWeights(TRAININGSET* TS, CODEBOOK* CB, PARTITIONING* P, double *we
   /* Calculate weights based on densities */
   for (i = 0; i < BookSize(CB); i++)
     {
-    weight[i] = density[i] / totaldensity;
+    tempweight[i] = density[i] / totaldensity;
     }
-	
-   
-
-  /* To test with fixed weights, you can set the weights here. */
-
-  /* Fixed weights for data set 2 (3 clusters) */
-  /*
-  weight[0] = 0.108982427363303;
-  weight[1] = 0.6741309708665223;
-  weight[2] = 0.21688660177017471;
-  */
-
-  /* Fixed weights for data set 3 (6 clusters) */
-  /*
-  weight[0] = 0.02106790516316829;
-  weight[1] = 0.41617120230566335;
-  weight[2] = 0.1406377044364807;
-  weight[3] = 0.20898574056675104;
-  weight[4] = 0.1409327584628596;
-  weight[5] = 0.07220468906507695;
-  */
 }
 
 /*-------------------------------------------------------------------*/
@@ -743,16 +1966,16 @@ void CalculateWeights(TRAININGSET* TS, CODEBOOK* CB, PARTITIONING* P, double *we
 
 /* generates optimal codebook with respect to a given partitioning */
 void OptimalRepresentatives(PARTITIONING *pP, TRAININGSET *pTS, CODEBOOK *pCB, 
-int *active, llong *cdist, int *activeCount)
+int *active, llong *cdist, int *activeCount, TRIALLOG *log, WORKSPACE *W)
 {
   int i, j;
-  VECTORTYPE v;
+  VECTORTYPE v = W->centroid;
 
   j = 0;
-  v = CreateEmptyVector(VectorSize(pCB));
 
   for(i = 0; i < BookSize(pCB); i++)
     {  
+    SaveCentroid(log, pCB, i);
     if (CCFreq(pP, i) > 0)
       {
       CopyVector(Vector(pCB, i), v, VectorSize(pCB));
@@ -761,6 +1984,7 @@ int *active, llong *cdist, int *activeCount)
       /* if centroid changed, cluster is active */
       if (CompareVectors(Vector(pCB, i), v, VectorSize(pCB)) != 0)
         {
+        CentroidChanged(log, i);
         active[j] = i;
         j++;
         }
@@ -771,7 +1995,6 @@ int *active, llong *cdist, int *activeCount)
       }
     }
 
-  FreeVector(v);
   (*activeCount) = j;
 }  
 
@@ -803,72 +2026,275 @@ int BinarySearch(int *arr, int size, int key)
 
 /*-------------------------------------------------------------------*/
 /* generates optimal partitioning with respect to a given codebook */
+/* If log keeps second nearest centroids (AttachSecond), the entry of
+   each vector is set to its second nearest centroid by the weights of
+   the pass, or -1 if that is not known: a full search finds it, and so
+   does a search of the active centroids when the previous entry did
+   not move (the weights of static clusters change by the same factor).
+   The centroid swapped since the last pass is checked separately if
+   it is not active. The errors of the vectors and of their known
+   second nearest centroids are summed per cluster into W->clusterError
+   and W->secondError (W->totals); the others are listed in W->unknown
+   (see SelectClusterToBeSwapped). */
 // AKTIIVINEN-PASIIVINEN VEKTORI MUUTOS
 
 
-void OptimalPartition(CODEBOOK *pCB, TRAININGSET *pTS, PARTITIONING *pP, 
-int *active, llong *cdist, int activeCount, llong *distance, double *weight, int quietLevel)
+void OptimalPartition(DENRSCONTEXT *ctx, CODEBOOK *pCB, TRAININGSET *pTS,
+PARTITIONING *pP, int *active, llong *cdist, int activeCount,
+llong *distance, double *weight, int quietLevel, int threads, TRIALLOG *log,
+WORKSPACE *W)
 {
-  int i, j, k;
-  int nearest;
-  llong error, dist;
-  CODEBOOK CBact;
+  llong evals = 0;
+  CODEBOOK *CBact;
+  PACKEDBOOK *PB = &W->PB, *PBact = &W->PBact;
+  MOVELIST *M = W->moves, *U = W->unknown;
+  int *second = (log != NULL) ? log->second : NULL;
+  llong *secondDist = (log != NULL) ? log->secondDist : NULL;
+  llong *sum;
+  int i, t, swapped = -1;
   
-  if (quietLevel >= 5)  PrintMessage("\n Optimal Partition starts. ActiveCount=%i..\n", activeCount);
+  if (quietLevel >= 5)  ContextMessage(ctx, "\n Optimal Partition starts. ActiveCount=%i..\n", activeCount);
 
   /* all vectors are static; there is nothing to do! */
-  if (activeCount < 1) return;
+  if (activeCount < 1)
+    {
+    ForgetAllSecond(log);
+    return;
+    }
+
+  /* subcodebook (active clusters) shares the vectors of pCB */
+  CBact = ActiveCodebook(W, pCB, active, activeCount);
 
-  /* creating subcodebook (active clusters) */
-  if (quietLevel >= 5)  PrintMessage("Creating subcodebook...");
-  CreateNewCodebook(&CBact, activeCount, pTS);
-  for (i = 0; i < activeCount; i++) 
+  /* the sub-codebook is weighted by the clusters it holds */
+  for (i = 0; i < activeCount; i++)
     {
-    CopyVector(Vector(pCB, active[i]), Vector(&CBact, i), VectorSize(pCB));
+    W->activeWeight[i] = weight[active[i]];
     }
-  if (quietLevel >= 5)  PrintMessage("Done.\n");
-  
-  if (quietLevel >= 5)  PrintMessage("Looping ... ");
-  for(i = 0; i < BookSize(pTS); i++)
+  PackCodebook(pCB, weight, PB);
+  PackCodebook(CBact, W->activeWeight, PBact);
+
+  if (second != NULL)
+    {
+    if (log->secondMoved >= 0 &&
+        BinarySearch(active, activeCount, log->secondMoved) < 0)
+      {
+      swapped = log->secondMoved;
+      }
+    memset(W->threadError, 0, (size_t) W->Threads * 2 * BookSize(pCB) *
+           sizeof(llong));
+    for (t = 0; t < W->Threads; t++)  U[t].count = 0;
+    }
+
+  /* each vector is decided independently; the partition changes are
+     applied afterwards in vector order (see ApplyMoves) */
+  if (quietLevel >= 5)  ContextMessage(ctx, "Looping ... ");
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads) reduction(+:evals)
+#endif
+  {
+  int i, j, k, lo, hi, tid, full;
+  int nearest, runner, prev, *rp = (second != NULL) ? &runner : NULL;
+  llong error, dist, rerr, perr, d, *pri = NULL, *sec = NULL;
+
+  ThreadRange(BookSize(pTS), &tid, &lo, &hi);
+  if (second != NULL)
+    {
+    pri = W->threadError + (size_t) 2 * tid * BookSize(pCB);
+    sec = pri + BookSize(pCB);
+    }
+  for(i = lo; i < hi; i++)
      {
-     if (quietLevel >= 5)  PrintMessage(" %i ", i);
      j     = Map(pP, i);
      k     = BinarySearch(active, activeCount, j);
-     dist  = weight[j] * sqrt(VectorDistance(Vector(pTS, i), Vector(pCB, j), VectorSize(pTS), MAXLLONG, EUCLIDEANSQ)); 
+     dist  = weight[j] * sqrt(DenseDistance(Vector(pTS, i), Vector(pCB, j), VectorSize(pTS))); 
+     runner = -1;
+     rerr   = MAXLLONG;
+     full   = (activeCount == BookSize(pCB));
+     
+     /* previous second nearest; still valid if it did not move */
+     prev  = (second != NULL) ? second[i] : -1;
+     if (prev >= 0 && (prev == log->secondMoved ||
+                       BinarySearch(active, activeCount, prev) >= 0))
+       {
+       prev = -1;
+       }
      
      // static vector - search subcodebook
      if (k < 0)  
        {
-       nearest = FindNearestVectorWithWeight(&Node(pTS,i), &CBact, &error, 0, EUCLIDEANSQ, weight);
-       nearest = (error < dist) ? active[nearest] : j;
+       nearest = FindNearestVectorPacked(pTS, PBact, i, 0, &error, rp, &rerr);
+       if (error < dist)
+         {
+         nearest = active[nearest];
+         runner  = (runner >= 0) ? active[runner] : -1;
+         if (dist <= rerr)
+           {
+           runner = j;
+           rerr   = dist;
+           }
+         }
+       else
+         {
+         runner  = active[nearest];
+         rerr    = error;
+         nearest = j;
+         }
+       evals  += 1 + activeCount;
        }
      // active vector, centroid moved closer - search subcodebook
      else if (dist < distance[i])  
        {
-       nearest = FindNearestVectorWithWeight(&Node(pTS,i), &CBact, &error, k, EUCLIDEANSQ, weight);
+       nearest = FindNearestVectorPacked(pTS, PBact, i, k, &error, rp, &rerr);
        nearest = active[nearest];
+       runner  = (runner >= 0) ? active[runner] : -1;
+       evals  += 1 + activeCount;
        } 
      // active vector, centroid moved farther - FULL search
      else  
        {
-       nearest = FindNearestVectorWithWeight(&Node(pTS,i), pCB, &error, j, EUCLIDEANSQ, weight);
+       nearest = FindNearestVectorPacked(pTS, PB, i, j, &error, rp, &rerr);
+       full    = YES;
+       evals  += 1 + BookSize(pCB);
        }
      
      if (nearest != j)  
        {
        /* closer cluster was found */
-       ChangePartition(pTS, pP, nearest, i);
+       AddMove(&M[tid], i, nearest);
        distance[i] = error;
        } 
      else 
        {
        distance[i] = dist;
        }
+
+     if (second != NULL)
+       {
+       /* the swapped centroid was not searched */
+       if (!full && swapped >= 0 && swapped != nearest)
+         {
+         perr   = weight[swapped] * sqrt(DenseDistance(Vector(pTS, i),
+                                    Vector(pCB, swapped), VectorSize(pTS)));
+         evals += 1;
+         if (perr < rerr)
+           {
+           runner = swapped;
+           rerr   = perr;
+           }
+         }
+
+       /* a search of the active centroids is exact only together
+          with the best static one */
+       if (!full && prev >= 0 && prev != nearest)
+         {
+         perr = weight[prev] * sqrt(secondDist[i]);
+         if (perr < rerr)
+           {
+           runner = prev;
+           rerr   = perr;
+           }
+         }
+       else if (!full)
+         {
+         runner = -1;
+         }
+
+       if (runner < 0)
+         {
+         ForgetSecond(log, i);
+         AddMove(&U[tid], i, nearest);
+         }
+       else
+         {
+         if (runner != prev)
+           {
+           d      = DenseDistance(Vector(pTS, i), Vector(pCB, runner),
+                                  VectorSize(pTS));
+           evals += 1;
+           if (runner != second[i] || d != secondDist[i])
+             {
+             SaveSecond(log, i);
+             second[i]     = runner;
+             secondDist[i] = d;
+             }
+           }
+         sec[nearest] += rerr * VectorFreq(pTS, i);
+         }
+       pri[nearest] += distance[i] * VectorFreq(pTS, i);
+       }
     }
+  }
 
-  FreeCodebook(&CBact);
+  ApplyMoves(pTS, pP, M, threads, log);
+  CountDistances(log, evals);
+
+  /* per-cluster sums of the threads */
+  if (second != NULL)
+    {
+    memset(W->clusterError, 0, BookSize(pCB) * sizeof(llong));
+    memset(W->secondError,  0, BookSize(pCB) * sizeof(llong));
+    for (t = 0; t < W->Threads; t++)
+      {
+      sum = W->threadError + (size_t) 2 * t * BookSize(pCB);
+      for (i = 0; i < BookSize(pCB); i++)
+        {
+        W->clusterError[i] += sum[i];
+        W->secondError[i]  += sum[BookSize(pCB) + i];
+        }
+      }
+    W->totals        = YES;
+    log->secondMoved = -1;
+    }
   
-  if (quietLevel >= 5)  PrintMessage("Optimal Partition ended.\n");
+  if (quietLevel >= 5)  ContextMessage(ctx, "Optimal Partition ended.\n");
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Alternative to OptimalPartition: every vector goes to its nearest */
+/* centroid (FindNearestVectorWithWeight with its own centroid as    */
+/* guess), but distances are calculated only for the centroids that  */
+/* the bounds of the vector cannot rule out. The bounds carry over   */
+/* between iterations and trials (see DENBOUND.C).                   */
+/*-------------------------------------------------------------------*/
+
+
+void BoundedPartition(DENRSCONTEXT *ctx, CODEBOOK *pCB, TRAININGSET *pTS,
+PARTITIONING *pP, double *weight, BOUNDS *B, int quietLevel, int threads,
+TRIALLOG *log, WORKSPACE *W)
+{
+  MOVELIST *M = W->moves;
+  llong     evals = 0;
+
+  PrepareBounds(B, pCB, weight);
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(threads) reduction(+:evals)
+#endif
+  {
+  int     i, j, lo, hi, tid, nearest;
+  double *scratch;
+
+  ThreadRange(BookSize(pTS), &tid, &lo, &hi);
+  scratch = W->scratch + (size_t) tid * (BookSize(pCB) + BOUND_MAXGROUPS);
+  for (i = lo; i < hi; i++)
+    {
+    j       = Map(pP, i);
+    nearest = NearestWithBounds(B, pTS, i, j, scratch, &evals);
+    if (nearest != j)  AddMove(&M[tid], i, nearest);
+    }
+  }
+
+  ApplyMoves(pTS, pP, M, threads, log);
+  CommitBounds(B);
+  CountDistances(log, evals);
+
+  if (quietLevel >= 5)
+    {
+    ContextMessage(ctx, "Bounded partition: %lld of %lld distances "
+                   "calculated.\n", evals, (llong) BookSize(pTS) *
+                   BookSize(pCB));
+    }
 }
 /*-------------------------------------------------------------------*/
 
@@ -896,40 +2322,63 @@ void CopyFinalWeights(double *weight, double *tempweight, int size)
 
 /*-------------------------------------------------------------------*/
 /* fast K-means implementation (uses activity detection method) */
+/* Returns the iterations done; fewer than iter if the deadline      */
+/* (WallClock time, 0 = none) was reached.                           */
 
 
-void KMeans(PARTITIONING *pP, CODEBOOK *pCB, TRAININGSET *pTS, llong *distance, 
-double *weight, int iter, int quietLevel, double time, double *tempweight, llong currError) 
+int KMeans(DENRSCONTEXT *ctx, PARTITIONING *pP, CODEBOOK *pCB, TRAININGSET *pTS, llong *distance, 
+double *weight, int iter, int quietLevel, double *tempweight, llong currError,
+int threads, TRIALLOG *log, BOUNDS *bounds, TRIALSTATS *stats, WORKSPACE *W,
+double deadline) 
 {
 
-  double starttime = GetClock(time);
+  double starttime = RunTime(ctx);
   int     i, activeCount;
-  int     active[BookSize(pCB)];
-  llong   cdist[BookSize(pCB)];
+  int     *active = W->active;
+  llong   *cdist = W->cdist;
   llong newError = currError;
 
-  CalculateDistances(pTS, pCB, pP, distance, weight);
+  /* the sums of an earlier solution are not valid (see OptimalPartition) */
+  W->totals = NO;
+  if (bounds == NULL)
+    {
+    CalculateDistances(pTS, pCB, pP, distance, weight, threads);
+    CountDistances(log, BookSize(pTS));
+    }
   
   CopyWeights(weight, tempweight, BookSize(pCB));
 
-  double inittime = GetClock(time) - starttime;
+  double inittime = RunTime(ctx) - starttime;
   /* performs iter K-means iterations */
-  for (i = 0; i < iter; i++)
+  for (i = 0; i < iter && !TimeOver(deadline); i++)
     {
     /* OptimalRepresentatives-operation should be before 
        OptimalPartition-operation, because we have previously tuned 
        partition with LocalRepartition-operation */ 
 	currError = newError;
-    OptimalRepresentatives(pP, pTS, pCB, active, cdist, &activeCount);
-	OptimalPartition(pCB, pTS, pP, active, cdist, activeCount, distance, tempweight, quietLevel);
+    BeginPhase(stats, log, STATS_KMEANS);
+    OptimalRepresentatives(pP, pTS, pCB, active, cdist, &activeCount, log, W);
+    if (stats != NULL)  stats->Active += activeCount;
+    if (bounds != NULL)
+      {
+      BoundedPartition(ctx, pCB, pTS, pP, tempweight, bounds, quietLevel, threads,
+                       log, W);
+      }
+    else
+      {
+      OptimalPartition(ctx, pCB, pTS, pP, active, cdist, activeCount, distance,
+                       tempweight, quietLevel, threads, log, W);
+      }
     
 
     if (quietLevel >= 3)  
       {
-      PrintIterationActivity(GetClock(time), i, activeCount, BookSize(pCB), quietLevel);
+      ContextMessage(ctx, "K-means %i: %i of %i clusters active, time %f\n",
+                     i, activeCount, BookSize(pCB), RunTime(ctx));
       }
 	  
-	CalculateNewWeights(pTS, pCB, pP, tempweight);
+    BeginPhase(stats, log, STATS_WEIGHTS);
+	CalculateNewWeights(pTS, pCB, pP, tempweight, log, W);
 	/*printf("Centroids in Kmeans iteration %d",i);
 	PrintCentroidWeights(pCB, weight, tempweight);
 	printf("=================");*/
@@ -947,8 +2396,10 @@ double *weight, int iter, int quietLevel, double time, double *tempweight, llong
 
   if ((quietLevel >= 4) && iter > 0) 
      {
-     PrintIterationKMSummary(GetClock(time)-starttime, inittime);
+     ContextMessage(ctx, "K-means time %f (initialization %f)\n",
+                    RunTime(ctx)-starttime, inittime);
      }
+  return i;
 }
 
 
@@ -958,37 +2409,30 @@ double *weight, int iter, int quietLevel, double time, double *tempweight, llong
 /*-------------------------------------------------------------------*/
 
 
-llong ObjectiveFunction(PARTITIONING *pP, CODEBOOK *pCB, TRAININGSET *pTS, double *weight)
+llong ObjectiveFunction(PARTITIONING *pP, CODEBOOK *pCB, TRAININGSET *pTS, double *weight,
+WORKSPACE *W)
 {
-  llong sum = 0;
-  //llong current;
-//  llong error = 0;
-  int i, j;
+  llong  sum = 0;
+  llong *sse = W->clusterError;
+  int    i, j;
 
-  /* sum of weighted squared distances of the data object
-     to their cluster representatives */
+  for (j = 0; j < BookSize(pCB); j++)  sse[j] = 0;
+
+  /* squared distances of the data objects to their cluster
+     representatives, summed per cluster */
   for (i = 0; i < BookSize(pTS); i++) 
     {
     j = Map(pP, i);
-	
-	
-	/*error = weight[j] * sqrt(VectorDistance(Vector(pTS, i), Vector(pCB, j), VectorSize(pTS),
-           MAXLLONG, EUCLIDEANSQ) * VectorFreq(pTS, i));
-	
-	sum = sum + (error*error);*/
-	//printf("\np1 = ");
-	//PrintVector(Vector(pTS,i), (pTS)->BlockSizeX, (pTS)->BlockSizeY);
-	//printf("  p2 = ");
-	//PrintVector(Vector(pCB,j), (pCB)->BlockSizeX, (pCB)->BlockSizeY);
-	//current = (VectorDistance(Vector(pTS, i), Vector(pCB, j), VectorSize(pTS), MAXLLONG, EUCLIDEANSQ)*weight[j]);
-    //printf("weight = %.3f, sqaured eu dist = %lld, weighted sqaured eu dist = %lld", weight[j], VectorDistance(Vector(pTS, i), Vector(pCB, j), VectorSize(pTS), MAXLLONG, EUCLIDEANSQ), current);	
-    sum += weight[j] * VectorDistance(Vector(pTS, i), Vector(pCB, j), VectorSize(pTS),
-           MAXLLONG, EUCLIDEANSQ); //* VectorFreq(pTS, i);
-	//printf("  sum = %lld ", sum);
-    }
-
-  //double temperror = CALC_MSE(sum);
-  //printf("\nMSE = %f",temperror);
+    sse[j] += DenseDistance(Vector(pTS, i), Vector(pCB, j), VectorSize(pTS));
+    }
+
+  /* weighted per cluster, so that TrialObjective() gets the same value
+     from the cluster sums without visiting the data objects */
+  for (j = 0; j < BookSize(pCB); j++)
+    {
+    sum += weight[j] * sse[j];
+    }
+
   return sum;
 }
 
@@ -999,15 +2443,18 @@ llong ObjectiveFunction(PARTITIONING *pP, CODEBOOK *pCB, TRAININGSET *pTS, doubl
 
 
 void CalculateDistances(TRAININGSET *pTS, CODEBOOK *pCB, PARTITIONING *pP,
-                        llong *distance, double *weight)
+                        llong *distance, double *weight, int threads)
 {
   int i, j;
 
+#ifdef _OPENMP
+#pragma omp parallel for private(j) schedule(static) num_threads(threads)
+#endif
   for (i = 0; i < BookSize(pTS); i++) 
     {
     j = Map(pP, i);
-    distance[i] = weight[j] * sqrt(VectorDistance(Vector(pTS, i), Vector(pCB, j),
-                  VectorSize(pTS), MAXLLONG, EUCLIDEANSQ));
+    distance[i] = weight[j] * sqrt(DenseDistance(Vector(pTS, i), Vector(pCB, j),
+                  VectorSize(pTS)));
     }
 }
 
@@ -1016,23 +2463,27 @@ void CalculateDistances(TRAININGSET *pTS, CODEBOOK *pCB, PARTITIONING *pP,
 
 
 int FindSecondNearestVector(BOOKNODE *node, CODEBOOK *pCB, 
-                            int firstIndex, llong *secondError)
+                            int firstIndex, double *weight, int *order,
+                            llong *secondError, llong *secondDist)
 {
   int   i;
   int   secondIndex;
-  llong e;
+  llong d, e;
 
   secondIndex = -1;
   *secondError = MAXLLONG;
+  *secondDist  = MAXLLONG;
 
   for(i = 0; i < BookSize(pCB); i++)
     {
-    e = sqrt(VectorDistance(Vector(pCB,i), node->vector, VectorSize(pCB), 
-        *secondError, EUCLIDEANSQ));
+    d = PartialDistance(Vector(pCB,i), node->vector, order, VectorSize(pCB),
+                        WeightedLimit(*secondError, weight[i]));
+    e = weight[i] * sqrt(d);
 
       if ((e < *secondError) && (i != firstIndex))
     {
       *secondError = e;
+      *secondDist  = d;
       secondIndex  = i;
       }
     }
@@ -1042,34 +2493,79 @@ int FindSecondNearestVector(BOOKNODE *node, CODEBOOK *pCB,
 
 /*-------------------------------------------------------------------*/
 /* selects deterministicly, which cluster centroid to swap. one that 
-   increases objective function (MSE) least, if removed, is selected. */
+   increases objective function (MSE) least, if removed, is selected. 
+   After OptimalPartition (W->totals), the cluster errors are its sums,
+   and only the vectors listed in W->unknown are searched; otherwise
+   every vector is visited. log (may be NULL) keeps the second nearest
+   centroids found (see AttachSecond). */
 
 int SelectClusterToBeSwapped(TRAININGSET *pTS, CODEBOOK *pCB, 
-                             PARTITIONING *pP, llong *distance)
+                             PARTITIONING *pP, llong *distance, double *weight,
+                             TRIALLOG *log, WORKSPACE *W)
 {
-  int i, j, min;
-  llong error;
-  llong priError[BookSize(pCB)];  /* current error; data objects are in 
+  int i, j, n, s, t, min;
+  int *second = (log != NULL) ? log->second : NULL;
+  llong error, e, d;
+  llong *priError = W->clusterError; /* current error; data objects are in 
                                      their primary (closest) cluster) */
-  llong secError[BookSize(pCB)];  /* error after partition is removed and 
+  llong *secError = W->secondError;  /* error after partition is removed and 
                                      data objects are repartitioned; data 
                                      objects are in their secondary 
                                      (second closest) cluster */
+  MOVELIST *U = W->unknown;
 
-  /* initializing */
-  for (i = 0; i < BookSize(pCB); i++) 
+  if (second != NULL && W->totals)
     {
-    priError[i] = 0;
-    secError[i] = 0;
+    /* the known ones were summed by the partition pass */
+    for (t = 0; t < W->Threads; t++)
+      {
+      for (n = 0; n < U[t].count; n++)
+        {
+        i = U[t].vec[n];
+        j = Map(pP, i);
+        s = FindSecondNearestVector(&Node(pTS,i), pCB, j, weight, W->order,
+                                    &e, &d);
+        SaveSecond(log, i);
+        second[i]          = s;
+        log->secondDist[i] = d;
+        secError[j] += e * VectorFreq(pTS, i);
+        }
+      U[t].count = 0;
+      }
+    W->totals = NO;
     }
-
-  /* calculating primary and secondary cluster errors */
-  for (i = 0; i < BookSize(pTS); i++) 
+  else
     {
-    j = Map(pP, i);
-    FindSecondNearestVector(&Node(pTS,i), pCB, j, &error);
-    priError[j] += distance[i] * VectorFreq(pTS, i);
-    secError[j] += error * VectorFreq(pTS, i);    
+    /* initializing */
+    for (i = 0; i < BookSize(pCB); i++) 
+      {
+      priError[i] = 0;
+      secError[i] = 0;
+      }
+
+    /* calculating primary and secondary cluster errors */
+    for (i = 0; i < BookSize(pTS); i++) 
+      {
+      j = Map(pP, i);
+      s = (second != NULL) ? second[i] : -1;
+      if (s < 0 || s == j)
+        {
+        s = FindSecondNearestVector(&Node(pTS,i), pCB, j, weight, W->order,
+                                    &e, &d);
+        if (second != NULL)
+          {
+          SaveSecond(log, i);
+          second[i]          = s;
+          log->secondDist[i] = d;
+          }
+        }
+      else
+        {
+        e = weight[s] * sqrt(log->secondDist[i]);
+        }
+      priError[j] += distance[i] * VectorFreq(pTS, i);
+      secError[j] += e * VectorFreq(pTS, i);    
+      }
     }
 
   /* finding cluster that increases objective function least */
@@ -1114,15 +2610,19 @@ char* DenRSInfo(void)
 /*-------------------------------------------------------------------*/
 
 
-void PrintCentroidWeights(CODEBOOK *CB, double *weight, double *tempweight)
+void PrintCentroidWeights(DENRSCONTEXT *ctx, CODEBOOK *CB, double *weight,
+double *tempweight)
 {
-  int i;
+  int i, k;
   for(i = 0; i < BookSize(CB); i++)
     {
-    PrintMessage("c[%d] = ", i);
-    PrintVector(Vector(CB, i), CB->BlockSizeX, CB->BlockSizeY);
-    PrintMessage("\tw[%d] = %.3f", i, weight[i]);
-	PrintMessage("\ttempw[%d] = %.3f\n", i, tempweight[i]);
+    ContextMessage(ctx, "c[%d] = ", i);
+    for (k = 0; k < VectorSize(CB); k++)
+      {
+      ContextMessage(ctx, "%d ", VectorScalar(CB, i, k));
+      }
+    ContextMessage(ctx, "\tw[%d] = %.3f", i, weight[i]);
+	ContextMessage(ctx, "\ttempw[%d] = %.3f\n", i, tempweight[i]);
     }
 }
 
@@ -1135,8 +2635,8 @@ void CheckOverflow(llong a, llong b)
   /* Make sure a + b doesn't overflow */
   if (a > MAXLLONG - b)
     {
-    PrintMessage("Overflow: %lld + %lld > %lld!\n", a, b, MAXLLONG);
-    exit(-1);
+    ErrorMessage("ERROR: Overflow: %lld + %lld > %lld!\n", a, b, MAXLLONG);
+    ExitProcessing(FATAL_ERROR);
     }
 }
 
@@ -1144,7 +2644,7 @@ void CheckOverflow(llong a, llong b)
 /*-------------------------------------------------------------------*/
 
 
-int CheckClusterFreqs(CODEBOOK *pCB, PARTITIONING *pP)
+int CheckClusterFreqs(DENRSCONTEXT *ctx, CODEBOOK *pCB, PARTITIONING *pP)
 {
   int i;
   int nullcluster = 0;
@@ -1157,7 +2657,7 @@ int CheckClusterFreqs(CODEBOOK *pCB, PARTITIONING *pP)
        * Most likely some other centroid with a low weight attracted
        * all vectors that previously belonged to this partition.
        */
-      PrintMessage("WARNING: Number of vectors in cluster %d became zero!\n", i);
+      ContextMessage(ctx, "WARNING: Number of vectors in cluster %d became zero!\n", i);
 	  nullcluster = 1;
       }
     }
@@ -1,21 +1,144 @@
 #if ! defined(__DENRS_H)
 #define __DENRS_H
 
+/* Private random stream of a run (see SeedRandom in DENRS.C). */
+typedef struct
+  {
+  unsigned long long state;
+  } RANDOMSTATE;
+
+/* Options of a run; DefaultDenRSOptions gives the defaults. */
+typedef struct
+  {
+  int        Iterations;        /* swap iterations, 0 = automatic     */
+  int        KMeansIterations;  /* K-means iterations per swap        */
+  int        Deterministic;     /* deterministic swap                 */
+  int        QuietLevel;        /* 0 = silent                         */
+  int        Monitoring;
+  int        Threads;
+  int        Trials;            /* candidate swaps per round          */
+  int        Bounded;           /* bounded K-means                    */
+  int        Indexed;           /* grid index for the neighbours      */
+  int        Seeding;           /* initial centroids (DENSEED.H)      */
+  double     TimeLimit;         /* wall time in seconds, 0 = none     */
+  llong      Seed;              /* < 0 = use the generator of random.c */
+  } DENRSOPTIONS;
+
+/* Receives each message of a run (user is DENRSCONTEXT.User). */
+typedef void (*DENRSOUTPUT)(void *user, char *message);
+
+/* Receives the best solution so far after iteration iter; CB and P
+   must not be changed. */
+typedef void (*DENRSSOLUTION)(void *user, CODEBOOK *CB, PARTITIONING *P,
+    double *weight, llong error, int iter);
+
+/* State of one run. Output, User, Metrics, Trajectory, Weights,
+   Solution, Period and the checkpoint fields may be set after
+   CreateDenRSContext; Error and Iterations are the results (Iterations
+   counts a resumed run from its start); the rest is private. With
+   Checkpoint, the state of the run is written to that file every
+   Interval iterations (see DENCKPT.H); with Resume, a run continues
+   from the file if it exists and gives the same solution and progress
+   monitor statistics as the uninterrupted run. With Deadline, the run
+   stops at that wall time (see WallClock) instead of TimeLimit after
+   its start. */
+typedef struct
+  {
+  DENRSOPTIONS  Options;
+  DENRSOUTPUT   Output;         /* NULL = no messages                 */
+  void         *User;
+  RUNSTATS     *Metrics;        /* may be NULL                        */
+  TRAJECTORY   *Trajectory;     /* may be NULL                        */
+  double       *Weights;        /* final weights (may be NULL)        */
+  DENRSSOLUTION Solution;       /* NULL = no intermediate solutions   */
+  double        Period;         /* seconds between Solution calls     */
+  char         *Checkpoint;     /* checkpoint file, NULL = none       */
+  int           Interval;       /* iterations between checkpoints     */
+  int           Resume;         /* continue from the checkpoint       */
+  double        Deadline;       /* end of the job, 0 = from TimeLimit */
+  llong         Error;          /* final objective function value     */
+  int           Iterations;     /* swap iterations done               */
+  RANDOMSTATE   Random;
+  RANDOMSTATE  *rng;            /* &Random, or NULL for random.c      */
+  double        prevImpr;       /* state of the automatic stop        */
+  int           prevIter;
+  double        Start;          /* wall clock at the start of the run */
+  } DENRSCONTEXT;
+
+/* Spread of the final errors (MSE) of RunDenRSRepeats. */
+typedef struct
+  {
+  int        Repeats;
+  int        Succeeded;         /* repeats that completed             */
+  int        Best;              /* repeat of the solution returned    */
+  llong      Seed;              /* seed of the best repeat            */
+  double     MinError;
+  double     MaxError;
+  double     MeanError;
+  double     StdError;          /* standard deviation                 */
+  } REPEATSTATS;
+
+void          DefaultDenRSOptions(DENRSOPTIONS *options);
+DENRSCONTEXT* CreateDenRSContext(DENRSOPTIONS *options);
+int           RunDenRS(DENRSCONTEXT *ctx, TRAININGSET *pTS, CODEBOOK *pCB,
+    PARTITIONING *pP, int useInitialCB);
+void          FreeDenRSContext(DENRSCONTEXT *ctx);
+
+/* Wall time at which the runs of ctx stop: Deadline, or TimeLimit
+   from now (0 = no limit). */
+double        DenRSDeadline(DENRSCONTEXT *ctx);
+
+/* Best of repeats independent runs; errors may be NULL. */
+int RunDenRSRepeats(DENRSCONTEXT *ctx, TRAININGSET *pTS, CODEBOOK *pCB,
+    PARTITIONING *pP, int useInitialCB, int repeats, double *errors,
+    REPEATSTATS *stats);
+
 int PerformDenRS(TRAININGSET *pTS, CODEBOOK *pCB, PARTITIONING *pP, int iter, 
     int kmIter, int deterministic, int quietLevel, 
-    int useInitialCB, int monitoring);
+    int useInitialCB, int monitoring, int threads, int trials, int bounded,
+    int indexed, RUNSTATS *metrics, TRAJECTORY *trajectory);
 
-void SelectRandomRepresentatives(TRAININGSET *pTS, CODEBOOK *pCB);
+void SelectRandomRepresentatives(TRAININGSET *pTS, CODEBOOK *pCB,
+    RANDOMSTATE *rng);
+
+/* Random integer 0..n-1 and number in [0,1); rng NULL = random.c. */
+int    RandomIndex(RANDOMSTATE *rng, int n);
+double RandomUniform(RANDOMSTATE *rng);
 
 void CalculateDistances(TRAININGSET *pTS, CODEBOOK *pCB, PARTITIONING *pP,
-    llong *distance);
+    llong *distance, double *weight, int threads);
 
 void OptimalRepresentatives(PARTITIONING *pP, TRAININGSET *pTS, CODEBOOK *pCB, 
-    int *active, llong *cdist, int *activeCount);
+    int *active, llong *cdist, int *activeCount, TRIALLOG *log,
+    WORKSPACE *W);
+
+/* threads must not exceed the threads W was created for. The second
+   nearest centroids attached to log (may be NULL) are kept up to date.
+   Messages go to ctx (may be NULL for none). */
+void OptimalPartition(DENRSCONTEXT *ctx, CODEBOOK *pCB, TRAININGSET *pTS,
+    PARTITIONING *pP, int *active, llong *cdist, int activeCount,
+    llong *distance, double *weight, int quietLevel, int threads,
+    TRIALLOG *log, WORKSPACE *W);
+
+/* Cluster whose removal increases the objective function least, from
+   the sums of the last OptimalPartition with W if it kept the second
+   nearest centroids of log, otherwise from every vector. */
+int SelectClusterToBeSwapped(TRAININGSET *pTS, CODEBOOK *pCB,
+    PARTITIONING *pP, llong *distance, double *weight, TRIALLOG *log,
+    WORKSPACE *W);
+
+/* Reference search of the weighted nearest centroid; order is the
+   dimension order of the partial distances (may be NULL). */
+int FindNearestVectorWithWeight(BOOKNODE* v, CODEBOOK* CB, llong* error,
+    int guess, DISTANCETYPE disttype, double* weight, int *order);
+
+void CalculateNewWeights(TRAININGSET* TS, CODEBOOK* CB, PARTITIONING* P,
+    double *tempweight, TRIALLOG *log, WORKSPACE *W);
 
-void OptimalPartition(CODEBOOK *pCB, TRAININGSET *pTS, PARTITIONING *pP,
-    int *active, llong *cdist, int activeCount, llong *distance);
+llong ObjectiveFunction(PARTITIONING *pP, CODEBOOK *pCB, TRAININGSET *pTS,
+    double *weight, WORKSPACE *W);
 
+int   DefaultThreads(void);
 char* DenRSInfo(void);
 
 #endif /* __DENRS_H */
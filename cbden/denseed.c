@@ -0,0 +1,293 @@
+/*--------------------------------------------------------------------*/
+/* DENSEED.C       agent                                              */
+/*                                                                    */
+/* Initial centroids for the density-based random swap. K-means++     */
+/* picks each centroid with a chance proportional to the squared      */
+/* distance to the nearest centroid chosen so far (D^2 sampling), so  */
+/* the start already covers the clusters and the swaps have less to   */
+/* fix. Biasing the chance by the local density (cell counts of the   */
+/* grid index) also gives the small dense clusters nested inside      */
+/* sparse ones a centroid. Duplicate centroids are rejected with a    */
+/* hash set of the chosen vectors.                                    */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.02: 17.10.26 AG: Moving centroids; too few distinct vectors.     */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "cb.h"
+#include "interfc.h"
+#include "denutil.h"
+#include "denkern.h"
+#include "denwork.h"
+#include "dentrial.h"
+#include "denstats.h"
+#include "dentraj.h"
+#include "denindex.h"
+#include "denrs.h"
+#include "denseed.h"
+
+
+/* ========================== PROTOTYPES ============================= */
+
+static unsigned int HashVector(VECTORELEMENT *v, int dim);
+static int          SampleVector(double *sum, int blocks, llong *dist,
+                    double *bias, int N, RANDOMSTATE *rng);
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+int SeedPlusPlus(TRAININGSET *pTS, CODEBOOK *pCB, int density,
+RANDOMSTATE *rng, int threads)
+{
+  VECTORHASH  H;
+  GRIDINDEX   G;
+  llong      *dist;
+  double     *bias, *sum;
+  int         N = BookSize(pTS), blocks, b, i, j, x;
+
+  /* the search for a new vector below would never end */
+  if (CountDistinct(pTS, BookSize(pCB)) < BookSize(pCB))  return 1;
+
+  blocks = (N + SEED_BLOCK - 1) / SEED_BLOCK;
+  dist   = (llong*) DenAlloc(N * sizeof(llong));
+  bias   = (double*) DenAlloc(N * sizeof(double));
+  sum    = (double*) DenAlloc(blocks * sizeof(double));
+
+  if (density)
+    {
+    CreateGridIndex(&G, pTS);
+    GridDensity(&G, bias);
+    FreeGridIndex(&G);
+    }
+  for (i = 0; i < N; i++)
+    {
+    bias[i] = (density ? bias[i] : 1.0) * VectorFreq(pTS, i);
+    dist[i] = MAXLLONG;
+    }
+  CreateVectorHash(&H, pCB, BookSize(pCB));
+
+  for (j = 0; j < BookSize(pCB); j++)
+    {
+    x = (j > 0) ? SampleVector(sum, blocks, dist, bias, N, rng) : -1;
+
+    /* first centroid, or no distance left: uniformly random */
+    while (x < 0 || FindVector(&H, Vector(pTS, x)) >= 0)
+      {
+      x = RandomIndex(rng, N);
+      }
+    CopyVector(Vector(pTS, x), Vector(pCB, j), VectorSize(pCB));
+    VectorFreq(pCB, j) = 0;
+    AddVector(&H, j);
+    if (j == BookSize(pCB) - 1)  break;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) num_threads(threads) if (threads > 1)
+#endif
+    for (b = 0; b < blocks; b++)
+      {
+      int    n, hi = (b + 1) * SEED_BLOCK;
+      llong  d;
+      double s = 0.0;
+
+      if (hi > N)  hi = N;
+      for (n = b * SEED_BLOCK; n < hi; n++)
+        {
+        d = VectorDistance(Vector(pTS, n), Vector(pCB, j), VectorSize(pTS),
+                           dist[n], EUCLIDEANSQ);
+        if (d < dist[n])  dist[n] = d;
+        s += (double) dist[n] * bias[n];
+        }
+      sum[b] = s;
+      }
+    }
+
+  FreeVectorHash(&H);
+  free(dist);
+  free(bias);
+  free(sum);
+  return 0;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Vector chosen with a chance of dist[i]*bias[i]; -1 if all are 0.  */
+/*-------------------------------------------------------------------*/
+
+
+static int SampleVector(double *sum, int blocks, llong *dist,
+double *bias, int N, RANDOMSTATE *rng)
+{
+  double total = 0.0, r, w;
+  int    b, i, hi, last = -1;
+
+  for (b = 0; b < blocks; b++)  total += sum[b];
+  if (total <= 0.0)  return -1;
+
+  r = RandomUniform(rng) * total;
+  for (b = 0; b < blocks - 1 && r >= sum[b]; b++)
+    {
+    r -= sum[b];
+    }
+
+  hi = (b + 1) * SEED_BLOCK;
+  if (hi > N)  hi = N;
+  for (i = b * SEED_BLOCK; i < hi; i++)
+    {
+    w = (double) dist[i] * bias[i];
+    if (w <= 0.0)  continue;
+    if (r < w)  return i;
+    r   -= w;
+    last = i;
+    }
+  /* rounding left r past the block */
+  return last;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void CreateVectorHash(VECTORHASH *H, CODEBOOK *CB, int capacity)
+{
+  int size = 16, i;
+
+  while (size < 2 * capacity)  size *= 2;
+  H->CB   = CB;
+  H->Mask = size - 1;
+  H->slot = (int*) DenAlloc(size * sizeof(int));
+  H->key  = (unsigned*) DenAlloc(BookSize(CB) * sizeof(unsigned));
+  for (i = 0; i < size; i++)  H->slot[i] = -1;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void FreeVectorHash(VECTORHASH *H)
+{
+  free(H->slot);
+  free(H->key);
+  memset(H, 0, sizeof(VECTORHASH));
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Centroid equal to v, or -1.                                       */
+/*-------------------------------------------------------------------*/
+
+
+int FindVector(VECTORHASH *H, VECTORELEMENT *v)
+{
+  int dim = VectorSize(H->CB);
+  int s   = HashVector(v, dim) & H->Mask;
+
+  for (; H->slot[s] >= 0; s = (s + 1) & H->Mask)
+    {
+    if (EqualVectors(Vector(H->CB, H->slot[s]), v, dim))
+      {
+      return H->slot[s];
+      }
+    }
+  return -1;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* The set must have room (at most capacity centroids).              */
+/*-------------------------------------------------------------------*/
+
+
+void AddVector(VECTORHASH *H, int j)
+{
+  int s;
+
+  H->key[j] = HashVector(Vector(H->CB, j), VectorSize(H->CB));
+  s         = H->key[j] & H->Mask;
+  while (H->slot[s] >= 0)  s = (s + 1) & H->Mask;
+  H->slot[s] = j;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Rehashes centroid j (in the set) after it has moved. The entries  */
+/* after its old slot are shifted back, so no probe chain breaks.    */
+/*-------------------------------------------------------------------*/
+
+
+void UpdateVector(VECTORHASH *H, int j)
+{
+  int s, t, home;
+
+  s = H->key[j] & H->Mask;
+  while (H->slot[s] != j)  s = (s + 1) & H->Mask;
+  H->slot[s] = -1;
+
+  for (t = (s + 1) & H->Mask; H->slot[t] >= 0; t = (t + 1) & H->Mask)
+    {
+    /* an entry may fill the gap if its home is not within (s, t] */
+    home = H->key[H->slot[t]] & H->Mask;
+    if ((s <= t) ? (home <= s || home > t) : (home <= s && home > t))
+      {
+      H->slot[s] = H->slot[t];
+      H->slot[t] = -1;
+      s          = t;
+      }
+    }
+
+  AddVector(H, j);
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+int CountDistinct(TRAININGSET *TS, int limit)
+{
+  VECTORHASH H;
+  int        i, count = 0;
+
+  CreateVectorHash(&H, TS, limit);
+  for (i = 0; i < BookSize(TS) && count < limit; i++)
+    {
+    if (FindVector(&H, Vector(TS, i)) < 0)
+      {
+      AddVector(&H, i);
+      count++;
+      }
+    }
+  FreeVectorHash(&H);
+  return count;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* FNV-1a over the elements.                                         */
+/*-------------------------------------------------------------------*/
+
+
+static unsigned int HashVector(VECTORELEMENT *v, int dim)
+{
+  unsigned int h = 2166136261U;
+  int          d;
+
+  for (d = 0; d < dim; d++)
+    {
+    h = (h ^ (unsigned int) v[d]) * 16777619U;
+    }
+  return h ^ (h >> 16);
+}
+
+
+/*-------------------------------------------------------------------*/
@@ -0,0 +1,41 @@
+#if ! defined(__DENSEED_H)
+#define __DENSEED_H
+
+/* Initial centroids of a run (DENRSOPTIONS.Seeding). */
+#define SEED_RANDOM       0     /* uniformly random vectors           */
+#define SEED_PLUSPLUS     1     /* K-means++ (D^2 sampling)           */
+#define SEED_DENSITY      2     /* K-means++ biased by local density  */
+
+/* Vectors per block of the sampling sums; fixed, so the sums and the
+   choices do not depend on the threads. */
+#define SEED_BLOCK        4096
+
+/* Open addressing hash set of the centroids of CB, for rejecting
+   duplicate vectors in constant time. Slots hold centroid indices,
+   -1 when free. A centroid that moves is rehashed with UpdateVector;
+   key keeps the hash it was added with, so it can be found. */
+typedef struct
+  {
+  CODEBOOK  *CB;
+  int        Mask;              /* slots - 1 (slots a power of two)   */
+  int       *slot;
+  unsigned  *key;               /* hash of each centroid added        */
+  } VECTORHASH;
+
+void CreateVectorHash(VECTORHASH *H, CODEBOOK *CB, int capacity);
+void FreeVectorHash(VECTORHASH *H);
+int  FindVector(VECTORHASH *H, VECTORELEMENT *v);
+void AddVector(VECTORHASH *H, int j);
+void UpdateVector(VECTORHASH *H, int j);
+
+/* Number of distinct vectors in TS, counted up to limit. */
+int  CountDistinct(TRAININGSET *TS, int limit);
+
+/* Chooses the centroids of pCB by K-means++; with density, the chance
+   of a vector is also multiplied by its local density. Returns 1 (and
+   leaves pCB as it was) if pTS has fewer distinct vectors than pCB
+   has centroids, 0 otherwise. */
+int  SeedPlusPlus(TRAININGSET *pTS, CODEBOOK *pCB, int density,
+    RANDOMSTATE *rng, int threads);
+
+#endif /* __DENSEED_H */
@@ -0,0 +1,215 @@
+/*--------------------------------------------------------------------*/
+/* DENSTATS.C      agent                                              */
+/*                                                                    */
+/* Per-phase metrics of the density-based random swap. Each trial     */
+/* measures the wall time, distance evaluations and moved vectors of  */
+/* its phases (swap, local repartition, K-means, weight update,       */
+/* objective function). After each swap iteration one record is       */
+/* written to a CSV or JSON file. When no file is given, the trials   */
+/* have no statistics and the phase calls return at once.             */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "cb.h"
+#include "interfc.h"
+#include "dentrial.h"
+#include "denstats.h"
+
+
+/* ========================== PROTOTYPES ============================= */
+
+static char *PhaseName[STATS_PHASES] =
+  { "swap", "repartition", "kmeans", "weights", "objective" };
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+void OpenRunStats(RUNSTATS *R, char *name, int format)
+{
+  int p;
+
+  memset(R, 0, sizeof(RUNSTATS));
+  R->Format = format;
+  R->Start  = WallClock();
+  if (format == STATS_NONE)  return;
+
+  R->File = fopen(name, "w");
+  if (!R->File)
+    {
+    ErrorMessage("ERROR: Cannot open metrics file %s!\n", name);
+    ExitProcessing(FATAL_ERROR);
+    }
+
+  if (format == STATS_CSV)
+    {
+    fprintf(R->File, "iteration,trials,accepted,error,new_error,delta,"
+            "time,active");
+    for (p = 0; p < STATS_PHASES; p++)
+      {
+      fprintf(R->File, ",%s_time,%s_distances,%s_moves", PhaseName[p],
+              PhaseName[p], PhaseName[p]);
+      }
+    fprintf(R->File, "\n");
+    }
+  else
+    {
+    fprintf(R->File, "[\n");
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void CloseRunStats(RUNSTATS *R)
+{
+  if (R->File == NULL)  return;
+
+  if (R->Format == STATS_JSON)  fprintf(R->File, "\n]\n");
+  fclose(R->File);
+  R->File = NULL;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Writes the record of iterations iter .. iter+trials-1. accepted   */
+/* is the accepted iteration or 0; error is the objective before the */
+/* iteration and newError that of the best trial. T holds the sums   */
+/* over the trials.                                                  */
+/*-------------------------------------------------------------------*/
+
+
+void WriteIterationStats(RUNSTATS *R, int iter, int trials, int accepted,
+llong error, llong newError, TRIALSTATS *T)
+{
+  double now;
+  int    p;
+
+  if (R == NULL || R->File == NULL)  return;
+
+  now = WallClock();
+  if (R->Format == STATS_CSV)
+    {
+    fprintf(R->File, "%i,%i,%i,%lld,%lld,%lld,%.6f,%lld", iter, trials,
+            accepted, error, newError, newError - error, now - R->Start,
+            T->Active);
+    for (p = 0; p < STATS_PHASES; p++)
+      {
+      fprintf(R->File, ",%.6f,%lld,%lld", T->Phase[p].Time,
+              T->Phase[p].Distances, T->Phase[p].Moves);
+      }
+    fprintf(R->File, "\n");
+    }
+  else
+    {
+    fprintf(R->File, "%s  {\"iteration\": %i, \"trials\": %i, "
+            "\"accepted\": %i, \"error\": %lld, \"new_error\": %lld, "
+            "\"delta\": %lld, \"time\": %.6f, \"active\": %lld, "
+            "\"phases\": {", (R->Records > 0) ? ",\n" : "", iter, trials,
+            accepted, error, newError, newError - error, now - R->Start,
+            T->Active);
+    for (p = 0; p < STATS_PHASES; p++)
+      {
+      fprintf(R->File, "%s\"%s\": {\"time\": %.6f, \"distances\": %lld, "
+              "\"moves\": %lld}", (p > 0) ? ", " : "", PhaseName[p],
+              T->Phase[p].Time, T->Phase[p].Distances, T->Phase[p].Moves);
+      }
+    fprintf(R->File, "}}");
+    }
+  R->Records++;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void ResetTrialStats(TRIALSTATS *T)
+{
+  if (T == NULL)  return;
+
+  memset(T, 0, sizeof(TRIALSTATS));
+  T->Current = -1;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void AddTrialStats(TRIALSTATS *sum, TRIALSTATS *T)
+{
+  int p;
+
+  for (p = 0; p < STATS_PHASES; p++)
+    {
+    sum->Phase[p].Time      += T->Phase[p].Time;
+    sum->Phase[p].Distances += T->Phase[p].Distances;
+    sum->Phase[p].Moves     += T->Phase[p].Moves;
+    }
+  sum->Active += T->Active;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Ends the current phase of the trial and starts phase.             */
+/*-------------------------------------------------------------------*/
+
+
+void BeginPhase(TRIALSTATS *T, TRIALLOG *log, int phase)
+{
+  if (T == NULL)  return;
+
+  EndPhase(T, log);
+  T->Current   = phase;
+  T->Started   = WallClock();
+  T->Distances = log->Distances;
+  T->Moves     = log->Moves;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void EndPhase(TRIALSTATS *T, TRIALLOG *log)
+{
+  PHASESTATS *P;
+
+  if (T == NULL || T->Current < 0)  return;
+
+  P             = &T->Phase[T->Current];
+  P->Time      += WallClock() - T->Started;
+  P->Distances += log->Distances - T->Distances;
+  P->Moves     += log->Moves - T->Moves;
+  T->Current    = -1;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Wall time in seconds (processor time without OpenMP).             */
+/*-------------------------------------------------------------------*/
+
+
+double WallClock(void)
+{
+#ifdef _OPENMP
+  return omp_get_wtime();
+#else
+  return (double) clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+
+/*-------------------------------------------------------------------*/
@@ -0,0 +1,57 @@
+#if ! defined(__DENSTATS_H)
+#define __DENSTATS_H
+
+/* Phases of a swap trial. */
+#define STATS_SWAP          0
+#define STATS_REPARTITION   1
+#define STATS_KMEANS        2
+#define STATS_WEIGHTS       3
+#define STATS_OBJECTIVE     4
+#define STATS_PHASES        5
+
+/* Output formats of the metrics file. */
+#define STATS_NONE          0
+#define STATS_CSV           1
+#define STATS_JSON          2
+
+typedef struct
+  {
+  double   Time;              /* wall time (s)                        */
+  llong    Distances;         /* distance evaluations                 */
+  llong    Moves;             /* vectors moved to another cluster     */
+  } PHASESTATS;
+
+/* Counters of one trial. The distance and move counters are kept by
+   the trial log; a phase gets the difference between its start and
+   end. Current is -1 when no phase is being measured. */
+typedef struct
+  {
+  PHASESTATS Phase[STATS_PHASES];
+  llong      Active;          /* active clusters over K-means iters   */
+  int        Current;
+  double     Started;
+  llong      Distances;
+  llong      Moves;
+  } TRIALSTATS;
+
+/* Metrics file of a run: one record per swap iteration (a round of
+   parallel trials counts as one iteration). */
+typedef struct
+  {
+  FILE      *File;
+  int        Format;
+  int        Records;
+  double     Start;
+  } RUNSTATS;
+
+void   OpenRunStats(RUNSTATS *R, char *name, int format);
+void   CloseRunStats(RUNSTATS *R);
+void   WriteIterationStats(RUNSTATS *R, int iter, int trials, int accepted,
+    llong error, llong newError, TRIALSTATS *T);
+void   ResetTrialStats(TRIALSTATS *T);
+void   AddTrialStats(TRIALSTATS *sum, TRIALSTATS *T);
+void   BeginPhase(TRIALSTATS *T, TRIALLOG *log, int phase);
+void   EndPhase(TRIALSTATS *T, TRIALLOG *log);
+double WallClock(void);
+
+#endif /* __DENSTATS_H */
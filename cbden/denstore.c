@@ -0,0 +1,192 @@
+/*--------------------------------------------------------------------*/
+/* DENSTORE.C      agent                                              */
+/*                                                                    */
+/* Contiguous vector storage for the density-based random swap. The   */
+/* toolkit allocates every vector separately, so the distance loops   */
+/* chase pointers to scattered, unaligned memory. Attaching a store   */
+/* moves the vectors of a training set or codebook into one aligned   */
+/* block (huge pages when large) and points the nodes into it; the    */
+/* original vectors are restored when the store is detached.          */
+/* DimensionOrder() lists the dimensions by decreasing variance for   */
+/* the partial distance searches.                                     */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.03: 17.10.26 AG: Dimension order for partial distances.          */
+/* 0.02: 17.10.26 AG: Stores attached again are used in place.        */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "cb.h"
+#include "interfc.h"
+#include "denstore.h"
+
+
+/* ========================== PROTOTYPES ============================= */
+
+static int IsContiguous(CODEBOOK *CB, int stride);
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+/*-------------------------------------------------------------------*/
+/* Rows are padded to STORE_ALIGN when that adds at most a quarter   */
+/* to their size; short vectors are packed back to back.             */
+/*-------------------------------------------------------------------*/
+
+
+void AttachDenseStore(DENSESTORE *S, CODEBOOK *CB, int writeBack)
+{
+  int    i, row = STORE_ALIGN / sizeof(VECTORELEMENT);
+  size_t bytes, align = STORE_ALIGN;
+  void  *p = NULL;
+
+  memset(S, 0, sizeof(DENSESTORE));
+  S->Count     = BookSize(CB);
+  S->Dim       = VectorSize(CB);
+  S->Stride    = (S->Dim + row - 1) / row * row;
+  S->WriteBack = writeBack;
+  if ((S->Stride - S->Dim) * 4 > S->Dim)  S->Stride = S->Dim;
+
+  if (S->Count < 1)  return;
+
+  /* also a set already attached, which is then not written to */
+  if (IsContiguous(CB, S->Stride))
+    {
+    S->Data = Vector(CB, 0);
+    return;
+    }
+
+  bytes = (size_t) S->Count * S->Stride * sizeof(VECTORELEMENT);
+  if (bytes >= STORE_HUGEPAGE)  align = STORE_HUGEPAGE;
+  if (posix_memalign(&p, align, bytes) != 0)
+    {
+    ErrorMessage("ERROR: Allocating memory failed!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
+#ifdef MADV_HUGEPAGE
+  if (align == STORE_HUGEPAGE)  madvise(p, bytes, MADV_HUGEPAGE);
+#endif
+
+  S->Data  = (VECTORELEMENT*) p;
+  S->Saved = (VECTORTYPE*) malloc(S->Count * sizeof(VECTORTYPE));
+  if (!S->Saved)
+    {
+    ErrorMessage("ERROR: Allocating memory failed!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
+  memset(S->Data, 0, bytes);
+
+  for (i = 0; i < S->Count; i++)
+    {
+    S->Saved[i] = Vector(CB, i);
+    memcpy(DenseVector(S, i), Vector(CB, i), S->Dim * sizeof(VECTORELEMENT));
+    Vector(CB, i) = DenseVector(S, i);
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Must be called before CB is freed or resized.                     */
+/*-------------------------------------------------------------------*/
+
+
+void DetachDenseStore(DENSESTORE *S, CODEBOOK *CB)
+{
+  int i;
+
+  if (S->Saved != NULL)
+    {
+    for (i = 0; i < S->Count; i++)
+      {
+      if (S->WriteBack)
+        {
+        memcpy(S->Saved[i], Vector(CB, i), S->Dim * sizeof(VECTORELEMENT));
+        }
+      Vector(CB, i) = S->Saved[i];
+      }
+    free(S->Saved);
+    free(S->Data);
+    }
+  memset(S, 0, sizeof(DENSESTORE));
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+static int IsContiguous(CODEBOOK *CB, int stride)
+{
+  int i;
+
+  if ((size_t) Vector(CB, 0) % STORE_ALIGN != 0)  return 0;
+  for (i = 1; i < BookSize(CB); i++)
+    {
+    if (Vector(CB, i) != Vector(CB, 0) + (size_t) i * stride)
+      {
+      return 0;
+      }
+    }
+  return 1;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Dimensions of TS by decreasing variance (ties by index). Summing  */
+/* the high-variance dimensions first lets a partial distance exceed */
+/* its limit after few dimensions.                                   */
+/*-------------------------------------------------------------------*/
+
+
+void DimensionOrder(TRAININGSET *TS, int *order)
+{
+  double *sum, *var, mean, v;
+  llong   total = 0;
+  int     dim = VectorSize(TS), i, d, e;
+
+  sum = (double*) calloc(2 * dim, sizeof(double));
+  if (!sum)
+    {
+    ErrorMessage("ERROR: Allocating memory failed!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
+  var = sum + dim;
+
+  for (i = 0; i < BookSize(TS); i++)
+    {
+    total += VectorFreq(TS, i);
+    for (d = 0; d < dim; d++)
+      {
+      v       = (double) VectorScalar(TS, i, d);
+      sum[d] += VectorFreq(TS, i) * v;
+      var[d] += VectorFreq(TS, i) * v * v;
+      }
+    }
+  for (d = 0; d < dim; d++)
+    {
+    mean   = (total > 0) ? sum[d] / total : 0.0;
+    var[d] = (total > 0) ? var[d] / total - mean * mean : 0.0;
+    }
+
+  /* insertion sort; dimensions are few */
+  for (d = 0; d < dim; d++)
+    {
+    for (e = d; e > 0 && var[order[e-1]] < var[d]; e--)
+      {
+      order[e] = order[e-1];
+      }
+    order[e] = d;
+    }
+  free(sum);
+}
+
+
+/*-------------------------------------------------------------------*/
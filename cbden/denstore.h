@@ -0,0 +1,99 @@
+#if ! defined(__DENSTORE_H)
+#define __DENSTORE_H
+
+/* Alignment of the block and of padded rows (bytes). */
+#define STORE_ALIGN       64
+/* Blocks of at least this size are aligned for huge pages. */
+#define STORE_HUGEPAGE    (2 << 20)
+
+/* Dense storage of a training set or codebook. The vectors are moved
+   into one aligned block, row by row (Stride elements apart), and the
+   nodes point into it, so Vector() and the toolkit routines work as
+   before. Saved keeps the original vectors until the store is
+   detached. A set that is already contiguous (e.g. mapped, or
+   attached by an outer store) is used in place and Saved is NULL. */
+typedef struct
+  {
+  VECTORELEMENT  *Data;
+  VECTORTYPE     *Saved;
+  int             Count;
+  int             Dim;
+  int             Stride;
+  int             WriteBack;     /* copy the vectors back on detach   */
+  } DENSESTORE;
+
+#define DenseVector(S,i)  ((S)->Data + (size_t) (i) * (S)->Stride)
+
+void AttachDenseStore(DENSESTORE *S, CODEBOOK *CB, int writeBack);
+void DetachDenseStore(DENSESTORE *S, CODEBOOK *CB);
+
+/* Squared Euclidean distance; the same value as VectorDistance() with
+   MAXLLONG and EUCLIDEANSQ, but without the early exit, so the loop
+   can be vectorized. */
+static inline llong DenseDistance(const VECTORELEMENT *a,
+const VECTORELEMENT *b, int dim)
+{
+  llong sum = 0, diff;
+  int   d;
+
+  for (d = 0; d < dim; d++)
+    {
+    diff = (llong) a[d] - b[d];
+    sum += diff * diff;
+    }
+  return sum;
+}
+
+/* Dimensions summed between the checks of PartialDistance(). */
+#define PARTIAL_STEP      4
+
+/* Squared Euclidean distance summed over the dimensions in the given
+   order (NULL = natural order), stopping once the sum exceeds limit.
+   The result is exact if it is at most limit; otherwise it is only
+   known to be above limit. */
+static inline llong PartialDistance(const VECTORELEMENT *a,
+const VECTORELEMENT *b, const int *order, int dim, llong limit)
+{
+  llong sum = 0, diff;
+  int   d, e, end;
+
+  for (d = 0; d < dim; d = end)
+    {
+    end = (d + PARTIAL_STEP < dim) ? d + PARTIAL_STEP : dim;
+    if (order != NULL)
+      {
+      for (e = d; e < end; e++)
+        {
+        diff = (llong) a[order[e]] - b[order[e]];
+        sum += diff * diff;
+        }
+      }
+    else
+      {
+      for (e = d; e < end; e++)
+        {
+        diff = (llong) a[e] - b[e];
+        sum += diff * diff;
+        }
+      }
+    if (sum > limit)  break;
+    }
+  return sum;
+}
+
+/* Largest squared distance d for which the weighted distance
+   (llong) (w * sqrt(d)) can still be below best; a partial sum above
+   it rules the centroid out. MAXLLONG when nothing can be ruled out. */
+static inline llong WeightedLimit(llong best, double w)
+{
+  double b;
+
+  if (best == MAXLLONG || !(w > 0.0) || !isfinite(w))  return MAXLLONG;
+  b = (double) best / w;
+  b = b * b * (1.0 + 1e-9) + 1.0;
+  return (b < (double) MAXLLONG) ? (llong) b : MAXLLONG;
+}
+
+void DimensionOrder(TRAININGSET *TS, int *order);
+
+#endif /* __DENSTORE_H */
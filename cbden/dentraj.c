@@ -0,0 +1,350 @@
+/*--------------------------------------------------------------------*/
+/* DENTRAJ.C       agent                                              */
+/*                                                                    */
+/* Trajectory of the density-based random swap. The initial solution  */
+/* and every accepted swap are appended to a binary file as a record  */
+/* of what changed: the swapped centroid, the centroids that moved,   */
+/* the weights, the vectors that changed partition (gap encoded) and  */
+/* the error. The changes are read from the undo log of the accepted  */
+/* trial, so a record costs time proportional to the change. A reader */
+/* applies the records in order to rebuild the solution at any        */
+/* iteration (see CBDENTRAJ.C).                                       */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.02: 17.10.26 AG: Iteration of the state a resume starts from.    */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+/* Longest LEB128 encoding of an unsigned int. */
+#define TRAJ_MAXNUMBER  5
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cb.h"
+#include "interfc.h"
+#include "denutil.h"
+#include "dentrial.h"
+#include "dentraj.h"
+
+
+/* ========================== PROTOTYPES ============================= */
+
+static size_t PutNumber(unsigned char *p, unsigned int x);
+static size_t GetNumber(unsigned char *p, unsigned char *end,
+    unsigned int *x);
+static void   WriteRecord(TRAJECTORY *T, TRAJRECORD *R, CODEBOOK *CB,
+    PARTITIONING *P, double *weight);
+static void   TrajError(char *message, char *name);
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+/*-------------------------------------------------------------------*/
+/* name == NULL gives a writer that writes nothing.                  */
+/*-------------------------------------------------------------------*/
+
+
+void OpenTrajectory(TRAJECTORY *T, char *name, TRAININGSET *TS,
+CODEBOOK *CB)
+{
+  memset(T, 0, sizeof(TRAJECTORY));
+  if (name == NULL)  return;
+
+  memcpy(T->Header.Magic, TRAJ_MAGIC, 4);
+  T->Header.Version = TRAJ_VERSION;
+  T->Header.Endian  = TRAJ_ENDIAN;
+  T->Header.N       = BookSize(TS);
+  T->Header.Size    = BookSize(CB);
+  T->Header.Dim     = VectorSize(CB);
+
+  T->changed    = (int*) DenAlloc(BookSize(TS) * sizeof(int));
+  T->cent       = (int*) DenAlloc(BookSize(CB) * sizeof(int));
+  T->bufferSize = (size_t) BookSize(TS) * 2 * TRAJ_MAXNUMBER;
+  T->buffer     = (unsigned char*) DenAlloc(T->bufferSize);
+
+  T->File = fopen(name, "wb");
+  if (!T->File)  TrajError("Cannot open", name);
+  fwrite(&T->Header, sizeof(TRAJHEADER), 1, T->File);
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void CloseTrajectory(TRAJECTORY *T)
+{
+  if (T->File != NULL)
+    {
+    if (ferror(T->File) | fclose(T->File))
+      {
+      ErrorMessage("WARNING: Writing the trajectory file failed!\n");
+      }
+    }
+  free(T->changed);
+  free(T->cent);
+  free(T->buffer);
+  memset(T, 0, sizeof(TRAJECTORY));
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void WriteInitialState(TRAJECTORY *T, int iter, CODEBOOK *CB,
+PARTITIONING *P, double *weight, llong error)
+{
+  TRAJRECORD R;
+  int        i;
+
+  if (T == NULL || T->File == NULL)  return;
+
+  memset(&R, 0, sizeof(TRAJRECORD));
+  R.Iteration = iter;
+  R.Swapped   = -1;
+  R.Error     = error;
+  R.Centroids = T->Header.Size;
+  R.Moves     = T->Header.N;
+  for (i = 0; i < R.Centroids; i++)  T->cent[i] = i;
+  for (i = 0; i < R.Moves; i++)      T->changed[i] = i;
+
+  WriteRecord(T, &R, CB, P, weight);
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Writes the changes of the accepted trial. log is its undo log, so  */
+/* it lists every centroid and vector the trial touched; the ones     */
+/* that ended up with their original value are left out.              */
+/*-------------------------------------------------------------------*/
+
+
+void WriteAcceptedSwap(TRAJECTORY *T, int iter, int swapped, TRIALLOG *log,
+CODEBOOK *CB, PARTITIONING *P, double *weight, llong error)
+{
+  TRAJRECORD R;
+  int        n, i, j;
+
+  if (T == NULL || T->File == NULL)  return;
+
+  memset(&R, 0, sizeof(TRAJRECORD));
+  R.Iteration = iter;
+  R.Swapped   = swapped;
+  R.Error     = error;
+
+  for (n = 0; n < log->centCount; n++)
+    {
+    j = log->cent[n];
+    if (CompareVectors(Vector(CB, j), log->centOld + (size_t) n * log->Dim,
+                       log->Dim) != 0)
+      {
+      T->cent[R.Centroids++] = j;
+      }
+    }
+  qsort(T->cent, R.Centroids, sizeof(int), CompareInt);
+
+  for (n = 0; n < log->vecCount; n++)
+    {
+    i = log->vec[n];
+    if (Map(P, i) != log->mapOld[n])  T->changed[R.Moves++] = i;
+    }
+  qsort(T->changed, R.Moves, sizeof(int), CompareInt);
+
+  WriteRecord(T, &R, CB, P, weight);
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+static void WriteRecord(TRAJECTORY *T, TRAJRECORD *R, CODEBOOK *CB,
+PARTITIONING *P, double *weight)
+{
+  size_t bytes = 0;
+  int    n, i, prev = -1;
+
+  for (n = 0; n < R->Moves; n++)
+    {
+    i      = T->changed[n];
+    bytes += PutNumber(T->buffer + bytes, (unsigned int) (i - prev));
+    bytes += PutNumber(T->buffer + bytes, (unsigned int) Map(P, i));
+    prev   = i;
+    }
+  R->Bytes = (int) bytes;
+
+  fwrite(R, sizeof(TRAJRECORD), 1, T->File);
+  for (n = 0; n < R->Centroids; n++)
+    {
+    fwrite(&T->cent[n], sizeof(int), 1, T->File);
+    fwrite(Vector(CB, T->cent[n]), sizeof(VECTORELEMENT), T->Header.Dim,
+           T->File);
+    }
+  fwrite(weight, sizeof(double), T->Header.Size, T->File);
+  fwrite(T->buffer, 1, bytes, T->File);
+  T->Records++;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Opens a trajectory for reading; the state is allocated from its   */
+/* header and filled in by the records.                              */
+/*-------------------------------------------------------------------*/
+
+
+FILE* OpenTrajectoryState(char *name, TRAJSTATE *S)
+{
+  TRAJHEADER *H = &S->Header;
+  FILE       *f;
+
+  memset(S, 0, sizeof(TRAJSTATE));
+  f = fopen(name, "rb");
+  if (!f)  TrajError("Cannot open", name);
+
+  if (fread(H, sizeof(TRAJHEADER), 1, f) != 1 ||
+      memcmp(H->Magic, TRAJ_MAGIC, 4) != 0 || H->Version != TRAJ_VERSION)
+    {
+    TrajError("Unknown format version in", name);
+    }
+  if (H->Endian != TRAJ_ENDIAN)  TrajError("Wrong byte order in", name);
+  if (H->N < 1 || H->Size < 1 || H->Dim < 1)
+    {
+    TrajError("Inconsistent header in", name);
+    }
+
+  S->map        = (int*) DenAlloc(H->N * sizeof(int));
+  S->centroid   = (VECTORELEMENT*) DenAlloc((size_t) H->Size * H->Dim *
+                  sizeof(VECTORELEMENT));
+  S->weight     = (double*) DenAlloc(H->Size * sizeof(double));
+  S->bufferSize = (size_t) H->N * 2 * TRAJ_MAXNUMBER;
+  S->buffer     = (unsigned char*) DenAlloc(S->bufferSize);
+  S->Record.Iteration = -1;
+
+  return f;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Applies the next record to S. Returns 0 at the end of the file or */
+/* if the next record is after iteration limit (it is then left      */
+/* unread).                                                          */
+/*-------------------------------------------------------------------*/
+
+
+int ReadTrajectoryRecord(FILE *f, TRAJSTATE *S, int limit)
+{
+  TRAJHEADER    *H = &S->Header;
+  TRAJRECORD     R;
+  unsigned char *p, *end;
+  unsigned int   gap, to;
+  size_t         used;
+  int            n, i = -1, j, ok;
+
+  if (fread(&R, sizeof(TRAJRECORD), 1, f) != 1)  return 0;
+  if (R.Iteration > limit)
+    {
+    fseek(f, -(long) sizeof(TRAJRECORD), SEEK_CUR);
+    return 0;
+    }
+
+  ok = (R.Centroids >= 0 && R.Centroids <= H->Size && R.Moves >= 0 &&
+        R.Moves <= H->N && R.Bytes >= 0 && (size_t) R.Bytes <= S->bufferSize);
+  for (n = 0; ok && n < R.Centroids; n++)
+    {
+    ok = (fread(&j, sizeof(int), 1, f) == 1 && j >= 0 && j < H->Size &&
+          fread(S->centroid + (size_t) j * H->Dim, sizeof(VECTORELEMENT),
+                H->Dim, f) == (size_t) H->Dim);
+    }
+  ok = ok && fread(S->weight, sizeof(double), H->Size, f) == (size_t) H->Size;
+  ok = ok && fread(S->buffer, 1, R.Bytes, f) == (size_t) R.Bytes;
+
+  p   = S->buffer;
+  end = S->buffer + (ok ? R.Bytes : 0);
+  for (n = 0; ok && n < R.Moves; n++)
+    {
+    used = GetNumber(p, end, &gap);
+    p   += used;
+    ok   = (used > 0);
+    used = ok ? GetNumber(p, end, &to) : 0;
+    p   += used;
+    i   += gap;
+    ok   = (used > 0 && gap > 0 && i < H->N && to < (unsigned int) H->Size);
+    if (ok)  S->map[i] = (int) to;
+    }
+
+  if (!ok)
+    {
+    ErrorMessage("ERROR: Corrupted trajectory record after iteration %i!\n",
+                 S->Record.Iteration);
+    ExitProcessing(FATAL_ERROR);
+    }
+
+  S->Record = R;
+  return 1;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void FreeTrajectoryState(TRAJSTATE *S)
+{
+  free(S->map);
+  free(S->centroid);
+  free(S->weight);
+  free(S->buffer);
+  memset(S, 0, sizeof(TRAJSTATE));
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+static size_t PutNumber(unsigned char *p, unsigned int x)
+{
+  size_t n = 0;
+
+  while (x >= 0x80)
+    {
+    p[n++] = (unsigned char) (x | 0x80);
+    x    >>= 7;
+    }
+  p[n++] = (unsigned char) x;
+  return n;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Returns the bytes used, 0 if the number is not complete.          */
+/*-------------------------------------------------------------------*/
+
+
+static size_t GetNumber(unsigned char *p, unsigned char *end,
+unsigned int *x)
+{
+  size_t n = 0;
+
+  *x = 0;
+  while (p + n < end && n < TRAJ_MAXNUMBER)
+    {
+    *x |= (unsigned int) (p[n] & 0x7F) << (7 * n);
+    if ((p[n++] & 0x80) == 0)  return n;
+    }
+  return 0;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+static void TrajError(char *message, char *name)
+{
+  ErrorMessage("ERROR: %s trajectory file %s!\n", message, name);
+  ExitProcessing(FATAL_ERROR);
+}
+
+
+/*-------------------------------------------------------------------*/
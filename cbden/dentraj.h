@@ -0,0 +1,75 @@
+#if ! defined(__DENTRAJ_H)
+#define __DENTRAJ_H
+
+#define TRAJ_MAGIC        "CBDT"
+#define TRAJ_VERSION      1
+#define TRAJ_ENDIAN       0x01020304
+
+/* Header of a trajectory file. Numbers are in the byte order of the
+   machine that wrote the file. */
+typedef struct
+  {
+  char       Magic[4];
+  int        Version;
+  int        Endian;
+  int        N;                 /* training set size                  */
+  int        Size;              /* codebook size                      */
+  int        Dim;               /* vector dimension                   */
+  } TRAJHEADER;
+
+/* Each record is a TRAJRECORD followed by Centroids x (int index, Dim
+   elements), Size double weights and Bytes bytes of partition changes.
+   The changes are pairs of unsigned LEB128 numbers: the gap to the
+   previous changed vector (the first gap counts from -1) and the new
+   partition. The first record (Swapped -1) holds the whole solution
+   the run starts from: Iteration 0, or the last iteration done before
+   the run was resumed. The others hold the changes of one accepted
+   iteration. */
+typedef struct
+  {
+  int        Iteration;
+  int        Swapped;           /* centroid swapped, -1 if none       */
+  llong      Error;
+  int        Centroids;         /* centroids in the record            */
+  int        Moves;             /* partition changes in the record    */
+  int        Bytes;             /* size of the encoded changes        */
+  int        Reserved;
+  } TRAJRECORD;
+
+/* Writer (file is NULL when no trajectory is written). */
+typedef struct
+  {
+  FILE          *File;
+  TRAJHEADER     Header;
+  int           *changed;       /* vectors whose partition changed    */
+  int           *cent;          /* centroids that changed             */
+  unsigned char *buffer;        /* encoded partition changes          */
+  size_t         bufferSize;
+  llong          Records;
+  } TRAJECTORY;
+
+/* Solution rebuilt by a reader. */
+typedef struct
+  {
+  TRAJHEADER     Header;
+  TRAJRECORD     Record;        /* last record applied                */
+  int           *map;           /* partition of each vector           */
+  VECTORELEMENT *centroid;      /* Size x Dim                         */
+  double        *weight;
+  unsigned char *buffer;
+  size_t         bufferSize;
+  } TRAJSTATE;
+
+void OpenTrajectory(TRAJECTORY *T, char *name, TRAININGSET *TS,
+    CODEBOOK *CB);
+void CloseTrajectory(TRAJECTORY *T);
+void WriteInitialState(TRAJECTORY *T, int iter, CODEBOOK *CB,
+    PARTITIONING *P, double *weight, llong error);
+void WriteAcceptedSwap(TRAJECTORY *T, int iter, int swapped, TRIALLOG *log,
+    CODEBOOK *CB, PARTITIONING *P, double *weight, llong error);
+
+FILE* OpenTrajectoryState(char *name, TRAJSTATE *S);
+int   ReadTrajectoryRecord(FILE *f, TRAJSTATE *S, int limit);
+void  FreeTrajectoryState(TRAJSTATE *S);
+
+#endif /* __DENTRAJ_H */
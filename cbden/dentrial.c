@@ -0,0 +1,752 @@
+/*--------------------------------------------------------------------*/
+/* DENTRIAL.C      agent                                              */
+/*                                                                    */
+/* Undo log for the trial solutions of the density-based random       */
+/* swap. Instead of copying the whole codebook and partitioning for   */
+/* every trial, the trial works on the solution itself and the log    */
+/* records what was changed. It also keeps the per-cluster sums       */
+/* from which the objective function of a trial is calculated.        */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.09: 17.10.26 AG: Undo of the second nearest centroids.           */
+/* 0.08: 17.10.26 AG: List of the moved centroids.                    */
+/* 0.07: 17.10.26 AG: Member lists updated with the moved vectors.    */
+/* 0.06: 17.10.26 AG: Distance and move counters.                     */
+/* 0.05: 17.10.26 AG: Contiguous cluster member lists.                */
+/* 0.04: 17.10.26 AG: Cluster radii; rollback restores the caches.    */
+/* 0.03: 17.10.26 AG: Cached cluster distances for the densities.     */
+/* 0.02: 17.10.26 AG: Per-cluster sums for the objective function.    */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "cb.h"
+#include "interfc.h"
+#include "denutil.h"
+#include "dentrial.h"
+
+
+/* ========================== PROTOTYPES ============================= */
+
+static void Relocate(TRIALLOG *log, TRAININGSET *TS, PARTITIONING *P,
+    int new, int i);
+static llong Distance(TRIALLOG *log, TRAININGSET *TS, int i, int j);
+static void SaveCluster(TRIALLOG *log, int j);
+static void BuildMembers(TRIALLOG *log, PARTITIONING *P);
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+void CreateTrialLog(TRIALLOG *log, TRAININGSET *TS, CODEBOOK *CB)
+{
+  memset(log, 0, sizeof(TRIALLOG));
+  log->N         = BookSize(TS);
+  log->Size      = BookSize(CB);
+  log->Dim       = VectorSize(CB);
+  log->centStamp = (int*) DenZeroAlloc(BookSize(CB) * sizeof(int));
+  log->cent      = (int*) DenZeroAlloc(BookSize(CB) * sizeof(int));
+  log->freqOld   = (int*) DenZeroAlloc(BookSize(CB) * sizeof(int));
+  log->centOld   = (VECTORELEMENT*) DenZeroAlloc((size_t) BookSize(CB) *
+                   VectorSize(CB) * sizeof(VECTORELEMENT));
+  log->vecStamp  = (int*) DenZeroAlloc(BookSize(TS) * sizeof(int));
+  log->count     = (llong*) DenZeroAlloc(BookSize(CB) * sizeof(llong));
+  log->sumsq     = (llong*) DenZeroAlloc(BookSize(CB) * sizeof(llong));
+  log->sum       = (llong*) DenZeroAlloc((size_t) BookSize(CB) *
+                   VectorSize(CB) * sizeof(llong));
+  log->dist      = (llong*) DenZeroAlloc(BookSize(CB) * sizeof(llong));
+  log->dirty     = (int*) DenZeroAlloc(BookSize(CB) * sizeof(int));
+  log->radius    = (llong*) DenZeroAlloc(BookSize(CB) * sizeof(llong));
+  log->clusStamp = (int*) DenZeroAlloc(BookSize(CB) * sizeof(int));
+  log->clus      = (int*) DenZeroAlloc(BookSize(CB) * sizeof(int));
+  log->distOld   = (llong*) DenZeroAlloc(BookSize(CB) * sizeof(llong));
+  log->radiusOld = (llong*) DenZeroAlloc(BookSize(CB) * sizeof(llong));
+  log->dirtyOld  = (int*) DenZeroAlloc(BookSize(CB) * sizeof(int));
+  log->start     = (int*) DenZeroAlloc((BookSize(CB) + 1) * sizeof(int));
+  log->member    = (int*) DenZeroAlloc(BookSize(TS) * sizeof(int));
+
+  /* vectors moved after the member lists were built */
+  log->moved       = (int*) DenZeroAlloc(BookSize(TS) * sizeof(int));
+  log->extraSize   = BookSize(TS) / MEMBER_EXTRA + 1;
+  log->extra       = (int*) DenZeroAlloc(log->extraSize * sizeof(int));
+  log->extraStart  = (int*) DenZeroAlloc((BookSize(CB) + 1) * sizeof(int));
+  log->extraMember = (int*) DenZeroAlloc(log->extraSize * sizeof(int));
+
+  /* centroids moved since ChangedCentroids() */
+  log->changedFlag = (int*) DenZeroAlloc(BookSize(CB) * sizeof(int));
+  log->changed     = (int*) DenZeroAlloc(BookSize(CB) * sizeof(int));
+
+  /* second nearest centroids are not kept until attached */
+  log->secondMoved = -1;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void FreeTrialLog(TRIALLOG *log)
+{
+  free(log->centStamp);
+  free(log->cent);
+  free(log->freqOld);
+  free(log->centOld);
+  free(log->vecStamp);
+  free(log->vec);
+  free(log->mapOld);
+  free(log->count);
+  free(log->sum);
+  free(log->sumsq);
+  free(log->dist);
+  free(log->dirty);
+  free(log->radius);
+  free(log->clusStamp);
+  free(log->clus);
+  free(log->distOld);
+  free(log->radiusOld);
+  free(log->dirtyOld);
+  free(log->start);
+  free(log->member);
+  free(log->moved);
+  free(log->extra);
+  free(log->extraStart);
+  free(log->extraMember);
+  free(log->changedFlag);
+  free(log->changed);
+  free(log->secStamp);
+  free(log->sec);
+  free(log->secOld);
+  free(log->secDistOld);
+  memset(log, 0, sizeof(TRIALLOG));
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Starts a new trial: forgets the previous one (commits it).        */
+/*-------------------------------------------------------------------*/
+
+
+void BeginTrial(TRIALLOG *log)
+{
+  log->Stamp++;
+  log->centCount = 0;
+  log->vecCount  = 0;
+  log->clusCount = 0;
+  log->secCount  = 0;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Must be called before centroid j is modified.                     */
+/*-------------------------------------------------------------------*/
+
+
+void SaveCentroid(TRIALLOG *log, CODEBOOK *CB, int j)
+{
+  if (log == NULL || log->centStamp[j] == log->Stamp)  return;
+
+  SaveCluster(log, j);
+  log->centStamp[j] = log->Stamp;
+  log->freqOld[log->centCount] = VectorFreq(CB, j);
+  CopyVector(Vector(CB, j), log->centOld + (size_t) log->centCount * log->Dim,
+             log->Dim);
+  log->cent[log->centCount++] = j;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* ChangePartition() that remembers the original partition of i.     */
+/*-------------------------------------------------------------------*/
+
+
+void MoveVector(TRIALLOG *log, TRAININGSET *TS, PARTITIONING *P, int new,
+int i)
+{
+  if (log != NULL && log->vecStamp[i] != log->Stamp)
+    {
+    if (log->vecCount == log->vecSize)
+      {
+      log->vecSize = (log->vecSize == 0) ? 1024 : 2 * log->vecSize;
+      log->vec     = (int*) realloc(log->vec,    log->vecSize * sizeof(int));
+      log->mapOld  = (int*) realloc(log->mapOld, log->vecSize * sizeof(int));
+      if (!log->vec || !log->mapOld)
+        {
+        ErrorMessage("ERROR: Allocating memory failed!\n");
+        ExitProcessing(FATAL_ERROR);
+        }
+      }
+    log->vecStamp[i] = log->Stamp;
+    log->vec[log->vecCount]    = i;
+    log->mapOld[log->vecCount] = Map(P, i);
+    log->vecCount++;
+    }
+
+  if (log != NULL)
+    {
+    SaveCluster(log, Map(P, i));
+    SaveCluster(log, new);
+    log->Moves++;
+    }
+  Relocate(log, TS, P, new, i);
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Restores the solution to its state at BeginTrial().               */
+/*-------------------------------------------------------------------*/
+
+
+void RollbackTrial(TRIALLOG *log, TRAININGSET *TS, CODEBOOK *CB,
+PARTITIONING *P)
+{
+  int n, i, j;
+
+  for (n = log->vecCount - 1; n >= 0; n--)
+    {
+    i = log->vec[n];
+    if (Map(P, i) != log->mapOld[n])
+      {
+      Relocate(log, TS, P, log->mapOld[n], i);
+      }
+    }
+
+  for (n = 0; n < log->centCount; n++)
+    {
+    j = log->cent[n];
+    if (CompareVectors(log->centOld + (size_t) n * log->Dim, Vector(CB, j),
+                       log->Dim) != 0)
+      {
+      CopyVector(log->centOld + (size_t) n * log->Dim, Vector(CB, j),
+                 log->Dim);
+      CentroidChanged(log, j);
+      }
+    VectorFreq(CB, j) = log->freqOld[n];
+    }
+
+  /* the clusters are as they were, so are their cached values */
+  for (n = 0; n < log->clusCount; n++)
+    {
+    j = log->clus[n];
+    log->dist[j]   = log->distOld[n];
+    log->radius[j] = log->radiusOld[n];
+    log->dirty[j]  = log->dirtyOld[n];
+    }
+
+  for (n = 0; n < log->secCount; n++)
+    {
+    i = log->sec[n];
+    log->second[i]     = log->secOld[n];
+    log->secondDist[i] = log->secDistOld[n];
+    }
+  log->secondMoved = -1;
+
+  BeginTrial(log);
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Applies the changes of the trial (made on srcCB, srcP) to another */
+/* copy dstCB, dstP that is in the state the trial started from.     */
+/* dstlog (may be NULL) is the log that keeps the sums of the copy.  */
+/*-------------------------------------------------------------------*/
+
+
+void ReplayTrial(TRIALLOG *log, TRAININGSET *TS, CODEBOOK *srcCB,
+PARTITIONING *srcP, TRIALLOG *dstlog, CODEBOOK *dstCB, PARTITIONING *dstP)
+{
+  int n, i, j;
+
+  for (n = 0; n < log->vecCount; n++)
+    {
+    i = log->vec[n];
+    if (Map(dstP, i) != Map(srcP, i))
+      {
+      Relocate(dstlog, TS, dstP, Map(srcP, i), i);
+      }
+    }
+
+  for (n = 0; n < log->centCount; n++)
+    {
+    j = log->cent[n];
+    if (CompareVectors(Vector(srcCB, j), Vector(dstCB, j), log->Dim) != 0)
+      {
+      CopyVector(Vector(srcCB, j), Vector(dstCB, j), log->Dim);
+      if (dstlog != NULL)  CentroidChanged(dstlog, j);
+      }
+    VectorFreq(dstCB, j) = VectorFreq(srcCB, j);
+    }
+
+  if (dstlog == NULL || dstlog->second == NULL)  return;
+  for (n = 0; n < log->secCount; n++)
+    {
+    i = log->sec[n];
+    dstlog->second[i]     = log->second[i];
+    dstlog->secondDist[i] = log->secondDist[i];
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+/*-------------------------------------------------------------------*/
+/* ChangePartition() that keeps the cluster sums up to date.         */
+/*-------------------------------------------------------------------*/
+
+
+static void Relocate(TRIALLOG *log, TRAININGSET *TS, PARTITIONING *P,
+int new, int i)
+{
+  int   d, old = Map(P, i);
+  llong x, sq = 0;
+
+  if (log != NULL)
+    {
+    if (!log->dirty[old])  log->dist[old] -= Distance(log, TS, i, old);
+    if (!log->dirty[new])
+      {
+      x = Distance(log, TS, i, new);
+      log->dist[new] += x;
+      if (x > log->radius[new])  log->radius[new] = x;
+      }
+    }
+
+  ChangePartition(TS, P, new, i);
+  if (log == NULL)  return;
+
+  log->membersValid = 0;
+  if (log->membersBuilt && !log->moved[i])
+    {
+    /* too many moves: the lists are rebuilt instead */
+    if (log->extraCount == log->extraSize)  log->membersBuilt = 0;
+    else
+      {
+      log->moved[i] = 1;
+      log->extra[log->extraCount++] = i;
+      }
+    }
+  for (d = 0; d < log->Dim; d++)
+    {
+    x   = VectorScalar(TS, i, d);
+    sq += x * x;
+    log->sum[(size_t) old * log->Dim + d] -= x;
+    log->sum[(size_t) new * log->Dim + d] += x;
+    }
+  log->count[old]--;
+  log->count[new]++;
+  log->sumsq[old] -= sq;
+  log->sumsq[new] += sq;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Calculates the cluster sums from scratch (once per run).          */
+/*-------------------------------------------------------------------*/
+
+
+void InitClusterSums(TRIALLOG *log, TRAININGSET *TS, CODEBOOK *CB,
+PARTITIONING *P)
+{
+  int   i, j, d;
+  llong x;
+
+  log->CB           = CB;
+  log->membersValid = 0;
+  log->membersBuilt = 0;
+  for (j = 0; j < log->Size; j++)
+    {
+    log->dirty[j] = 1;
+    }
+
+  memset(log->count, 0, log->Size * sizeof(llong));
+  memset(log->sumsq, 0, log->Size * sizeof(llong));
+  memset(log->sum,   0, (size_t) log->Size * log->Dim * sizeof(llong));
+
+  for (i = 0; i < BookSize(TS); i++)
+    {
+    j = Map(P, i);
+    log->count[j]++;
+    for (d = 0; d < log->Dim; d++)
+      {
+      x = VectorScalar(TS, i, d);
+      log->sum[(size_t) j * log->Dim + d] += x;
+      log->sumsq[j] += x * x;
+      }
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Sum of squared distances of cluster j to its centroid:            */
+/* SSE = sumsq - 2 c.sum + count |c|^2                               */
+/*-------------------------------------------------------------------*/
+
+
+llong ClusterSSE(TRIALLOG *log, CODEBOOK *CB, int j)
+{
+  int   d;
+  llong c, cs = 0, cc = 0;
+
+  for (d = 0; d < log->Dim; d++)
+    {
+    c   = VectorScalar(CB, j, d);
+    cs += c * log->sum[(size_t) j * log->Dim + d];
+    cc += c * c;
+    }
+  return log->sumsq[j] - 2 * cs + log->count[j] * cc;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Same value as ObjectiveFunction() in DENRS.C, in O(Size x Dim).   */
+/*-------------------------------------------------------------------*/
+
+
+llong TrialObjective(TRIALLOG *log, CODEBOOK *CB, double *weight)
+{
+  llong sum = 0;
+  int   j;
+
+  for (j = 0; j < log->Size; j++)
+    {
+    sum += weight[j] * ClusterSSE(log, CB, j);
+    }
+  return sum;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* The log keeps second[i], secondDist[i] (-1 = not known) of the    */
+/* solution from now on. The arrays belong to the caller.            */
+/*-------------------------------------------------------------------*/
+
+
+void AttachSecond(TRIALLOG *log, int *second, llong *secondDist)
+{
+  log->second      = second;
+  log->secondDist  = secondDist;
+  log->secondMoved = -1;
+  log->secCount    = 0;
+  if (log->secStamp == NULL)
+    {
+    log->secStamp   = (int*) DenZeroAlloc(log->N * sizeof(int));
+    log->sec        = (int*) DenZeroAlloc(log->N * sizeof(int));
+    log->secOld     = (int*) DenZeroAlloc(log->N * sizeof(int));
+    log->secDistOld = (llong*) DenZeroAlloc(log->N * sizeof(llong));
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Must be called before the entry of vector i is modified. Threads  */
+/* may save different vectors at the same time.                      */
+/*-------------------------------------------------------------------*/
+
+
+void SaveSecond(TRIALLOG *log, int i)
+{
+  int n;
+
+  if (log->secStamp[i] == log->Stamp)  return;
+
+  log->secStamp[i] = log->Stamp;
+#ifdef _OPENMP
+#pragma omp atomic capture
+#endif
+  n = log->secCount++;
+  log->sec[n]        = i;
+  log->secOld[n]     = log->second[i];
+  log->secDistOld[n] = log->secondDist[i];
+}
+
+
+/*-------------------------------------------------------------------*/
+/* The second nearest centroid of vector i is not known any more     */
+/* (the vector was moved outside the partition pass).                */
+/*-------------------------------------------------------------------*/
+
+
+void ForgetSecond(TRIALLOG *log, int i)
+{
+  if (log == NULL || log->second == NULL || log->second[i] < 0)  return;
+
+  SaveSecond(log, i);
+  log->second[i] = -1;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Forgets every entry after a swap that no partition pass checked   */
+/* (secondMoved may now be the second nearest of any vector).        */
+/*-------------------------------------------------------------------*/
+
+
+void ForgetAllSecond(TRIALLOG *log)
+{
+  int i;
+
+  if (log == NULL || log->second == NULL || log->secondMoved < 0)  return;
+
+  for (i = 0; i < log->N; i++)  ForgetSecond(log, i);
+  log->secondMoved = -1;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+/*-------------------------------------------------------------------*/
+/* Distance of vector i to centroid j as used in the densities.      */
+/*-------------------------------------------------------------------*/
+
+
+static llong Distance(TRIALLOG *log, TRAININGSET *TS, int i, int j)
+{
+  log->Distances++;
+  return sqrt(VectorDistance(Vector(TS, i), Vector(log->CB, j), log->Dim,
+                             MAXLLONG, EUCLIDEANSQ));
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Must be called after centroid j has been moved.                   */
+/*-------------------------------------------------------------------*/
+
+
+void CentroidChanged(TRIALLOG *log, int j)
+{
+  if (log == NULL)  return;
+
+  log->dirty[j] = 1;
+  if (!log->changedFlag[j])
+    {
+    log->changedFlag[j] = 1;
+    log->changed[log->changedCount++] = j;
+    }
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Centroids moved since the previous call; the list is valid until  */
+/* the next CentroidChanged().                                       */
+/*-------------------------------------------------------------------*/
+
+
+int* ChangedCentroids(TRIALLOG *log, int *count)
+{
+  int n;
+
+  for (n = 0; n < log->changedCount; n++)
+    {
+    log->changedFlag[log->changed[n]] = 0;
+    }
+  *count            = log->changedCount;
+  log->changedCount = 0;
+  return log->changed;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Adds n distance evaluations made outside the log to its counter.  */
+/*-------------------------------------------------------------------*/
+
+
+void CountDistances(TRIALLOG *log, llong n)
+{
+  if (log != NULL)  log->Distances += n;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Sum of the distances of the vectors of cluster j to its centroid  */
+/* (TotalDistance() in DENRS.C). Only dirty clusters are visited,    */
+/* through the member lists when they are up to date.                */
+/*-------------------------------------------------------------------*/
+
+
+llong ClusterDistance(TRIALLOG *log, TRAININGSET *TS, PARTITIONING *P, int j)
+{
+  llong total = 0, d, radius = 0;
+  int   i, n;
+
+  if (!log->dirty[j])  return log->dist[j];
+
+  if (log->membersValid)
+    {
+    n = log->start[j];
+    while ((i = NextMember(log, j, &n)) >= 0)
+      {
+      d      = Distance(log, TS, i, j);
+      total += d;
+      if (d > radius)  radius = d;
+      }
+    }
+  else
+    {
+    for (i = FirstVector(P, j); !EndOfPartition(i); i = NextVector(P, i))
+      {
+      d      = Distance(log, TS, i, j);
+      total += d;
+      if (d > radius)  radius = d;
+      }
+    }
+
+  log->dist[j]   = total;
+  log->radius[j] = radius;
+  log->dirty[j]  = 0;
+  return total;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Lists the vectors of each cluster contiguously (counting sort by  */
+/* cluster, so each list is in index order). Once the lists are      */
+/* built, only the vectors moved since then are sorted again.        */
+/* Skipped when the lists are up to date or no cluster needs to be   */
+/* recalculated.                                                     */
+/*-------------------------------------------------------------------*/
+
+
+void UpdateMembers(TRIALLOG *log, PARTITIONING *P)
+{
+  int i, j, n, dirty = 0;
+
+  for (j = 0; j < log->Size; j++)
+    {
+    dirty |= log->dirty[j];
+    }
+  if (log->membersValid || !dirty)  return;
+
+  if (!log->membersBuilt)
+    {
+    BuildMembers(log, P);
+    return;
+    }
+
+  memset(log->extraStart, 0, (log->Size + 1) * sizeof(int));
+  for (n = 0; n < log->extraCount; n++)
+    {
+    log->extraStart[Map(P, log->extra[n]) + 1]++;
+    }
+  for (j = 0; j < log->Size; j++)
+    {
+    log->extraStart[j + 1] += log->extraStart[j];
+    }
+  for (n = 0; n < log->extraCount; n++)
+    {
+    i = log->extra[n];
+    log->extraMember[log->extraStart[Map(P, i)]++] = i;
+    }
+  for (j = log->Size; j > 0; j--)
+    {
+    log->extraStart[j] = log->extraStart[j - 1];
+    }
+  log->extraStart[0] = 0;
+  log->membersValid  = 1;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Next vector of cluster j in the lists built by UpdateMembers(), or */
+/* -1 at the end. *n starts at start[j]; the moved vectors follow    */
+/* (*n < 0 counts them). The lists must be up to date when the walk  */
+/* starts; vectors that leave j during the walk do not disturb it.   */
+/*-------------------------------------------------------------------*/
+
+
+int NextMember(TRIALLOG *log, int j, int *n)
+{
+  int i;
+
+  while (*n >= 0 && *n < log->start[j + 1])
+    {
+    i = log->member[(*n)++];
+    if (!log->moved[i])  return i;
+    }
+  if (*n >= 0)  *n = -1 - log->extraStart[j];
+  if (-1 - *n < log->extraStart[j + 1])
+    {
+    i = log->extraMember[-1 - *n];
+    (*n)--;
+    return i;
+    }
+  return -1;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Rebuilds the lists of all vectors and forgets the moved ones.     */
+/*-------------------------------------------------------------------*/
+
+
+static void BuildMembers(TRIALLOG *log, PARTITIONING *P)
+{
+  int i, j, n;
+
+  memset(log->start, 0, (log->Size + 1) * sizeof(int));
+  for (i = 0; i < log->N; i++)
+    {
+    log->start[Map(P, i) + 1]++;
+    }
+  for (j = 0; j < log->Size; j++)
+    {
+    log->start[j + 1] += log->start[j];
+    }
+  for (i = 0; i < log->N; i++)
+    {
+    log->member[log->start[Map(P, i)]++] = i;
+    }
+  for (j = log->Size; j > 0; j--)
+    {
+    log->start[j] = log->start[j - 1];
+    }
+  log->start[0] = 0;
+
+  for (n = 0; n < log->extraCount; n++)
+    {
+    log->moved[log->extra[n]] = 0;
+    }
+  memset(log->extraStart, 0, (log->Size + 1) * sizeof(int));
+  log->extraCount   = 0;
+  log->membersBuilt = 1;
+  log->membersValid = 1;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Upper bound of the (truncated) distances of the vectors of        */
+/* cluster j to its centroid; the true distances are below it + 1.   */
+/* Vectors leaving the cluster do not lower it.                      */
+/*-------------------------------------------------------------------*/
+
+
+llong ClusterRadius(TRIALLOG *log, TRAININGSET *TS, PARTITIONING *P, int j)
+{
+  ClusterDistance(log, TS, P, j);
+  return log->radius[j];
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Must be called before cluster j is changed in a trial.            */
+/*-------------------------------------------------------------------*/
+
+
+static void SaveCluster(TRIALLOG *log, int j)
+{
+  if (log->clusStamp[j] == log->Stamp)  return;
+
+  log->clusStamp[j]              = log->Stamp;
+  log->distOld[log->clusCount]   = log->dist[j];
+  log->radiusOld[log->clusCount] = log->radius[j];
+  log->dirtyOld[log->clusCount]  = log->dirty[j];
+  log->clus[log->clusCount++]    = j;
+}
+
+
+/*-------------------------------------------------------------------*/
@@ -0,0 +1,119 @@
+#if ! defined(__DENTRIAL_H)
+#define __DENTRIAL_H
+
+/* At most N / MEMBER_EXTRA moved vectors are kept apart from the
+   member lists; more moves rebuild the lists. */
+#define MEMBER_EXTRA      8
+
+/* Undo log of one random swap trial. The trial modifies the solution
+   in place; the log remembers the original value of every centroid and
+   partition entry it touched, so the trial can be rolled back (or
+   replayed on another copy) in time proportional to the change.
+   The log also keeps per-cluster sums of the vectors of its solution
+   (count, coordinate sums, sums of squares). They do not depend on the
+   centroids or weights, so the weighted SSE of a cluster is O(Dim).
+   The sums of (truncated) distances to the centroids, needed for the
+   densities, are cached too. A vector move updates them directly; a
+   cluster whose centroid changed is marked dirty and recalculated only
+   when its distance is next asked for. With the distances, the largest
+   distance of a cluster (its radius) is kept as an upper bound. The
+   cached values of the clusters touched by a trial are saved, so a
+   rollback restores them instead of leaving the clusters dirty.
+   For recalculating the clusters, the log can list the vectors of each
+   cluster contiguously (member[start[j] .. start[j+1]-1], in index
+   order). The lists are built once; the vectors moved since then are
+   flagged (they are skipped in member[]) and kept in a short list,
+   which UpdateMembers() sorts by cluster (extraMember[extraStart[j] ..
+   extraStart[j+1]-1]). The lists are rebuilt only when that list grows
+   too long. NextMember() walks both parts of a cluster. The centroids
+   moved by CentroidChanged() are also listed (each once) until
+   ChangedCentroids() takes the list, so that a hash of the centroids
+   can follow them. Distances and Moves count the distance evaluations
+   and vector moves of the solution for the metrics.
+   The second nearest centroids of the deterministic variant can be
+   attached (AttachSecond()); the entries changed by a trial are saved
+   like the partitions, so a rollback or a replay costs what the trial
+   changed. secondMoved is the centroid moved by the swap: its entries
+   are stale until the next partition pass (see OptimalPartition()). */
+typedef struct
+  {
+  int            N;           /* training set size                    */
+  int            Size;        /* codebook size                        */
+  int            Dim;         /* vector dimension                     */
+  int            Stamp;       /* number of the current trial          */
+  int           *centStamp;   /* trial that saved centroid j          */
+  int           *cent;        /* saved centroids                      */
+  int            centCount;
+  VECTORELEMENT *centOld;     /* original vectors, Size x Dim         */
+  int           *freqOld;     /* original frequencies                 */
+  int           *vecStamp;    /* trial that saved vector i            */
+  int           *vec;         /* vectors whose partition changed      */
+  int           *mapOld;      /* their original partitions            */
+  int            vecCount;
+  int            vecSize;
+  llong         *count;       /* vectors in cluster j                 */
+  llong         *sum;         /* coordinate sums, Size x Dim          */
+  llong         *sumsq;       /* sums of squared norms                */
+  CODEBOOK      *CB;          /* codebook of the solution             */
+  llong         *dist;        /* sums of distances to the centroids   */
+  int           *dirty;       /* dist[j] must be recalculated         */
+  llong         *radius;      /* upper bound of the distances         */
+  int           *clusStamp;   /* trial that saved the cache of j      */
+  int           *clus;        /* clusters whose cache was saved       */
+  int            clusCount;
+  llong         *distOld;     /* their original cached values         */
+  llong         *radiusOld;
+  int           *dirtyOld;
+  int           *start;       /* first member of each cluster         */
+  int           *member;      /* vectors ordered by cluster           */
+  int            membersValid;
+  int            membersBuilt;
+  int           *moved;       /* i moved after member[] was built     */
+  int           *extra;       /* the moved vectors                    */
+  int            extraCount;
+  int            extraSize;
+  int           *extraStart;  /* first moved vector of each cluster   */
+  int           *extraMember; /* moved vectors ordered by cluster     */
+  int           *changedFlag; /* j is in changed[]                    */
+  int           *changed;     /* centroids moved since last taken     */
+  int            changedCount;
+  int           *second;      /* second nearest centroids (or NULL)   */
+  llong         *secondDist;  /* their squared distances              */
+  int            secondMoved; /* centroid of stale entries, -1 = none */
+  int           *secStamp;    /* trial that saved the entry of i      */
+  int           *sec;         /* vectors whose entry was saved        */
+  int           *secOld;      /* their original entries               */
+  llong         *secDistOld;
+  int            secCount;
+  llong          Distances;   /* distance evaluations                 */
+  llong          Moves;       /* vectors moved by MoveVector()        */
+  } TRIALLOG;
+
+void CreateTrialLog(TRIALLOG *log, TRAININGSET *TS, CODEBOOK *CB);
+void FreeTrialLog(TRIALLOG *log);
+void BeginTrial(TRIALLOG *log);
+void SaveCentroid(TRIALLOG *log, CODEBOOK *CB, int j);
+void MoveVector(TRIALLOG *log, TRAININGSET *TS, PARTITIONING *P, int new,
+    int i);
+void RollbackTrial(TRIALLOG *log, TRAININGSET *TS, CODEBOOK *CB,
+    PARTITIONING *P);
+void ReplayTrial(TRIALLOG *log, TRAININGSET *TS, CODEBOOK *srcCB,
+    PARTITIONING *srcP, TRIALLOG *dstlog, CODEBOOK *dstCB,
+    PARTITIONING *dstP);
+void CentroidChanged(TRIALLOG *log, int j);
+int* ChangedCentroids(TRIALLOG *log, int *count);
+void CountDistances(TRIALLOG *log, llong n);
+void InitClusterSums(TRIALLOG *log, TRAININGSET *TS, CODEBOOK *CB,
+    PARTITIONING *P);
+llong ClusterDistance(TRIALLOG *log, TRAININGSET *TS, PARTITIONING *P, int j);
+void UpdateMembers(TRIALLOG *log, PARTITIONING *P);
+int  NextMember(TRIALLOG *log, int j, int *n);
+llong ClusterRadius(TRIALLOG *log, TRAININGSET *TS, PARTITIONING *P, int j);
+llong ClusterSSE(TRIALLOG *log, CODEBOOK *CB, int j);
+llong TrialObjective(TRIALLOG *log, CODEBOOK *CB, double *weight);
+void AttachSecond(TRIALLOG *log, int *second, llong *secondDist);
+void SaveSecond(TRIALLOG *log, int i);
+void ForgetSecond(TRIALLOG *log, int i);
+void ForgetAllSecond(TRIALLOG *log);
+
+#endif /* __DENTRIAL_H */
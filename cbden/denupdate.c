@@ -0,0 +1,559 @@
+/*--------------------------------------------------------------------*/
+/* DENUPDATE.C     agent                                              */
+/*                                                                    */
+/* Incremental update of a density-based random swap solution when    */
+/* new vectors arrive. The new vectors are labelled as in DENASSIGN.C */
+/* and only the clusters they reach are refined, by local K-means and */
+/* by swaps of their centroids to new vectors. The other clusters     */
+/* keep their centroids; their densities follow from the saved        */
+/* weights, which are the densities divided by their total, and their */
+/* squared errors are saved with the weights.                         */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.04: 17.10.26 AG: Saved cluster errors, caller's partition.       */
+/* 0.03: 17.10.26 AG: Swaps compare the whole weighted objective.     */
+/* 0.02: 17.10.26 AG: Partition created through the shared lock.      */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cb.h"
+#include "interfc.h"
+#include "denutil.h"
+#include "denkern.h"
+#include "denwork.h"
+#include "dentrial.h"
+#include "denstats.h"
+#include "denstore.h"
+#include "dentraj.h"
+#include "denrs.h"
+#include "denassign.h"
+#include "denupdate.h"
+
+
+#define min(a,b) ((a) < (b) ? (a) : (b))
+#define max(a,b) ((a) > (b) ? (a) : (b))
+
+/* initial length of the move log of a swap trial */
+#define UPDATE_MOVES  1024
+
+
+/* State of an update. The densities are those of CalculateDensity()
+   in DENRS.C and the weights are the densities over their total. The
+   affected clusters are refined by the update. The squared errors of
+   the clusters (the caller's, see ReadWeights) are kept for the
+   objective function of the swaps and updated in place. A
+   swap trial saves every cluster before it changes it and logs the
+   moves, so it can be undone; the trial refines only the saved
+   clusters. */
+typedef struct
+  {
+  TRAININGSET   *TS;
+  CODEBOOK      *CB;
+  PARTITIONING  *P;
+  double        *weight;
+  double        *density;
+  llong         *sse;           /* squared errors of the clusters     */
+  PACKEDBOOK     PB;
+  int           *affected;      /* cluster is in list                 */
+  int           *list;          /* affected clusters                  */
+  int            count;
+  int           *member;        /* vectors of one cluster             */
+  int            logging;       /* a swap trial is running            */
+  int           *saved;         /* cluster is in trial                */
+  int           *trial;         /* clusters saved by the trial        */
+  int            trialCount;
+  VECTORELEMENT *centOld;       /* their centroids, Size x Dim        */
+  double        *densOld;       /* densities                          */
+  llong         *sseOld;        /* and squared errors                 */
+  int           *moveVec;       /* vectors moved by the trial         */
+  int           *moveFrom;      /* and their original clusters        */
+  int            moveCount;
+  int            moveSize;
+  UPDATESTATS   *stats;
+  } UPDATESTATE;
+
+
+/* ========================== PROTOTYPES ============================= */
+
+static int    ClusterError(TRAININGSET *TS, CODEBOOK *CB, PARTITIONING *P,
+              int j, int limit, llong *sse, llong *dist);
+static double Density(int n, llong dist);
+static int    Members(UPDATESTATE *U, int j);
+static void   Affect(UPDATESTATE *U, int j);
+static void   SaveCluster(UPDATESTATE *U, int j);
+static void   MoveTo(UPDATESTATE *U, int i, int to);
+static void   Reweight(UPDATESTATE *U);
+static double Objective(UPDATESTATE *U);
+static int    Refined(UPDATESTATE *U, int **list);
+static void   UpdateCentroids(UPDATESTATE *U);
+static int    LocalKMeans(UPDATESTATE *U, int iter);
+static int    TrySwap(UPDATESTATE *U, int first, RANDOMSTATE *rng,
+              int iter);
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+void JoinTrainingSets(TRAININGSET *A, TRAININGSET *B, TRAININGSET *TS)
+{
+  int i;
+
+  *TS               = *A;
+  TS->CodebookSize  = BookSize(A) + BookSize(B);
+  TS->AllocatedSize = BookSize(TS);
+  TS->TotalFreq     = TotalFreq(A) + TotalFreq(B);
+  TS->MinValue      = min(A->MinValue, B->MinValue);
+  TS->MaxValue      = max(A->MaxValue, B->MaxValue);
+  TS->Book          = (BOOKNODE*) DenAlloc(BookSize(TS) *
+                                              sizeof(BOOKNODE));
+
+  for (i = 0; i < BookSize(A); i++)  Node(TS, i) = Node(A, i);
+  for (i = 0; i < BookSize(B); i++)  Node(TS, BookSize(A) + i) = Node(B, i);
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void FreeJoinedSet(TRAININGSET *TS)
+{
+  free(TS->Book);
+  TS->Book = NULL;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+int UpdateDenRS(DENRSCONTEXT *ctx, TRAININGSET *pTS, int first,
+CODEBOOK *pCB, PARTITIONING *pP, double *weight, llong *sse,
+UPDATESTATS *stats)
+{
+  UPDATESTATE U;
+  llong       e, dist;
+  double      share = 0.0, scale = 0.0;
+  int        *label;
+  int         size    = BookSize(pCB), added = BookSize(pTS) - first;
+  int         iter    = ctx->Options.KMeansIterations;
+  int         threads = ctx->Options.Threads;
+  int         i, j, n, s;
+
+  memset(stats, 0, sizeof(UPDATESTATS));
+  if ((first < 1) || (added < 0) || (size < 1) ||
+      (PartitionCount(pP) != size) ||
+      (VectorSize(pCB) != VectorSize(pTS)) || (iter < 0) ||
+      (ctx->Options.Iterations < 0) || (threads < 0))
+    {
+    return 1;
+    }
+  if (threads == 0)  threads = DefaultThreads();
+
+  memset(&U, 0, sizeof(UPDATESTATE));
+  U.TS       = pTS;
+  U.CB       = pCB;
+  U.P        = pP;
+  U.weight   = weight;
+  U.stats    = stats;
+  U.sse      = sse;
+  U.density  = (double*) DenAlloc(size * sizeof(double));
+  U.affected = (int*) DenAlloc(size * sizeof(int));
+  U.list     = (int*) DenAlloc(size * sizeof(int));
+  U.member   = (int*) DenAlloc(BookSize(pTS) * sizeof(int));
+  U.saved    = (int*) DenAlloc(size * sizeof(int));
+  U.trial    = (int*) DenAlloc(size * sizeof(int));
+  U.centOld  = (VECTORELEMENT*) DenAlloc((size_t) size * VectorSize(pCB)
+                                            * sizeof(VECTORELEMENT));
+  U.densOld  = (double*) DenAlloc(size * sizeof(double));
+  U.sseOld   = (llong*) DenAlloc(size * sizeof(llong));
+  U.moveSize = UPDATE_MOVES;
+  U.moveVec  = (int*) DenAlloc(U.moveSize * sizeof(int));
+  U.moveFrom = (int*) DenAlloc(U.moveSize * sizeof(int));
+  memset(U.affected, 0, size * sizeof(int));
+  memset(U.saved,    0, size * sizeof(int));
+  InitPackedCodebook(&U.PB);
+  PackCodebook(pCB, weight, &U.PB);
+
+  /* the new vectors go to their nearest centroids */
+  label = (int*) DenAlloc(max(added, 1) * sizeof(int));
+  AssignVectors(pTS, first, added, &U.PB, label, threads);
+  for (i = 0; i < added; i++)
+    {
+    Affect(&U, label[i]);
+    if (Map(pP, first + i) != label[i])
+      {
+      ChangePartition(pTS, pP, label[i], first + i);
+      }
+    }
+  free(label);
+  stats->Added   = added;
+  stats->Visited = added;
+
+  /* densities of the affected clusters before the new vectors; the
+     weights give those of the others in the same scale */
+  for (s = 0; s < U.count; s++)
+    {
+    j            = U.list[s];
+    n            = ClusterError(pTS, pCB, pP, j, first, &e, &dist);
+    U.density[j] = Density(n, dist);
+    share       += weight[j];
+    scale       += U.density[j];
+    }
+  scale = (share > 0.0) ? scale / share : 1.0;
+  for (j = 0; j < size; j++)
+    {
+    if (!U.affected[j])  U.density[j] = weight[j] * scale;
+    }
+
+  /* the refined clusters get their errors from the K-means */
+  stats->Iterations = LocalKMeans(&U, iter);
+  if (added > 0 && ctx->Options.Iterations > 0)
+    {
+    for (s = 0; s < ctx->Options.Iterations; s++)
+      {
+      stats->Accepted += TrySwap(&U, first, ctx->rng, iter);
+      stats->Swaps++;
+      }
+    }
+  stats->Affected = U.count;
+
+  FreePackedCodebook(&U.PB);
+  free(U.density);
+  free(U.affected);
+  free(U.list);
+  free(U.member);
+  free(U.saved);
+  free(U.trial);
+  free(U.centOld);
+  free(U.densOld);
+  free(U.sseOld);
+  free(U.moveVec);
+  free(U.moveFrom);
+  return 0;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Squared error of cluster j and the sum of the (truncated)         */
+/* distances of its vectors, as TotalDistance() in DENRS.C, over the */
+/* vectors before limit. Returns their frequency.                    */
+/*-------------------------------------------------------------------*/
+
+
+static int ClusterError(TRAININGSET *TS, CODEBOOK *CB, PARTITIONING *P,
+int j, int limit, llong *sse, llong *dist)
+{
+  llong e;
+  int   i, n = 0;
+
+  *sse  = 0;
+  *dist = 0;
+  for (i = FirstVector(P, j); !EndOfPartition(i); i = NextVector(P, i))
+    {
+    if (i >= limit)  continue;
+    e      = VectorDistance(Vector(TS, i), Vector(CB, j), VectorSize(CB),
+                            MAXLLONG, EUCLIDEANSQ);
+    *sse  += e;
+    *dist += (llong) sqrt(e);
+    n     += VectorFreq(TS, i);
+    }
+  return n;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Density of a cluster of n vectors, as CalculateDensity().         */
+/*-------------------------------------------------------------------*/
+
+
+static double Density(int n, llong dist)
+{
+  if (n == 1 || n == 0)  return 0.001;
+  return ((double) n) / (dist / (double) n);
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Lists the vectors of cluster j in member; they may then move.     */
+/*-------------------------------------------------------------------*/
+
+
+static int Members(UPDATESTATE *U, int j)
+{
+  int i, count = 0;
+
+  for (i = FirstVector(U->P, j); !EndOfPartition(i); i = NextVector(U->P, i))
+    {
+    U->member[count++] = i;
+    }
+  U->stats->Visited += count;
+  return count;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+static void Affect(UPDATESTATE *U, int j)
+{
+  if (U->affected[j])  return;
+  U->affected[j]        = 1;
+  U->list[U->count++]   = j;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Saves cluster j before a swap trial changes it for the first time.*/
+/*-------------------------------------------------------------------*/
+
+
+static void SaveCluster(UPDATESTATE *U, int j)
+{
+  int dim = VectorSize(U->CB);
+
+  if (!U->logging || U->saved[j])  return;
+
+  U->saved[j]               = 1;
+  U->trial[U->trialCount++] = j;
+  CopyVector(Vector(U->CB, j), U->centOld + (size_t) j * dim, dim);
+  U->densOld[j]             = U->density[j];
+  U->sseOld[j]              = U->sse[j];
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+static void MoveTo(UPDATESTATE *U, int i, int to)
+{
+  int from = Map(U->P, i);
+
+  SaveCluster(U, from);
+  SaveCluster(U, to);
+  if (U->logging)
+    {
+    if (U->moveCount == U->moveSize)
+      {
+      U->moveSize *= 2;
+      U->moveVec   = (int*) realloc(U->moveVec, U->moveSize * sizeof(int));
+      U->moveFrom  = (int*) realloc(U->moveFrom, U->moveSize * sizeof(int));
+      if (!U->moveVec || !U->moveFrom)
+        {
+        ErrorMessage("ERROR: Allocating memory failed!\n");
+        ExitProcessing(FATAL_ERROR);
+        }
+      }
+    U->moveVec[U->moveCount]  = i;
+    U->moveFrom[U->moveCount] = from;
+    U->moveCount++;
+    }
+  ChangePartition(U->TS, U->P, to, i);
+  if (!U->logging)  Affect(U, to);
+  U->stats->Moves++;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Weights from the densities; the packed codebook follows them.     */
+/*-------------------------------------------------------------------*/
+
+
+static void Reweight(UPDATESTATE *U)
+{
+  double total = 0.0;
+  int    j;
+
+  for (j = 0; j < BookSize(U->CB); j++)  total += U->density[j];
+  for (j = 0; j < BookSize(U->CB); j++)
+    {
+    U->weight[j] = U->density[j] / total;
+    }
+  PackCodebook(U->CB, U->weight, &U->PB);
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Objective function: the squared errors of all clusters weighted   */
+/* by the densities over their total.                                */
+/*-------------------------------------------------------------------*/
+
+
+static double Objective(UPDATESTATE *U)
+{
+  double cost = 0.0, total = 0.0;
+  int    j;
+
+  for (j = 0; j < BookSize(U->CB); j++)
+    {
+    cost  += U->density[j] * U->sse[j];
+    total += U->density[j];
+    }
+  return cost / total;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Clusters refined: the affected ones, or those of a swap trial.    */
+/*-------------------------------------------------------------------*/
+
+
+static int Refined(UPDATESTATE *U, int **list)
+{
+  *list = U->logging ? U->trial : U->list;
+  return U->logging ? U->trialCount : U->count;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Centroids, errors and densities of the refined clusters.          */
+/*-------------------------------------------------------------------*/
+
+
+static void UpdateCentroids(UPDATESTATE *U)
+{
+  llong dist;
+  int  *list, n, j, count = Refined(U, &list);
+
+  for (n = 0; n < count; n++)
+    {
+    j = list[n];
+    if (CCFreq(U->P, j) > 0)  PartitionCentroid(U->P, j, &Node(U->CB, j));
+    ClusterError(U->TS, U->CB, U->P, j, BookSize(U->TS), &U->sse[j], &dist);
+    U->density[j] = Density(CCFreq(U->P, j), dist);
+    }
+  Reweight(U);
+}
+
+
+/*-------------------------------------------------------------------*/
+/* K-means over the vectors of the refined clusters. A cluster that  */
+/* receives vectors is refined too. Returns the iterations done.     */
+/*-------------------------------------------------------------------*/
+
+
+static int LocalKMeans(UPDATESTATE *U, int iter)
+{
+  llong error;
+  int  *list, it, n, m, j, count, size, nearest, moved;
+
+  UpdateCentroids(U);
+  for (it = 0; it < iter && Refined(U, &list) > 0; )
+    {
+    size  = Refined(U, &list);
+    moved = 0;
+    for (n = 0; n < size; n++)
+      {
+      j     = list[n];
+      count = Members(U, j);
+      for (m = 0; m < count; m++)
+        {
+        nearest = FindNearestVectorPacked(U->TS, &U->PB, U->member[m], j,
+                                          &error, NULL, NULL);
+        if (nearest != j)
+          {
+          MoveTo(U, U->member[m], nearest);
+          moved++;
+          }
+        }
+      }
+    it++;
+    if (moved == 0)  break;
+    UpdateCentroids(U);
+    }
+  return it;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Swaps a random affected centroid to a random new vector. The      */
+/* vectors of the swapped cluster go to their nearest centroids and  */
+/* those of the cluster of the new vector that are now nearer to the */
+/* swapped centroid move to it (object rejection and attraction by   */
+/* the weighted rule). The local K-means then runs over the clusters */
+/* the trial touched. The trial is kept if the objective function    */
+/* decreased and none of those clusters was left with fewer than two */
+/* vectors (their density would be arbitrary). The weights change    */
+/* with the densities, so the whole objective is compared, from the  */
+/* kept errors of the clusters. Returns 1 if kept.                   */
+/*-------------------------------------------------------------------*/
+
+
+static int TrySwap(UPDATESTATE *U, int first, RANDOMSTATE *rng, int iter)
+{
+  llong  error, own, new;
+  double before = Objective(U);
+  int    dim = VectorSize(U->CB);
+  int    n, m, j, a, x, count, nearest, small = 0;
+
+  U->logging    = 1;
+  U->trialCount = 0;
+  U->moveCount  = 0;
+
+  j = U->list[RandomIndex(rng, U->count)];
+  x = first + RandomIndex(rng, BookSize(U->TS) - first);
+  SaveCluster(U, j);
+  CopyVector(Vector(U->TS, x), Vector(U->CB, j), dim);
+  PackCodebook(U->CB, U->weight, &U->PB);
+
+  /* object rejection */
+  count = Members(U, j);
+  for (m = 0; m < count; m++)
+    {
+    nearest = FindNearestVectorPacked(U->TS, &U->PB, U->member[m], j,
+                                      &error, NULL, NULL);
+    if (nearest != j)  MoveTo(U, U->member[m], nearest);
+    }
+
+  /* object attraction */
+  a = Map(U->P, x);
+  if (a != j)
+    {
+    count = Members(U, a);
+    for (m = 0; m < count; m++)
+      {
+      own = U->weight[a] * sqrt(VectorDistance(Vector(U->TS, U->member[m]),
+            Vector(U->CB, a), dim, MAXLLONG, EUCLIDEANSQ));
+      new = U->weight[j] * sqrt(VectorDistance(Vector(U->TS, U->member[m]),
+            Vector(U->CB, j), dim, MAXLLONG, EUCLIDEANSQ));
+      if (new < own)  MoveTo(U, U->member[m], j);
+      }
+    }
+
+  LocalKMeans(U, iter);
+
+  for (n = 0; n < U->trialCount; n++)
+    {
+    if (CCFreq(U->P, U->trial[n]) < 2)  small = 1;
+    }
+  U->logging = 0;
+  for (n = 0; n < U->trialCount; n++)  U->saved[U->trial[n]] = 0;
+  if (!small && Objective(U) < before)
+    {
+    for (n = 0; n < U->trialCount; n++)  Affect(U, U->trial[n]);
+    return 1;
+    }
+
+  /* rollback */
+  for (n = U->moveCount - 1; n >= 0; n--)
+    {
+    ChangePartition(U->TS, U->P, U->moveFrom[n], U->moveVec[n]);
+    }
+  for (n = 0; n < U->trialCount; n++)
+    {
+    a             = U->trial[n];
+    CopyVector(U->centOld + (size_t) a * dim, Vector(U->CB, a), dim);
+    U->density[a] = U->densOld[a];
+    U->sse[a]     = U->sseOld[a];
+    }
+  Reweight(U);
+  return 0;
+}
+
+
+/*-------------------------------------------------------------------*/
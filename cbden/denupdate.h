@@ -0,0 +1,41 @@
+#if ! defined(__DENUPDATE_H)
+#define __DENUPDATE_H
+
+/* Result of UpdateDenRS. */
+typedef struct
+  {
+  int        Added;             /* new vectors                        */
+  int        Affected;          /* clusters the update touched        */
+  int        Iterations;        /* local K-means iterations           */
+  int        Swaps;             /* swaps tried                        */
+  int        Accepted;          /* swaps kept                         */
+  llong      Moves;             /* vectors moved after the assignment */
+  llong      Visited;           /* vectors searched by the update     */
+  } UPDATESTATS;
+
+/* Training set of the vectors of A followed by those of B. The nodes
+   point to the vectors of A and B, which must outlive it; it is freed
+   with FreeJoinedSet. */
+void JoinTrainingSets(TRAININGSET *A, TRAININGSET *B, TRAININGSET *TS);
+void FreeJoinedSet(TRAININGSET *TS);
+
+/* Adds vectors first..BookSize(pTS)-1 of pTS to a solution of the
+   vectors before them: pCB, weight and sse (the squared errors of the
+   clusters, as saved by CBDEN with ReadWeights) and pP, a partition of
+   pTS whose first vectors are in their clusters (the others may be in
+   any). The new vectors go to their nearest centroids by the weighted
+   rule; then only the clusters that received vectors, and those that
+   vectors move to, are refined: Options.KMeansIterations local K-means
+   iterations, Options.Iterations random swaps of their centroids to
+   new vectors, each followed by the local K-means. A swap is kept if
+   the objective function decreases and no cluster it touches is left
+   with fewer than two vectors. The densities of the other clusters
+   are derived from their weights and their errors are the saved ones,
+   so the work depends on the new vectors and the clusters they reach,
+   not on the whole training set. pCB, pP, weight and sse are updated
+   in place. */
+int UpdateDenRS(DENRSCONTEXT *ctx, TRAININGSET *pTS, int first,
+    CODEBOOK *pCB, PARTITIONING *pP, double *weight, llong *sse,
+    UPDATESTATS *stats);
+
+#endif /* __DENUPDATE_H */
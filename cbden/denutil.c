@@ -0,0 +1,160 @@
+/*--------------------------------------------------------------------*/
+/* DENUTIL.C       agent                                              */
+/*                                                                    */
+/* Helpers shared by the modules of the density-based random swap.    */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.03: 17.10.26 AG: Random seeds and nested parallel runs.          */
+/* 0.02: 17.10.26 AG: Toolkit allocations under one lock.             */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "cb.h"
+#include "random.h"
+#include "interfc.h"
+#include "denutil.h"
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+void* DenAlloc(size_t size)
+{
+  void *p = malloc(size > 0 ? size : 1);
+
+  if (!p)
+    {
+    ErrorMessage("ERROR: Allocating memory failed!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
+  return p;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void* DenZeroAlloc(size_t size)
+{
+  void *p = calloc(1, size > 0 ? size : 1);
+
+  if (!p)
+    {
+    ErrorMessage("ERROR: Allocating memory failed!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
+  return p;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void DenNewCodebook(CODEBOOK *CB, int size, TRAININGSET *TS)
+{
+#ifdef _OPENMP
+#pragma omp critical (DenToolkit)
+#endif
+  CreateNewCodebook(CB, size, TS);
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void DenNewPartitioning(PARTITIONING *P, TRAININGSET *TS, int count)
+{
+#ifdef _OPENMP
+#pragma omp critical (DenToolkit)
+#endif
+  CreateNewPartitioning(P, TS, count);
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void DenFreeCodebook(CODEBOOK *CB)
+{
+#ifdef _OPENMP
+#pragma omp critical (DenToolkit)
+#endif
+  FreeCodebook(CB);
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void DenFreePartitioning(PARTITIONING *P)
+{
+#ifdef _OPENMP
+#pragma omp critical (DenToolkit)
+#endif
+  FreePartitioning(P);
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+int CompareInt(const void *a, const void *b)
+{
+  return *(const int*) a - *(const int*) b;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+llong RandomSeed(void)
+{
+  return ((llong) irand(0, 65535) << 16) | irand(0, 65535);
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Parallel runs that use threads of their own are nested parallel   */
+/* regions, which OpenMP runs on one thread each unless more active  */
+/* levels are allowed.                                               */
+/*-------------------------------------------------------------------*/
+
+
+int BeginNesting(int threads, int count, int *outer, int *inner)
+{
+  int levels = 1;
+
+  *outer = (threads < count) ? threads : count;
+  *inner = (threads / *outer > 1) ? threads / *outer : 1;
+#ifdef _OPENMP
+  levels = omp_get_max_active_levels();
+  if (*outer > 1 && *inner > 1 && levels < omp_get_active_level() + 2)
+    {
+    omp_set_max_active_levels(omp_get_active_level() + 2);
+    }
+#endif
+  return levels;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void EndNesting(int levels)
+{
+#ifdef _OPENMP
+  omp_set_max_active_levels(levels);
+#endif
+}
+
+
+/*-------------------------------------------------------------------*/
@@ -0,0 +1,30 @@
+#if ! defined(__DENUTIL_H)
+#define __DENUTIL_H
+
+/* Allocation that ends the program if memory runs out. DenAlloc never
+   returns NULL, not even for size 0; DenZeroAlloc clears the memory. */
+void* DenAlloc(size_t size);
+void* DenZeroAlloc(size_t size);
+
+/* Codebooks and partitionings of the toolkit. The toolkit keeps its
+   own records of the allocations, so every run creates and frees them
+   through these, which share one lock; runs may then go in parallel
+   (RunDenRSRepeats, DenRSRange). */
+void  DenNewCodebook(CODEBOOK *CB, int size, TRAININGSET *TS);
+void  DenNewPartitioning(PARTITIONING *P, TRAININGSET *TS, int count);
+void  DenFreeCodebook(CODEBOOK *CB);
+void  DenFreePartitioning(PARTITIONING *P);
+
+/* qsort order of int indices. */
+int   CompareInt(const void *a, const void *b);
+
+/* Seed of 32 bits from the generator of random.c. */
+llong RandomSeed(void);
+
+/* Splits threads among count parallel runs: *outer runs at a time,
+   each with *inner threads for its own parallel regions. Allows the
+   nesting this needs and returns the previous limit for EndNesting. */
+int   BeginNesting(int threads, int count, int *outer, int *inner);
+void  EndNesting(int levels);
+
+#endif /* __DENUTIL_H */
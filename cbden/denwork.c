@@ -0,0 +1,192 @@
+/*--------------------------------------------------------------------*/
+/* DENWORK.C       agent                                              */
+/*                                                                    */
+/* Workspace of the density-based random swap. Every K-means          */
+/* iteration used to create and free a sub-codebook, packed copies of */
+/* the codebook, move lists and a scratch vector, and keep arrays of  */
+/* codebook size on the stack. A workspace holds all of them; it is   */
+/* created once per run (and per parallel trial) and reused.          */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.05: 17.10.26 AG: Slot arrays of the checkpoints.                 */
+/* 0.04: 17.10.26 AG: Second nearest sums of the partition pass.      */
+/* 0.03: 17.10.26 AG: Scratch buffers of the bounded search.          */
+/* 0.02: 17.10.26 AG: Dimension order for the partial distances.      */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cb.h"
+#include "interfc.h"
+#include "denutil.h"
+#include "denkern.h"
+#include "denstore.h"
+#include "denbound.h"
+#include "denwork.h"
+
+
+/* ========================== PROTOTYPES ============================= */
+
+static size_t Rounded(size_t bytes);
+static void*  Carve(char **p, size_t bytes);
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+/*-------------------------------------------------------------------*/
+/* threads is the largest thread count of the passes that use W and  */
+/* trials the number of trial slots a checkpoint saves.              */
+/*-------------------------------------------------------------------*/
+
+
+void CreateWorkspace(WORKSPACE *W, TRAININGSET *TS, CODEBOOK *CB,
+int threads, int trials)
+{
+  int    t, k = BookSize(CB), cap;
+  size_t bytes;
+  char  *p;
+
+  memset(W, 0, sizeof(WORKSPACE));
+  W->Size    = k;
+  W->Dim     = VectorSize(CB);
+  W->Threads = (threads > 0) ? threads : 1;
+  W->Trials  = (trials > 0) ? trials : 1;
+
+  bytes = 3 * Rounded(k * sizeof(double)) + Rounded(k * sizeof(int)) +
+          3 * Rounded(k * sizeof(llong)) +
+          Rounded((size_t) W->Threads * 2 * k * sizeof(llong)) +
+          Rounded(W->Threads * sizeof(llong)) +
+          Rounded((size_t) W->Threads * (k + BOUND_MAXGROUPS) *
+                  sizeof(double)) +
+          Rounded(W->Dim * sizeof(VECTORELEMENT)) +
+          Rounded(W->Dim * sizeof(int)) + Rounded(k * sizeof(BOOKNODE)) +
+          Rounded(W->Trials * sizeof(int*)) +
+          Rounded(W->Trials * sizeof(llong*));
+  if (posix_memalign(&W->Arena, WORK_ALIGN, bytes) != 0)
+    {
+    ErrorMessage("ERROR: Allocating memory failed!\n");
+    ExitProcessing(FATAL_ERROR);
+    }
+  memset(W->Arena, 0, bytes);
+
+  p               = (char*) W->Arena;
+  W->weight       = (double*) Carve(&p, k * sizeof(double));
+  W->density      = (double*) Carve(&p, k * sizeof(double));
+  W->activeWeight = (double*) Carve(&p, k * sizeof(double));
+  W->active       = (int*) Carve(&p, k * sizeof(int));
+  W->cdist        = (llong*) Carve(&p, k * sizeof(llong));
+  W->clusterError = (llong*) Carve(&p, k * sizeof(llong));
+  W->secondError  = (llong*) Carve(&p, k * sizeof(llong));
+  W->threadError  = (llong*) Carve(&p, (size_t) W->Threads * 2 * k *
+                                   sizeof(llong));
+  W->partial      = (llong*) Carve(&p, W->Threads * sizeof(llong));
+  W->scratch      = (double*) Carve(&p, (size_t) W->Threads *
+                                    (k + BOUND_MAXGROUPS) * sizeof(double));
+  W->centroid     = (VECTORELEMENT*) Carve(&p, W->Dim * sizeof(VECTORELEMENT));
+  W->order        = (int*) Carve(&p, W->Dim * sizeof(int));
+  W->node         = (BOOKNODE*) Carve(&p, k * sizeof(BOOKNODE));
+  W->slotSecond   = (int**) Carve(&p, W->Trials * sizeof(int*));
+  W->slotSecondDist = (llong**) Carve(&p, W->Trials * sizeof(llong*));
+
+  /* a thread range has at most cap vectors */
+  cap        = (BookSize(TS) + W->Threads - 1) / W->Threads;
+  W->moves   = (MOVELIST*) DenAlloc(W->Threads * sizeof(MOVELIST));
+  W->unknown = (MOVELIST*) DenAlloc(W->Threads * sizeof(MOVELIST));
+  for (t = 0; t < W->Threads; t++)
+    {
+    W->moves[t].vec     = (int*) DenAlloc(cap * sizeof(int));
+    W->moves[t].to      = (int*) DenAlloc(cap * sizeof(int));
+    W->moves[t].count   = 0;
+    W->moves[t].size    = cap;
+    W->unknown[t].vec   = (int*) DenAlloc(cap * sizeof(int));
+    W->unknown[t].to    = (int*) DenAlloc(cap * sizeof(int));
+    W->unknown[t].count = 0;
+    W->unknown[t].size  = cap;
+    }
+
+  /* packing the whole codebook sizes the kernel buffers for good */
+  DimensionOrder(TS, W->order);
+  InitPackedCodebook(&W->PB);
+  InitPackedCodebook(&W->PBact);
+  W->PB.Order    = W->order;
+  W->PBact.Order = W->order;
+  PackCodebook(CB, W->weight, &W->PB);
+  PackCodebook(CB, W->activeWeight, &W->PBact);
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+void FreeWorkspace(WORKSPACE *W)
+{
+  int t;
+
+  for (t = 0; t < W->Threads && W->moves != NULL; t++)
+    {
+    free(W->moves[t].vec);
+    free(W->moves[t].to);
+    free(W->unknown[t].vec);
+    free(W->unknown[t].to);
+    }
+  free(W->moves);
+  free(W->unknown);
+  FreePackedCodebook(&W->PB);
+  FreePackedCodebook(&W->PBact);
+  free(W->Arena);
+  memset(W, 0, sizeof(WORKSPACE));
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Sub-codebook of the centroids active[0..count-1] of CB. Its nodes  */
+/* share the vectors of CB, so it is valid only until CB changes.     */
+/*-------------------------------------------------------------------*/
+
+
+CODEBOOK* ActiveCodebook(WORKSPACE *W, CODEBOOK *CB, int *active,
+int count)
+{
+  int i;
+
+  W->CBact               = *CB;
+  W->CBact.Book          = W->node;
+  W->CBact.CodebookSize  = count;
+  W->CBact.AllocatedSize = count;
+  for (i = 0; i < count; i++)
+    {
+    Node(&W->CBact, i) = Node(CB, active[i]);
+    }
+  return &W->CBact;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+static size_t Rounded(size_t bytes)
+{
+  return (bytes + WORK_ALIGN - 1) / WORK_ALIGN * WORK_ALIGN;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+static void* Carve(char **p, size_t bytes)
+{
+  void *q = *p;
+
+  *p += Rounded(bytes);
+  return q;
+}
+
+
+/*-------------------------------------------------------------------*/
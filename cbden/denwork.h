@@ -0,0 +1,58 @@
+#if ! defined(__DENWORK_H)
+#define __DENWORK_H
+
+/* Alignment of the arrays carved from the arena (bytes). */
+#define WORK_ALIGN        64
+
+/* Vectors that change partition in a parallel pass; one list per thread. */
+typedef struct
+  {
+  int   *vec;
+  int   *to;
+  int    count;
+  int    size;
+  } MOVELIST;
+
+/* Buffers of the swap loop. They are sized once from the training set
+   and codebook and reused by every iteration, so the hot path does not
+   allocate. The arrays of codebook size are carved from one aligned
+   arena; the move lists are allocated separately, because AddMove()
+   may still grow them when a pass uses fewer threads. A workspace is
+   used by one trial (one thread of trials) at a time. */
+typedef struct
+  {
+  void          *Arena;
+  int            Size;          /* codebook size                      */
+  int            Dim;           /* vector dimension                   */
+  int            Threads;       /* move lists                         */
+  int            Trials;        /* trial slots of a checkpoint        */
+  double        *weight;        /* weights of the current solution    */
+  double        *density;       /* densities of the clusters          */
+  double        *activeWeight;  /* weights of the active sub-codebook */
+  int           *active;        /* active clusters of K-means         */
+  llong         *cdist;
+  llong         *clusterError;  /* errors summed per cluster          */
+  llong         *secondError;   /* second nearest errors per cluster  */
+  llong         *threadError;   /* per thread: both sums, 2 x Size    */
+  int            totals;        /* sums of the last OptimalPartition  */
+  llong         *partial;       /* error sums per thread              */
+  double        *scratch;       /* per thread: Size + BOUND_MAXGROUPS */
+  VECTORELEMENT *centroid;      /* previous value of a centroid       */
+  int           *order;         /* dimensions by decreasing variance  */
+  int          **slotSecond;    /* second nearest of each trial slot  */
+  llong        **slotSecondDist;
+  BOOKNODE      *node;          /* nodes of the active sub-codebook   */
+  CODEBOOK       CBact;         /* active centroids (see ActiveCodebook) */
+  PACKEDBOOK     PB;            /* whole codebook for the kernel      */
+  PACKEDBOOK     PBact;         /* active sub-codebook for the kernel */
+  MOVELIST      *moves;
+  MOVELIST      *unknown;       /* vectors without a second nearest   */
+  } WORKSPACE;
+
+void      CreateWorkspace(WORKSPACE *W, TRAININGSET *TS, CODEBOOK *CB,
+    int threads, int trials);
+void      FreeWorkspace(WORKSPACE *W);
+CODEBOOK* ActiveCodebook(WORKSPACE *W, CODEBOOK *CB, int *active,
+    int count);
+
+#endif /* __DENWORK_H */
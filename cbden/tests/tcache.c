@@ -0,0 +1,244 @@
+/*--------------------------------------------------------------------*/
+/* TCACHE.C        agent                                              */
+/*                                                                    */
+/* Regression test of the second nearest centroids that               */
+/* OptimalPartition() keeps in the trial log (AttachSecond()). Every  */
+/* known entry must be the weighted second nearest centroid of the    */
+/* vector, after a full search and after a pass with only some        */
+/* centroids active. A rollback must restore the entries, a replay    */
+/* must copy them, and SelectClusterToBeSwapped() must pick a cluster */
+/* whose removal costs least.                                         */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cb.h"
+#include "interfc.h"
+#include "denutil.h"
+#include "denkern.h"
+#include "denwork.h"
+#include "dentrial.h"
+#include "denstats.h"
+#include "dentraj.h"
+#include "denrs.h"
+#include "testdata.h"
+
+
+#define VECTORS   2000
+#define DIM       4
+#define CLUSTERS  10
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+/*-------------------------------------------------------------------*/
+/* Weighted distance by the original rule.                           */
+/*-------------------------------------------------------------------*/
+
+
+static llong Weighted(TRAININGSET *TS, int i, CODEBOOK *CB, int j,
+double *weight)
+{
+  return weight[j] * sqrt(VectorDistance(Vector(TS, i), Vector(CB, j),
+                          VectorSize(TS), MAXLLONG, EUCLIDEANSQ));
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Error of vector i in its second nearest cluster, by brute force.  */
+/*-------------------------------------------------------------------*/
+
+
+static llong SecondBest(TRAININGSET *TS, CODEBOOK *CB, PARTITIONING *P,
+int i, double *weight)
+{
+  llong e, best = MAXLLONG;
+  int   j;
+
+  for (j = 0; j < BookSize(CB); j++)
+    {
+    if (j == Map(P, i))  continue;
+    e = Weighted(TS, i, CB, j, weight);
+    if (e < best)  best = e;
+    }
+  return best;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Known entries that are not the second nearest centroid (or whose  */
+/* saved distance is not the squared distance to it).                */
+/*-------------------------------------------------------------------*/
+
+
+static int WrongEntries(TRAININGSET *TS, CODEBOOK *CB, PARTITIONING *P,
+TRIALLOG *log, double *weight, int *known)
+{
+  int i, s, bad = 0;
+
+  *known = 0;
+  for (i = 0; i < BookSize(TS); i++)
+    {
+    s = log->second[i];
+    if (s < 0)  continue;
+    (*known)++;
+    if (s == Map(P, i) ||
+        log->secondDist[i] != VectorDistance(Vector(TS, i), Vector(CB, s),
+                                             VectorSize(TS), MAXLLONG,
+                                             EUCLIDEANSQ) ||
+        Weighted(TS, i, CB, s, weight) != SecondBest(TS, CB, P, i, weight))
+      {
+      bad++;
+      }
+    }
+  return bad;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Removal cost of cluster c by brute force, as the selection sums    */
+/* it (distance holds the errors of the vectors).                    */
+/*-------------------------------------------------------------------*/
+
+
+static llong RemovalCost(TRAININGSET *TS, CODEBOOK *CB, PARTITIONING *P,
+llong *distance, double *weight, int c)
+{
+  llong cost = 0;
+  int   i;
+
+  for (i = 0; i < BookSize(TS); i++)
+    {
+    if (Map(P, i) != c)  continue;
+    cost += (SecondBest(TS, CB, P, i, weight) - distance[i]) *
+            VectorFreq(TS, i);
+    }
+  return cost;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+int main(int argc, char *argv[])
+{
+  TRAININGSET  TS;
+  CODEBOOK     CB, CBcopy;
+  PARTITIONING P, Pcopy;
+  TRIALLOG     log, logcopy;
+  WORKSPACE    W;
+  double       weight[CLUSTERS];
+  llong        distance[VECTORS], secondDist[VECTORS], savedDist[VECTORS];
+  llong        copyDist[VECTORS], cost, least;
+  int          second[VECTORS], saved[VECTORS], copy[VECTORS];
+  int          active[CLUSTERS];
+  int          i, j, d, known, min, picked;
+
+  TestClusters(&TS, VECTORS, DIM, CLUSTERS, 20);
+  DenNewCodebook(&CB, CLUSTERS, &TS);
+  DenNewPartitioning(&P, &TS, CLUSTERS);
+  for (j = 0; j < CLUSTERS; j++)
+    {
+    CopyVector(Vector(&TS, j * (VECTORS / CLUSTERS)), Vector(&CB, j), DIM);
+    active[j] = j;
+    weight[j] = 0.05 + 0.01 * (j % 4);
+    }
+  CreateWorkspace(&W, &TS, &CB, 1, 1);
+  CreateTrialLog(&log, &TS, &CB);
+  InitClusterSums(&log, &TS, &CB, &P);
+  memset(second, 0xff, sizeof(second));
+  AttachSecond(&log, second, secondDist);
+
+  /* all centroids active: every vector gets its second nearest */
+  for (i = 0; i < VECTORS; i++)  distance[i] = MAXLLONG;
+  OptimalPartition(NULL, &CB, &TS, &P, active, W.cdist, CLUSTERS, distance,
+                   weight, 0, 1, &log, &W);
+  Check(WrongEntries(&TS, &CB, &P, &log, weight, &known) == 0 &&
+        known == VECTORS, "a full search finds every second nearest");
+
+  /* forgotten entries and new weights: a partial search is no answer */
+  memset(second, 0xff, sizeof(second));
+  for (j = 0; j < CLUSTERS; j++)  weight[j] = (j % 2) ? 0.05 : 0.15;
+  for (i = 0; i < VECTORS; i++)  distance[i] = MAXLLONG;
+  OptimalPartition(NULL, &CB, &TS, &P, active, W.cdist, 1, distance,
+                   weight, 0, 1, &log, &W);
+  Check(WrongEntries(&TS, &CB, &P, &log, weight, &known) == 0,
+        "a search of the active centroids alone leaves entries unknown");
+
+  /* a K-means step: one centroid moves, the static weights scale */
+  for (i = 0; i < VECTORS; i++)  distance[i] = MAXLLONG;
+  OptimalPartition(NULL, &CB, &TS, &P, active, W.cdist, CLUSTERS, distance,
+                   weight, 0, 1, &log, &W);
+  DenNewCodebook(&CBcopy, CLUSTERS, &TS);
+  DenNewPartitioning(&Pcopy, &TS, CLUSTERS);
+  CopyCodebook(&CB, &CBcopy);
+  CopyPartitioning(&P, &Pcopy);
+  CreateTrialLog(&logcopy, &TS, &CBcopy);
+  InitClusterSums(&logcopy, &TS, &CBcopy, &Pcopy);
+  memcpy(copy, second, sizeof(second));
+  memcpy(copyDist, secondDist, sizeof(secondDist));
+  AttachSecond(&logcopy, copy, copyDist);
+  memcpy(saved, second, sizeof(second));
+  memcpy(savedDist, secondDist, sizeof(secondDist));
+
+  BeginTrial(&log);
+  SaveCentroid(&log, &CB, 3);
+  for (d = 0; d < DIM; d++)  VectorScalar(&CB, 3, d) += 9;
+  CentroidChanged(&log, 3);
+  for (j = 0; j < CLUSTERS; j++)  weight[j] *= (j == 3) ? 1.3 : 0.8;
+  CalculateDistances(&TS, &CB, &P, distance, weight, 1);
+  active[0] = 3;
+  OptimalPartition(NULL, &CB, &TS, &P, active, W.cdist, 1, distance,
+                   weight, 0, 1, &log, &W);
+  Check(WrongEntries(&TS, &CB, &P, &log, weight, &known) == 0,
+        "entries after a pass with one active centroid");
+  Check(known > VECTORS / 2, "entries of static centroids are kept");
+
+  /* the selection searches the rest and sums the same costs */
+  picked = SelectClusterToBeSwapped(&TS, &CB, &P, distance, weight, &log,
+                                    &W);
+  Check(WrongEntries(&TS, &CB, &P, &log, weight, &known) == 0 &&
+        known == VECTORS, "the selection finds the unknown entries");
+  least = MAXLLONG;
+  for (j = 0, min = 0; j < CLUSTERS; j++)
+    {
+    cost = RemovalCost(&TS, &CB, &P, distance, weight, j);
+    if (cost < least)
+      {
+      least = cost;
+      min   = j;
+      }
+    }
+  cost = RemovalCost(&TS, &CB, &P, distance, weight, picked);
+  Check(cost - least <= CCFreq(&P, picked) + CCFreq(&P, min),
+        "the selected cluster costs least to remove");
+
+  /* the trial's entries are replayed on a copy, then rolled back */
+  ReplayTrial(&log, &TS, &CB, &P, &logcopy, &CBcopy, &Pcopy);
+  Check(memcmp(copy, second, sizeof(second)) == 0 &&
+        memcmp(copyDist, secondDist, sizeof(secondDist)) == 0,
+        "a replay copies the entries");
+  RollbackTrial(&log, &TS, &CB, &P);
+  Check(memcmp(saved, second, sizeof(second)) == 0 &&
+        memcmp(savedDist, secondDist, sizeof(secondDist)) == 0,
+        "a rollback restores the entries");
+
+  FreeTrialLog(&logcopy);
+  FreeTrialLog(&log);
+  FreeWorkspace(&W);
+  DenFreePartitioning(&Pcopy);
+  DenFreeCodebook(&CBcopy);
+  DenFreePartitioning(&P);
+  DenFreeCodebook(&CB);
+  FreeCodebook(&TS);
+  return TestResult("tcache");
+}
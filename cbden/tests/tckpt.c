@@ -0,0 +1,141 @@
+/*--------------------------------------------------------------------*/
+/* TCKPT.C         agent                                              */
+/*                                                                    */
+/* Regression test of the checkpoints: a written checkpoint is read   */
+/* back into a fresh solution and every part of the state, including  */
+/* the progress monitor and the slots' second nearest centroids, must */
+/* come back unchanged.                                               */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cb.h"
+#include "interfc.h"
+#include "denutil.h"
+#include "denckpt.h"
+#include "testdata.h"
+
+
+#define CKPTNAME  "tckpt.ckp"
+#define VECTORS   500
+#define DIM       3
+#define CLUSTERS  7
+#define TRIALS    2
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+int main(int argc, char *argv[])
+{
+  TRAININGSET  TS;
+  CODEBOOK     CB, CB2;
+  PARTITIONING P, P2;
+  CHECKPOINT   C, R;
+  FILE        *f;
+  double       weight[CLUSTERS], weight2[CLUSTERS];
+  int          secondData[TRIALS][VECTORS], secondRead[TRIALS][VECTORS];
+  llong        distData[TRIALS][VECTORS], distRead[TRIALS][VECTORS];
+  int         *second[TRIALS], *second2[TRIALS];
+  llong       *secondDist[TRIALS], *secondDist2[TRIALS];
+  int          i, j, t, same;
+
+  TestClusters(&TS, VECTORS, DIM, CLUSTERS, 22);
+  DenNewCodebook(&CB, CLUSTERS, &TS);
+  DenNewCodebook(&CB2, CLUSTERS, &TS);
+  DenNewPartitioning(&P, &TS, CLUSTERS);
+  DenNewPartitioning(&P2, &TS, CLUSTERS);
+  for (j = 0; j < CLUSTERS; j++)
+    {
+    CopyVector(Vector(&TS, 3 * j), Vector(&CB, j), DIM);
+    VectorFreq(&CB, j) = j + 1;
+    weight[j]          = 0.5 / (j + 1);
+    }
+  for (i = 0; i < VECTORS; i++)  ChangePartition(&TS, &P, i % CLUSTERS, i);
+  for (t = 0; t < TRIALS; t++)
+    {
+    for (i = 0; i < VECTORS; i++)
+      {
+      secondData[t][i] = (i + t) % CLUSTERS - 1;
+      distData[t][i]   = 1000 * i + t;
+      }
+    second[t]       = secondData[t];
+    secondDist[t]   = distData[t];
+    second2[t]      = secondRead[t];
+    secondDist2[t]  = distRead[t];
+    }
+
+  memset(&C, 0, sizeof(CHECKPOINT));
+  C.N             = VECTORS;
+  C.Size          = CLUSTERS;
+  C.Dim           = DIM;
+  C.Trials        = TRIALS;
+  C.Deterministic = 1;
+  C.Monitoring    = 1;
+  C.Iteration     = 41;
+  C.Target        = 3;
+  C.PrevIter      = 17;
+  C.Error         = 123456789;
+  C.PrevImpr      = 0.25;
+  C.Random        = 0x0123456789ABCDEFULL;
+  C.Seed          = 99;
+  C.CIPrev        = 2;
+  C.CIZero        = 0;
+  C.CIMax         = 5;
+  C.PrevSuccess   = 38;
+  for (i = 0; i < CKPT_CIBINS; i++)  C.CIHistogram[i] = 3 * i + 1;
+  WriteCheckpoint(CKPTNAME, &C, &CB, &P, weight, second, secondDist);
+
+  /* the expected sizes and options */
+  memset(&R, 0, sizeof(CHECKPOINT));
+  R.N             = VECTORS;
+  R.Size          = CLUSTERS;
+  R.Dim           = DIM;
+  R.Trials        = TRIALS;
+  R.Deterministic = 1;
+  R.Monitoring    = 1;
+  f = OpenCheckpoint(CKPTNAME, &R, &TS, &CB2, &P2, weight2);
+  if (!Check(f != NULL, "checkpoint file was written"))
+    {
+    return TestResult("tckpt");
+    }
+  CloseCheckpoint(f, CKPTNAME, &R, second2, secondDist2);
+  remove(CKPTNAME);
+
+  Check(R.Iteration == C.Iteration && R.Target == C.Target &&
+        R.PrevIter == C.PrevIter && R.Error == C.Error &&
+        R.PrevImpr == C.PrevImpr && R.Random == C.Random &&
+        R.Seed == C.Seed, "state of the run");
+  Check(R.CIPrev == C.CIPrev && R.CIZero == C.CIZero &&
+        R.CIMax == C.CIMax && R.PrevSuccess == C.PrevSuccess &&
+        memcmp(R.CIHistogram, C.CIHistogram, sizeof(C.CIHistogram)) == 0,
+        "state of the progress monitor");
+
+  same = 1;
+  for (j = 0; j < CLUSTERS; j++)
+    {
+    same = same && EqualVectors(Vector(&CB, j), Vector(&CB2, j), DIM) &&
+           VectorFreq(&CB, j) == VectorFreq(&CB2, j) &&
+           weight[j] == weight2[j];
+    }
+  Check(same, "centroids, frequencies and weights");
+  for (i = 0; i < VECTORS; i++)  same = same && Map(&P, i) == Map(&P2, i);
+  Check(same, "partition");
+  Check(memcmp(secondData, secondRead, sizeof(secondData)) == 0 &&
+        memcmp(distData, distRead, sizeof(distData)) == 0,
+        "second nearest centroids of the slots");
+
+  DenFreePartitioning(&P2);
+  DenFreePartitioning(&P);
+  DenFreeCodebook(&CB2);
+  DenFreeCodebook(&CB);
+  FreeCodebook(&TS);
+  return TestResult("tckpt");
+}
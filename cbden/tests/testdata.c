@@ -0,0 +1,118 @@
+/*--------------------------------------------------------------------*/
+/* TESTDATA.C      agent                                              */
+/*                                                                    */
+/* Data and checks shared by the regression tests of CBDEN. The tests */
+/* generate their own clustered data, so they need no input files.    */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cb.h"
+#include "interfc.h"
+#include "testdata.h"
+
+
+/* ========================== PROTOTYPES ============================= */
+
+static double Uniform01(void);
+
+
+/* ============================ STATE ================================ */
+
+static unsigned long long TestState;
+static int                Failures;
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+void TestClusters(TRAININGSET *TS, int N, int dim, int k, int seed)
+{
+  CODEBOOK base;
+  double   center[dim], sigma, u, v, x;
+  int      i, c, d;
+
+  memset(&base, 0, sizeof(CODEBOOK));
+  base.BlockSizeX      = dim;
+  base.BlockSizeY      = 1;
+  base.BytesPerElement = sizeof(VECTORELEMENT);
+  base.MinValue        = 0;
+  base.MaxValue        = TEST_SCALE;
+  CreateNewCodebook(TS, N, &base);
+
+  TestState = (unsigned long long) seed;
+  for (i = 0, c = -1; i < N; i++)
+    {
+    if (i * (llong) k / N != c)
+      {
+      c = i * (llong) k / N;
+      for (d = 0; d < dim; d++)
+        center[d] = (0.1 + 0.8 * Uniform01()) * TEST_SCALE;
+      }
+    sigma = (c % 2 == 0) ? 0.03 * TEST_SCALE : 0.005 * TEST_SCALE;
+    for (d = 0; d < dim; d++)
+      {
+      u = Uniform01();
+      v = Uniform01();
+      x = center[d] + sigma * sqrt(-2.0 * log(1.0 - u)) *
+          cos(6.283185307179586 * v);
+      VectorScalar(TS, i, d) = (VECTORELEMENT)
+        ((x < 0.0) ? 0.0 : (x > TEST_SCALE) ? TEST_SCALE : x);
+      }
+    VectorFreq(TS, i) = 1;
+    }
+  TotalFreq(TS) = N;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+int Check(int ok, char *what)
+{
+  if (!ok)
+    {
+    Failures++;
+    ErrorMessage("FAILED: %s\n", what);
+    }
+  return ok;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+int TestResult(char *name)
+{
+  if (Failures > 0)
+    {
+    ErrorMessage("%s: %i checks failed\n", name, Failures);
+    return 1;
+    }
+  PrintMessage("%s: OK\n", name);
+  return 0;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* splitmix64, so the data does not depend on the toolkit generator. */
+/*-------------------------------------------------------------------*/
+
+
+static double Uniform01(void)
+{
+  unsigned long long z = (TestState += 0x9E3779B97F4A7C15ULL);
+
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  z = z ^ (z >> 31);
+  return (z >> 11) * (1.0 / 9007199254740992.0);
+}
@@ -0,0 +1,17 @@
+#if ! defined(__TESTDATA_H)
+#define __TESTDATA_H
+
+/* Largest coordinate of the generated data. */
+#define TEST_SCALE        50000
+
+/* N vectors of dimension dim in k Gaussian clusters of N/k vectors,
+   alternately wide and narrow; the same seed gives the same set. */
+void  TestClusters(TRAININGSET *TS, int N, int dim, int k, int seed);
+
+/* Counts a failed check and reports it with what. Returns ok. */
+int   Check(int ok, char *what);
+
+/* Reports the result of test name; the exit code of the test. */
+int   TestResult(char *name);
+
+#endif /* __TESTDATA_H */
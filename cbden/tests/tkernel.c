@@ -0,0 +1,248 @@
+/*--------------------------------------------------------------------*/
+/* TKERNEL.C       agent                                              */
+/*                                                                    */
+/* Regression test of the weighted nearest centroid kernel            */
+/* (DENKERN.H). With every kernel the processor supports, the packed  */
+/* search must give the centroid and error of                         */
+/* FindNearestVectorWithWeight(), for the whole codebook and for an   */
+/* active sub-codebook, and OptimalPartition() must weight the active */
+/* centroids by their own clusters.                                   */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cb.h"
+#include "interfc.h"
+#include "denkern.h"
+#include "denwork.h"
+#include "dentrial.h"
+#include "denstats.h"
+#include "dentraj.h"
+#include "denrs.h"
+#include "testdata.h"
+
+
+#define VECTORS   3000
+#define CLUSTERS  300     /* more than one chunk of the kernel */
+#define BATCH     7       /* not a multiple of the tile        */
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+/*-------------------------------------------------------------------*/
+/* Weighted distance by the original rule.                           */
+/*-------------------------------------------------------------------*/
+
+
+static llong Weighted(TRAININGSET *TS, int i, CODEBOOK *CB, int j,
+double *weight)
+{
+  return weight[j] * sqrt(VectorDistance(Vector(TS, i), Vector(CB, j),
+                          VectorSize(TS), MAXLLONG, EUCLIDEANSQ));
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Compares the packed search of every vector with the reference.    */
+/* The runner-up must be the second nearest centroid (the kernel may */
+/* round its distance differently by one). Returns the mismatches.   */
+/*-------------------------------------------------------------------*/
+
+
+static int Search(TRAININGSET *TS, CODEBOOK *CB, double *weight,
+PACKEDBOOK *PB)
+{
+  int   index[BATCH], guess[BATCH], nearest[BATCH], second[BATCH];
+  llong error[BATCH], secondError[BATCH], e, best;
+  int   i, n, j, count, ref, bad = 0;
+
+  for (i = 0; i < BookSize(TS); i += count)
+    {
+    count = (BookSize(TS) - i < BATCH) ? BookSize(TS) - i : BATCH;
+    for (n = 0; n < count; n++)
+      {
+      index[n] = i + n;
+      guess[n] = (i + n) % BookSize(CB);
+      }
+    if (i % 5 == 0)
+      {
+      count = 1;
+      nearest[0] = FindNearestVectorPacked(TS, PB, index[0], guess[0],
+                     &error[0], &second[0], &secondError[0]);
+      }
+    else
+      {
+      FindNearestVectorsPacked(TS, PB, index, guess, count, nearest, error,
+                               second, secondError);
+      }
+
+    for (n = 0; n < count; n++)
+      {
+      ref = FindNearestVectorWithWeight(&Node(TS, index[n]), CB, &e,
+                                        guess[n], EUCLIDEANSQ, weight, NULL);
+      if (nearest[n] != ref || error[n] != e)  bad++;
+
+      for (j = 0, best = MAXLLONG; j < BookSize(CB); j++)
+        {
+        if (j == ref)  continue;
+        e = Weighted(TS, index[n], CB, j, weight);
+        if (e < best)  best = e;
+        }
+      if (second[n] < 0 || second[n] == ref ||
+          llabs(secondError[n] - best) > 1)  bad++;
+      }
+    }
+  return bad;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Every vector must end in the nearest of the active centroids and, */
+/* if it is static, its own one (the rule of OptimalPartition).      */
+/*-------------------------------------------------------------------*/
+
+
+static int Partition(TRAININGSET *TS, CODEBOOK *CB, PARTITIONING *P,
+int *old, int *active, int activeCount, llong *distance, double *weight)
+{
+  CODEBOOK CBact;
+  double   actWeight[activeCount];
+  llong    e, best;
+  int      i, a, own, bad = 0;
+
+  CreateNewCodebook(&CBact, activeCount, TS);
+  for (a = 0; a < activeCount; a++)
+    {
+    CopyVector(Vector(CB, active[a]), Vector(&CBact, a), VectorSize(CB));
+    actWeight[a] = weight[active[a]];
+    }
+
+  for (i = 0; i < BookSize(TS); i++)
+    {
+    FindNearestVectorWithWeight(&Node(TS, i), &CBact, &best, 0, EUCLIDEANSQ,
+                                actWeight, NULL);
+    for (a = 0, own = 0; a < activeCount; a++)
+      if (active[a] == old[i])  own = 1;
+    if (!own)
+      {
+      e = Weighted(TS, i, CB, old[i], weight);
+      if (e <= best)  best = e;
+      }
+    if (distance[i] != best ||
+        Weighted(TS, i, CB, Map(P, i), weight) != best)  bad++;
+    }
+
+  FreeCodebook(&CBact);
+  return bad;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+int main(int argc, char *argv[])
+{
+  static char *kernels[] = { "scalar", "AVX2", "AVX-512" };
+  static int   dims[]    = { 3, 13 };
+  TRAININGSET  TS;
+  CODEBOOK     CB, CBact;
+  PARTITIONING P;
+  PACKEDBOOK   PB, PBact;
+  TRIALLOG     log;
+  WORKSPACE    W;
+  double       weight[CLUSTERS], actWeight[CLUSTERS];
+  llong        distance[VECTORS];
+  int          old[VECTORS], all[CLUSTERS];
+  int          active[CLUSTERS];
+  int          activeCount, dim, k, t, i, j;
+  char         what[100];
+
+  for (t = 0; t < 2; t++)
+    {
+    dim = dims[t];
+    TestClusters(&TS, VECTORS, dim, 20, 30 + t);
+    CreateNewCodebook(&CB, CLUSTERS, &TS);
+    CreateNewPartitioning(&P, &TS, CLUSTERS);
+    for (j = 0; j < CLUSTERS; j++)
+      {
+      CopyVector(Vector(&TS, j * (VECTORS / CLUSTERS)), Vector(&CB, j), dim);
+      weight[j] = 0.2 + (j * 7919 % 97) / 20.0;
+      }
+
+    /* every third centroid active, as a sub-codebook */
+    for (j = 1, activeCount = 0; j < CLUSTERS; j += 3)
+      active[activeCount++] = j;
+    CreateNewCodebook(&CBact, activeCount, &TS);
+    for (j = 0; j < activeCount; j++)
+      {
+      CopyVector(Vector(&CB, active[j]), Vector(&CBact, j), dim);
+      actWeight[j] = weight[active[j]];
+      }
+
+    for (k = 0; k < 3; k++)
+      {
+      if (!UseKernel(kernels[k]))
+        {
+        PrintMessage("tkernel: %s not supported, skipped\n", kernels[k]);
+        continue;
+        }
+      Check(strcmp(KernelName(), kernels[k]) == 0,
+            "UseKernel selects the kernel");
+
+      InitPackedCodebook(&PB);
+      InitPackedCodebook(&PBact);
+      PackCodebook(&CB, weight, &PB);
+      PackCodebook(&CBact, actWeight, &PBact);
+      sprintf(what, "%s kernel, dimension %i, full codebook",
+              kernels[k], dim);
+      Check(Search(&TS, &CB, weight, &PB) == 0, what);
+      sprintf(what, "%s kernel, dimension %i, active sub-codebook",
+              kernels[k], dim);
+      Check(Search(&TS, &CBact, actWeight, &PBact) == 0, what);
+      FreePackedCodebook(&PB);
+      FreePackedCodebook(&PBact);
+
+      /* a full search, then new weights with only some centroids active */
+      CreateWorkspace(&W, &TS, &CB, 1, 1);
+      CreateTrialLog(&log, &TS, &CB);
+      InitClusterSums(&log, &TS, &CB, &P);
+      for (j = 0; j < CLUSTERS; j++)  all[j] = j;
+      for (i = 0; i < VECTORS; i++)  distance[i] = MAXLLONG;
+      OptimalPartition(NULL, &CB, &TS, &P, all, W.cdist, CLUSTERS,
+                       distance, weight, 0, 1, &log, &W);
+      for (i = 0; i < VECTORS; i++)
+        {
+        old[i]      = Map(&P, i);
+        distance[i] = MAXLLONG;
+        }
+      for (j = 0; j < CLUSTERS; j++)  weight[j] = 5.0 - weight[j];
+      for (j = 0; j < activeCount; j++)  actWeight[j] = weight[active[j]];
+      OptimalPartition(NULL, &CB, &TS, &P, active, W.cdist, activeCount,
+                       distance, weight, 0, 1, &log, &W);
+      sprintf(what, "%s kernel, dimension %i, OptimalPartition",
+              kernels[k], dim);
+      Check(Partition(&TS, &CB, &P, old, active, activeCount, distance,
+                      weight) == 0, what);
+      FreeTrialLog(&log);
+      FreeWorkspace(&W);
+      for (j = 0; j < CLUSTERS; j++)  weight[j] = 5.0 - weight[j];
+      for (j = 0; j < activeCount; j++)  actWeight[j] = weight[active[j]];
+      }
+
+    FreeCodebook(&CBact);
+    FreePartitioning(&P);
+    FreeCodebook(&CB);
+    FreeCodebook(&TS);
+    }
+
+  return TestResult("tkernel");
+}
@@ -0,0 +1,78 @@
+/*--------------------------------------------------------------------*/
+/* TLIMIT.C        agent                                              */
+/*                                                                    */
+/* Regression test of the partial distances (DENSTORE.H). A centroid  */
+/* whose partial sum exceeds WeightedLimit() may not be one that the  */
+/* weighted rule (llong) (w * sqrt(d)) would rank below the best, and */
+/* PartialDistance() must be exact up to its limit in any order.      */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cb.h"
+#include "interfc.h"
+#include "denstore.h"
+#include "testdata.h"
+
+
+#define CASES     100000
+#define DIM       13
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+int main(int argc, char *argv[])
+{
+  TRAININGSET TS;
+  llong       best, limit, d, full, part;
+  double      w;
+  int         order[DIM], n, i, cut = 0, wrong = 0, inexact = 0;
+
+  /* weights and errors over the ranges of the search */
+  srand(1);
+  for (n = 0; n < CASES; n++)
+    {
+    best  = ((llong) rand() << 16 | rand()) % 1000000000 + 1;
+    w     = (rand() + 1.0) / RAND_MAX * ((n % 3 == 0) ? 1e-3 : 10.0);
+    limit = WeightedLimit(best, w);
+    if (limit == MAXLLONG)  continue;
+    d = limit + 1;
+    if ((llong) (w * sqrt(d)) < best)  wrong++;
+    }
+  Check(wrong == 0, "WeightedLimit never rules out a better centroid");
+  Check(WeightedLimit(MAXLLONG, 0.5) == MAXLLONG &&
+        WeightedLimit(100, 0.0) == MAXLLONG,
+        "WeightedLimit without a bound");
+
+  /* partial sums of real vectors, natural and reversed order */
+  TestClusters(&TS, 200, DIM, 4, 40);
+  for (i = 0; i < DIM; i++)  order[i] = DIM - 1 - i;
+  for (n = 1; n < BookSize(&TS); n++)
+    {
+    full = PartialDistance(Vector(&TS, 0), Vector(&TS, n), NULL, DIM,
+                           MAXLLONG);
+    if (full != VectorDistance(Vector(&TS, 0), Vector(&TS, n), DIM,
+                               MAXLLONG, EUCLIDEANSQ))  inexact++;
+    if (full == 0)  continue;
+    part = PartialDistance(Vector(&TS, 0), Vector(&TS, n), order, DIM,
+                           full);
+    if (part != full)  inexact++;
+    part = PartialDistance(Vector(&TS, 0), Vector(&TS, n), order, DIM,
+                           full / 2);
+    if (part <= full / 2)  inexact++;
+    cut += (part < full);
+    }
+  Check(inexact == 0, "PartialDistance is exact up to its limit");
+  Check(cut > 0, "PartialDistance stops early");
+
+  FreeCodebook(&TS);
+  return TestResult("tlimit");
+}
@@ -0,0 +1,132 @@
+/*--------------------------------------------------------------------*/
+/* TRESUME.C       agent                                              */
+/*                                                                    */
+/* Regression test of the resume: a run stopped at a checkpoint half  */
+/* way and resumed from it must end with the codebook, partition,     */
+/* weights and error of the uninterrupted run, with one and several   */
+/* trials and with the random and the deterministic swap. The data    */
+/* set is one on which every run still improves after the checkpoint. */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cb.h"
+#include "interfc.h"
+#include "denutil.h"
+#include "denkern.h"
+#include "denwork.h"
+#include "dentrial.h"
+#include "denstats.h"
+#include "dentraj.h"
+#include "denrs.h"
+#include "testdata.h"
+
+
+#define CKPTNAME  "tresume.ckp"
+#define VECTORS   1500
+#define DIM       3
+#define CLUSTERS  12
+#define ITER      8       /* a multiple of 2 x TRIALS              */
+#define TRIALS    4
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+/*-------------------------------------------------------------------*/
+/* Runs iter iterations from the random initial solution of the seed */
+/* (or, with resume, from the checkpoint). The checkpoint is written */
+/* after ITER/2 iterations. Returns the final error.                 */
+/*-------------------------------------------------------------------*/
+
+
+static llong Run(TRAININGSET *TS, CODEBOOK *CB, PARTITIONING *P,
+double *weight, int trials, int deterministic, int iter, int resume)
+{
+  DENRSOPTIONS  options;
+  DENRSCONTEXT *ctx;
+  llong         error;
+
+  DefaultDenRSOptions(&options);
+  options.Iterations       = iter;
+  options.KMeansIterations = 2;
+  options.Deterministic    = deterministic;
+  options.QuietLevel       = 0;
+  options.Threads          = 2;
+  options.Trials           = trials;
+  options.Seed             = 7;
+  ctx = CreateDenRSContext(&options);
+  ctx->Weights    = weight;
+  ctx->Checkpoint = CKPTNAME;
+  ctx->Interval   = ITER / 2;
+  ctx->Resume     = resume;
+  if (RunDenRS(ctx, TS, CB, P, NO) != 0)  Check(0, "RunDenRS failed");
+  error = ctx->Error;
+  FreeDenRSContext(ctx);
+  return error;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+int main(int argc, char *argv[])
+{
+  TRAININGSET  TS;
+  CODEBOOK     CB, CB2;
+  PARTITIONING P, P2;
+  double       weight[CLUSTERS], weight2[CLUSTERS];
+  llong        error, error2, half;
+  int          trials, deterministic, i, j, same;
+  char         what[100];
+
+  TestClusters(&TS, VECTORS, DIM, CLUSTERS, 25);
+  for (trials = 1; trials <= TRIALS; trials += TRIALS - 1)
+    {
+    for (deterministic = 0; deterministic <= 1; deterministic++)
+      {
+      DenNewCodebook(&CB, CLUSTERS, &TS);
+      DenNewCodebook(&CB2, CLUSTERS, &TS);
+      DenNewPartitioning(&P, &TS, CLUSTERS);
+      DenNewPartitioning(&P2, &TS, CLUSTERS);
+
+      remove(CKPTNAME);
+      error = Run(&TS, &CB, &P, weight, trials, deterministic, ITER, NO);
+      remove(CKPTNAME);
+      half = Run(&TS, &CB2, &P2, weight2, trials, deterministic, ITER / 2,
+                 NO);
+      error2 = Run(&TS, &CB2, &P2, weight2, trials, deterministic, ITER,
+                   YES);
+      remove(CKPTNAME);
+
+      same = (error == error2);
+      for (j = 0; j < CLUSTERS; j++)
+        {
+        same = same && EqualVectors(Vector(&CB, j), Vector(&CB2, j), DIM) &&
+               VectorFreq(&CB, j) == VectorFreq(&CB2, j) &&
+               weight[j] == weight2[j];
+        }
+      for (i = 0; i < VECTORS; i++)  same = same && Map(&P, i) == Map(&P2, i);
+      sprintf(what, "resumed run, %i trials, %s swap", trials,
+              deterministic ? "deterministic" : "random");
+      Check(same, what);
+      /* else a resume that lost its state could still match */
+      Check(error < half, "swaps are accepted after the checkpoint");
+
+      DenFreePartitioning(&P2);
+      DenFreePartitioning(&P);
+      DenFreeCodebook(&CB2);
+      DenFreeCodebook(&CB);
+      }
+    }
+
+  FreeCodebook(&TS);
+  return TestResult("tresume");
+}
@@ -0,0 +1,195 @@
+/*--------------------------------------------------------------------*/
+/* TUPDATE.C       agent                                              */
+/*                                                                    */
+/* Regression test of the incremental update (DENUPDATE.C). The same  */
+/* solution is updated with the same new vectors without and with     */
+/* swaps. A swap is kept only if the objective function decreases and */
+/* it leaves no cluster with fewer than two vectors, so the swaps may */
+/* not give a larger objective or more such clusters. The cluster     */
+/* errors updated in place must be those of the result, and a small   */
+/* batch must not visit the whole training set.                       */
+/*                                                                    */
+/* ChangeLog:                                                         */
+/*                                                                    */
+/* 0.01: 17.10.26 AG: Initial version.                                */
+/*--------------------------------------------------------------------*/
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "cb.h"
+#include "interfc.h"
+#include "denutil.h"
+#include "denkern.h"
+#include "denwork.h"
+#include "dentrial.h"
+#include "denstats.h"
+#include "dentraj.h"
+#include "denrs.h"
+#include "denassign.h"
+#include "denupdate.h"
+#include "testdata.h"
+
+
+#define VECTORS   3000
+#define ADDED     600
+#define DIM       2
+#define CLUSTERS  9
+#define SWAPS     100
+
+
+/* ========================== FUNCTIONS ============================== */
+
+
+/*-------------------------------------------------------------------*/
+/* Objective function of the update: squared errors weighted by the  */
+/* densities over their total, which are the weights.                */
+/*-------------------------------------------------------------------*/
+
+
+static double Objective(TRAININGSET *TS, CODEBOOK *CB, PARTITIONING *P,
+double *weight)
+{
+  double cost = 0.0;
+  int    i, j;
+
+  for (i = 0; i < BookSize(TS); i++)
+    {
+    j     = Map(P, i);
+    cost += weight[j] * VectorDistance(Vector(TS, i), Vector(CB, j),
+                                       VectorSize(TS), MAXLLONG,
+                                       EUCLIDEANSQ);
+    }
+  return cost;
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+static int SmallClusters(PARTITIONING *P)
+{
+  int j, count = 0;
+
+  for (j = 0; j < PartitionCount(P); j++)
+    {
+    if (CCFreq(P, j) < 2)  count++;
+    }
+  return count;
+}
+
+
+/*-------------------------------------------------------------------*/
+/* Updates a copy of CB, P (of the first vectors of TS), weight and  */
+/* sse with swaps swaps; the result is left in CBnew, Pnew and wnew. */
+/* Checks the cluster errors of the result.                          */
+/*-------------------------------------------------------------------*/
+
+
+static void Update(TRAININGSET *TS, CODEBOOK *CB, PARTITIONING *P,
+double *weight, llong *sse, int swaps, CODEBOOK *CBnew,
+PARTITIONING *Pnew, double *wnew, UPDATESTATS *stats)
+{
+  DENRSOPTIONS  options;
+  DENRSCONTEXT *ctx;
+  llong         snew[CLUSTERS], check[CLUSTERS];
+  int           i, j, same;
+
+  DenNewCodebook(CBnew, BookSize(CB), TS);
+  CopyCodebook(CB, CBnew);
+  DenNewPartitioning(Pnew, TS, BookSize(CB));
+  for (i = 0; i < VECTORS; i++)
+    {
+    if (Map(Pnew, i) != Map(P, i))  ChangePartition(TS, Pnew, Map(P, i), i);
+    }
+  for (j = 0; j < BookSize(CB); j++)
+    {
+    wnew[j] = weight[j];
+    snew[j] = sse[j];
+    }
+
+  DefaultDenRSOptions(&options);
+  options.Iterations       = swaps;
+  options.KMeansIterations = 2;
+  options.Threads          = 1;
+  options.QuietLevel       = 0;
+  options.Seed             = 5;
+  ctx = CreateDenRSContext(&options);
+  Check(UpdateDenRS(ctx, TS, VECTORS, CBnew, Pnew, wnew, snew, stats) == 0,
+        "update succeeds");
+  FreeDenRSContext(ctx);
+
+  PartitionErrors(TS, CBnew, Pnew, check);
+  for (j = 0, same = 1; j < BookSize(CB); j++)
+    {
+    same = same && snew[j] == check[j];
+    }
+  Check(same, "the cluster errors are those of the result");
+}
+
+
+/*-------------------------------------------------------------------*/
+
+
+int main(int argc, char *argv[])
+{
+  TRAININGSET   A, B, C, TS, TS2;
+  CODEBOOK      CB, CB0, CB1;
+  PARTITIONING  P, P0, P1;
+  DENRSOPTIONS  options;
+  DENRSCONTEXT *ctx;
+  UPDATESTATS   stats0, stats1;
+  double        weight[CLUSTERS], w0[CLUSTERS], w1[CLUSTERS];
+  llong         sse[CLUSTERS];
+
+  TestClusters(&A, VECTORS, DIM, CLUSTERS, 2);
+  TestClusters(&B, ADDED, DIM, CLUSTERS + 5, 52);
+  DenNewCodebook(&CB, CLUSTERS, &A);
+  DenNewPartitioning(&P, &A, CLUSTERS);
+
+  DefaultDenRSOptions(&options);
+  options.Iterations       = 50;
+  options.KMeansIterations = 2;
+  options.Threads          = 1;
+  options.QuietLevel       = 0;
+  options.Seed             = 4;
+  ctx          = CreateDenRSContext(&options);
+  ctx->Weights = weight;
+  Check(RunDenRS(ctx, &A, &CB, &P, 0) == 0, "clustering succeeds");
+  FreeDenRSContext(ctx);
+
+  PartitionErrors(&A, &CB, &P, sse);
+  JoinTrainingSets(&A, &B, &TS);
+  Update(&TS, &CB, &P, weight, sse, 0, &CB0, &P0, w0, &stats0);
+  Update(&TS, &CB, &P, weight, sse, SWAPS, &CB1, &P1, w1, &stats1);
+
+  Check(stats1.Swaps == SWAPS && stats1.Accepted > 0, "swaps are kept");
+  Check(Objective(&TS, &CB1, &P1, w1) <= Objective(&TS, &CB0, &P0, w0),
+        "swaps do not increase the objective function");
+  Check(SmallClusters(&P1) <= SmallClusters(&P0),
+        "swaps leave no new empty or singleton clusters");
+
+  /* one new vector, no swaps: the work is that of its cluster alone */
+  TestClusters(&C, 1, DIM, 1, 53);
+  JoinTrainingSets(&A, &C, &TS2);
+  DenFreePartitioning(&P1);
+  DenFreeCodebook(&CB1);
+  Update(&TS2, &CB, &P, weight, sse, 0, &CB1, &P1, w1, &stats1);
+  Check(stats1.Affected >= 1 && stats1.Visited < VECTORS / 2,
+        "a small batch visits only the clusters it reaches");
+  FreeJoinedSet(&TS2);
+  FreeCodebook(&C);
+
+  DenFreePartitioning(&P1);
+  DenFreePartitioning(&P0);
+  DenFreeCodebook(&CB1);
+  DenFreeCodebook(&CB0);
+  FreeJoinedSet(&TS);
+  DenFreePartitioning(&P);
+  DenFreeCodebook(&CB);
+  FreeCodebook(&B);
+  FreeCodebook(&A);
+  return TestResult("tupdate");
+}